@@ -2,20 +2,96 @@
 #define BLUETOOTH_HANDLER_H
 
 #include <Arduino.h>
-#include "BLEDevice.h"
-#include "BLEServer.h"
-#include "BLEUtils.h"
-#include "BLEHIDDevice.h"
-#include "HIDTypes.h"
-#include "hidmap.h"
+#include <atomic>
+#include "hal/hid_transport.h"
+#include "core/spsc_queue.h"
 #include "config.h"
 
-// Forward declarations
-class MultiClientServerCallbacks;
-class OutputCallbacks;
+// Event types passed from the BLE stack to the controller task
+enum HostEventType : uint8_t {
+    HOST_STATE_UPDATE,  // Call state for the controller to apply (produced by pollHostEvent)
+    HOST_CONNECTED,     // Link events, applied to the host table by pollHostEvent
+    HOST_DISCONNECTED,
+    HOST_LEDS,          // Host wrote the LED output report (mute / off-hook)
+    HOST_PARAMS         // Stack reported new connection parameters
+};
+
+// Typed event queued by BLE callbacks
+struct HostEvent {
+    HostEventType type;
+    uint16_t connId;
+    bool callActive;    // HOST_STATE_UPDATE
+    bool muteState;
+    uint8_t leds;       // HOST_LEDS: first byte of the output report
+    uint16_t interval;  // HOST_PARAMS
+    uint16_t latency;
+    uint16_t timeout;
+};
+
+// Transmit outcomes passed from the BLE stack to the controller task
+enum TxEventType : uint8_t {
+    TX_CONFIRMED,    // the in-flight notification went out
+    TX_FAILED,       // the stack dropped it
+    TX_CONGESTED,    // stop sending to this host
+    TX_UNCONGESTED
+};
+
+struct TxEvent {
+    TxEventType type;
+    uint16_t connId;
+};
+
+// One connected host and the call state it last reported
+struct HostConnection {
+    uint16_t connId;
+    bool connected;
+    bool callActive;     // ledOffHookState from its output report
+    bool muteState;
+    uint32_t stateTime;  // millis() of connecting or of its last call state change
+    
+    // Link parameters last reported by the stack, and the profile asked for
+    uint16_t interval;   // 1.25 ms units
+    uint16_t latency;    // connection events the host may skip
+    uint16_t timeout;    // 10 ms units
+    HidLinkProfile profile;
+    
+    uint32_t generation; // bumped on every connect, so stale outbound state is dropped
+};
+
+// What one input characteristic last delivered to one host, and the report
+// held back while that link is still busy with the previous one
+struct OutboundStage {
+    uint32_t generation;   // HostConnection::generation this belongs to
+    uint32_t lastSendTime; // micros()
+    uint8_t last[8];
+    uint8_t lastLength;    // 0 = nothing delivered yet
+    uint8_t pending[8];
+    uint8_t pendingLength; // 0 = nothing held
+};
+
+// Report waiting for, or in flight on, one host's link
+struct TxEntry {
+    HidChannel channel;
+    uint8_t length;
+    uint8_t attempts;
+    uint8_t data[8];
+};
 
-// Callback function type for host state updates
-typedef void (*HostStateCallback)(bool callActive, bool muteState);
+// Bounded transmit queue of one host, telephony ahead of keystrokes. The
+// head is in flight until the stack confirms it; a failed one is retried at
+// the next connection event
+struct TxQueue {
+    uint32_t generation;   // HostConnection::generation this belongs to
+    TxEntry entries[BLE_TX_QUEUE_SIZE];
+    uint8_t count;
+    bool inFlight;
+    bool congested;
+    uint32_t sendTime;     // micros() the head went to the stack, or when it may be retried
+};
+
+// Outcome of one notification to one host, on the controller task: confirmed
+// by the stack, or a failed attempt (which is retried, or dropped for a key press)
+typedef void (*DeliveryCallback)(HidChannel channel, uint16_t connId, uint8_t firstByte, bool delivered);
 
 class BluetoothHandler {
 public:
@@ -25,10 +101,24 @@ public:
     // Start BLE advertising for pairing
     void startAdvertising();
     
-    // Generic method for sending reports to any characteristic
-    bool sendReport(BLECharacteristic* characteristic, uint8_t* report, size_t length, bool notifyAll = true);
+    // Generic method for sending reports to any input characteristic.
+    // Headset (telephony) reports go to every host; keyboard and consumer
+    // reports only to the input host. A report identical to the last one a
+    // host received is dropped, and headset state sent while the link is
+    // still busy is held and collapsed into the latest value. Reports then
+    // wait in each host's transmit queue while its link is congested.
+    // False if no host took the report.
+    bool sendReport(HidChannel channel, const uint8_t* report, size_t length);
+    
+    // Apply confirms, retry failed notifications and send held reports - call from the main loop
+    void update();
+    uint32_t getTimeUntilNextFlush() const;  // milliseconds, UINT32_MAX if nothing is held
     
-    // High-level report sending methods
+    // High-level report sending methods. True means accepted, not delivered:
+    // every host either has the report or holds it in a queue. A queued
+    // headset report is retried until it lands; the delivery callback reports
+    // each confirm and each failed attempt, and isDelivered() turns true once
+    // every host has confirmed it
     bool sendHeadsetReport(uint8_t reportValue);
     bool sendKeyboardReport(uint8_t* reportValue);
     bool sendConsumerReport(uint16_t consumerCode);
@@ -36,19 +126,43 @@ public:
     // Status methods
     uint32_t getConnectedClients() const { return connectedClients; }
     bool isConnected() const { return connectedClients > 0; }
-
-    bool isInitialized() const { return (headsetInput != nullptr && keyboardInput != nullptr && consumerInput != nullptr); }
-
-    // Characteristic accessors
-    BLECharacteristic* getHeadsetInputCharacteristic() { return headsetInput; }
-    BLECharacteristic* getKeyboardInputCharacteristic() { return keyboardInput; }
-    BLECharacteristic* getConsumerInputCharacteristic() { return consumerInput; }
+    bool isInitialized() const { return hal::getHidTransport().isReady(); }
     
-    // Get HID device for keyboard handler
-    BLEHIDDevice* getHIDDevice() const { return hid; }
+    // Host that receives keystrokes: the one that most recently went off-hook,
+    // or the most recently active host when no call is up (HID_ALL_HOSTS if none)
+    uint16_t getInputHost() const { return inputHost.load(std::memory_order_relaxed); }
     
-    // Host state callback registration
-    void setHostStateCallback(HostStateCallback callback) { hostStateCallback = callback; }
+    // Connection table, for diagnostics
+    const HostConnection& getHost(uint8_t index) const { return hosts[index]; }
+    
+    // Outbound counters per characteristic, one per host notification
+    uint32_t getReportsSent(HidChannel channel) const { return reportsSent[channel]; }
+    uint32_t getReportsElided(HidChannel channel) const { return reportsElided[channel]; }        // same as delivered
+    uint32_t getReportsCollapsed(HidChannel channel) const { return reportsCollapsed[channel]; }  // superseded while held
+    uint32_t getReportsRetried(HidChannel channel) const { return reportsRetried[channel]; }      // failed or congested attempts
+    uint32_t getReportsDropped(HidChannel channel) const { return reportsDropped[channel]; }      // queue full or out of attempts
+    void resetReportStats();
+    
+    // Nothing on this characteristic is queued or awaiting confirmation
+    bool isDelivered(HidChannel channel) const;
+    void setDeliveryCallback(DeliveryCallback callback) { deliveryCallback = callback; }
+    uint8_t getQueuedReports(uint8_t index) const { return txQueues[index].count; }
+    bool isCongested(uint8_t index) const { return txQueues[index].congested; }
+    uint32_t getDroppedTxEvents() const { return txEvents.getDropped(); }
+    
+    // Controller task only: apply the link events queued by the BLE stack to
+    // the host table, and return the call state updates among them
+    bool pollHostEvent(HostEvent& event);
+    uint32_t getDroppedHostEvents() const { return hostEvents.getDropped(); }
+    
+    // Transport callbacks - called from the transport's task (the BLE stack);
+    // they only queue an event, the host table is left to the controller task
+    void onClientConnected(uint16_t connId);
+    void onClientDisconnected(uint16_t connId);
+    void onOutputReport(uint16_t connId, const uint8_t* data, size_t length);
+    void onConnectionParams(uint16_t connId, uint16_t interval, uint16_t latency, uint16_t timeout);
+    void onNotifyComplete(uint16_t connId, bool success);
+    void onCongestion(uint16_t connId, bool congested);
 
     // Singleton instance getter
     static BluetoothHandler& getInstance() {
@@ -57,39 +171,57 @@ public:
     }
 
 private:
-    friend class MultiClientServerCallbacks; // Allow the callback to modify connectedClients
-    friend class OutputCallbacks; // Allow the callback to access hostStateCallback
-    friend void bluetoothTask(void*); // Allow the task to access private members
-
     uint32_t connectedClients;
-    BLEHIDDevice* hid;
-    BLECharacteristic* headsetInput;
-    BLECharacteristic* headsetOutput;
-    BLECharacteristic* keyboardInput;  // Added keyboard input characteristic
-    BLECharacteristic* consumerInput;  // Added consumer control input characteristic
-    BLEServer* pServer;
-    HostStateCallback hostStateCallback = nullptr; // Callback for host state updates
-    
-    void initBLE();
-};
-
-/*
- * Callbacks for BLE Server connection events.
- */
-class MultiClientServerCallbacks : public BLEServerCallbacks {
-public:
-    MultiClientServerCallbacks() {}
     
-    void onConnect(BLEServer* pServer) override;
-    void onDisconnect(BLEServer* pServer) override;
-};
-
-/*
- * Callback for handling output reports from host
- */
-class OutputCallbacks : public BLECharacteristicCallbacks {
-public:
-    void onWrite(BLECharacteristic* pCharacteristic) override;
+    // Per-connection state, owned by the controller task like everything
+    // below; the BLE stack's callbacks reach it through hostEvents
+    HostConnection hosts[MAX_BLE_CONNECTIONS];
+    std::atomic<uint16_t> inputHost;
+    
+    // Outbound stages, owned by the controller task
+    OutboundStage stages[MAX_BLE_CONNECTIONS][HID_CHANNEL_COUNT];
+    uint32_t reportsSent[HID_CHANNEL_COUNT];
+    uint32_t reportsElided[HID_CHANNEL_COUNT];
+    uint32_t reportsCollapsed[HID_CHANNEL_COUNT];
+    uint32_t reportsRetried[HID_CHANNEL_COUNT];
+    uint32_t reportsDropped[HID_CHANNEL_COUNT];
+    
+    // Transmit queues, owned by the controller task; the stack's confirm and
+    // congestion events reach them through txEvents
+    TxQueue txQueues[MAX_BLE_CONNECTIONS];
+    DeliveryCallback deliveryCallback;
+    
+    OutboundStage& stageFor(uint8_t slot, HidChannel channel);
+    bool stageReport(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length);
+    bool transmit(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length);
+    void flush(uint8_t slot, HidChannel channel);
+    int32_t busyFor(uint8_t slot, const OutboundStage& stage) const;  // micros until the link is free, <= 0 if free
+    
+    TxQueue& queueFor(uint8_t slot);
+    bool enqueue(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length);
+    void pump(uint8_t slot);
+    void completeHead(uint8_t slot, bool success);
+    void processTxEvents();
+    int8_t findSlot(uint16_t connId) const;
+    void postTxEvent(TxEventType type, uint16_t connId);
+    
+    HostConnection* findHost(uint16_t connId);
+    void updateInputHost();
+    void postHostEvent(const HostEvent& event);
+    
+    // Apply one link event; true if it leaves call state for the controller in 'state'
+    bool applyHostEvent(const HostEvent& event, HostEvent& state);
+    void applyConnected(uint16_t connId);
+    bool applyDisconnected(uint16_t connId, HostEvent& state);
+    bool applyLeds(uint16_t connId, uint8_t leds, HostEvent& state);
+    void applyParams(const HostEvent& event);
+    
+    // Fast links while any host is in a call, relaxed ones otherwise
+    void applyLinkProfile();
+    
+    // BLE task (producer) to controller task (consumer), no locks on either side
+    SpscQueue<HostEvent, HOST_EVENT_QUEUE_SIZE> hostEvents;
+    SpscQueue<TxEvent, TX_EVENT_QUEUE_SIZE> txEvents;
 };
 
 // Global accessor function
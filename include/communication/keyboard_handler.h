@@ -2,8 +2,8 @@
 #define KEYBOARD_HANDLER_H
 
 #include <Arduino.h>
-#include "BLEDevice.h"
-#include "BLEHIDDevice.h"
+#include "core/latency_histogram.h"
+#include "config.h"
 
 // HID Keyboard Modifier Key Bit Positions (for first byte of report)
 #define KEY_NONE           0x00
@@ -36,10 +36,32 @@
 #define SHORTCUT_CTRL_ALT_H_ALT2  7  // Fast timing method  
 #define SHORTCUT_CTRL_ALT_H_ALT3  8  // Right modifiers method
 
+// Report kinds handled by the keystroke scheduler
+enum ScheduledReportType : uint8_t {
+    REPORT_KEYBOARD,
+    REPORT_CONSUMER,
+    REPORT_HEADSET_PRESS,   // data[0] bits set on top of the live headset state
+    REPORT_HEADSET_RELEASE  // data[0] bits cleared again
+};
+
+// One timed step of a queued shortcut (press, hold or release)
+struct ScheduledReport {
+    uint32_t dueTime;      // millis() at which the report is emitted
+    uint32_t requestTime;  // micros() of the originating input, 0 for follow-up steps
+    ScheduledReportType type;
+    uint8_t data[8];
+};
+
+// Live telephony state (HEADSET_MUTE/HEADSET_DROP bits) that pulses apply on top of
+typedef uint8_t (*HeadsetStateCallback)();
+
 class KeyboardHandler {
 public:
     KeyboardHandler();
     
+    // Emit queued reports whose deadline has passed - call from the main loop
+    void update();
+    
     // Methods for sending key combinations
     void sendRightArrow();
     void sendLeftArrow();
@@ -51,9 +73,9 @@ public:
     void sendCtrlAltHAlternative3();  // Right modifiers instead of left
     void sendA();
     
-    // Consumer control methods
-    void sendVolumeUp();
-    void sendVolumeDown();
+    // Consumer control methods; several volume steps go out as one burst
+    void sendVolumeUp(uint8_t steps = 1);
+    void sendVolumeDown(uint8_t steps = 1);
     void sendConsumerMute();
     
     // Generic method for sending key shortcuts
@@ -65,6 +87,27 @@ public:
     // Release all keys
     void releaseAllKeys();
     
+    // Queue a headset report pulse (e.g. drop call) without blocking: the bits
+    // are set for holdTime, the rest of the report follows the live state
+    void sendHeadsetPulse(uint8_t pulseBits, uint16_t holdTime);
+    void setHeadsetStateCallback(HeadsetStateCallback cb) { headsetStateCallback = cb; }
+    
+    // micros() of the input edge behind the shortcuts queued next, so latency
+    // is measured from the edge; 0 measures from when they are queued
+    void setInputTime(uint32_t edgeTime) { inputTime = edgeTime; }
+    
+    // Pulse bits currently held, for reports sent outside the scheduler
+    uint8_t getHeldHeadsetBits() const { return headsetHeld; }
+    
+    // Scheduler status
+    bool isIdle() const { return queueCount == 0; }
+    uint32_t getTimeUntilNextReport() const;  // milliseconds, 0 if due now
+    uint8_t getQueueDepth() const { return queueCount; }
+    uint32_t getReportsSent() const { return reportsSent; }
+    uint32_t getReportsDropped() const { return reportsDropped; }
+    const LatencyHistogram& getLatencyStats() const { return latencyStats; }
+    void resetStats();
+    
     // Singleton instance getter
     static KeyboardHandler& getInstance() {
         static KeyboardHandler instance;
@@ -72,8 +115,37 @@ public:
     }
     
 private:
-    // Send key report
-    bool sendReport(uint8_t* report, size_t length);
+    ScheduledReport queue[KEY_SCHEDULER_QUEUE_SIZE];
+    uint8_t queueHead = 0;
+    uint8_t queueCount = 0;
+    uint32_t scheduleCursor = 0;   // Deadline of the last queued step
+    uint32_t sequenceRequestTime = 0;
+    uint32_t inputTime = 0;
+    uint32_t reportsSent = 0;
+    uint32_t reportsDropped = 0;
+    uint8_t headsetHeld = 0;       // Pulse bits pressed and not yet released
+    HeadsetStateCallback headsetStateCallback = nullptr;
+    LatencyHistogram latencyStats; // Input-to-report latency of first steps
+    
+    // Start a new sequence after any queued one; false if it would not fit
+    bool beginSequence(uint16_t stepCount);
+    
+    // Append steps to the current sequence, delay is relative to the previous step
+    void queueKeys(uint16_t delayMs, uint8_t modifiers = 0, uint8_t key1 = 0);
+    void queueConsumer(uint16_t delayMs, uint8_t consumerBits);
+    void queueHeadset(uint16_t delayMs, ScheduledReportType type, uint8_t pulseBits);
+    void queueGap(uint16_t delayMs);
+    void queueStep(uint16_t delayMs, ScheduledReportType type, const uint8_t* data, size_t length);
+    
+    // Queue a press followed by a release after holdTime
+    void queueKeyTap(uint8_t modifiers, uint8_t key, uint16_t holdTime);
+    void queueConsumerTap(uint8_t consumerBits, uint16_t holdTime);
+    
+    // Queue press/release pairs VOLUME_STEP_INTERVAL apart, trimmed to the free queue space
+    void queueConsumerSteps(uint8_t consumerBits, uint8_t steps);
+    
+    // Send a queued report to the BLE handler
+    void emit(const ScheduledReport& report);
 };
 
 // Static accessor function
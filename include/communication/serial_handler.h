@@ -21,6 +21,21 @@ public:
     
     // Print LED strip status
     void printLedStatus();
+    
+    // Compare CPU time per frame of the LED transports
+    void printLedBenchmark(uint16_t frames);
+    
+    // Print input event counts and edge-to-report latency
+    void printInputStatus();
+    
+    // Print keystroke scheduler queue and latency stats
+    void printKeyboardStatus();
+    
+    // Print per-component timing, loop jitter and task CPU share
+    void printProfile();
+    
+    // Dump the event trace, oldest first
+    void printTrace();
 
 private:
     String commandBuffer;  // Buffer to store incoming command string
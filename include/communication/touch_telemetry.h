@@ -0,0 +1,87 @@
+#ifndef TOUCH_TELEMETRY_H
+#define TOUCH_TELEMETRY_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+#define TOUCH_TELEMETRY_MAGIC     0xA5
+#define TOUCH_TELEMETRY_KEYFRAME_FLAG 0x01  // first sample holds absolute values
+#define TOUCH_TELEMETRY_HARDWARE_FLAG 0x02  // filtered/baseline are the peripheral's smoothed and benchmark registers
+#define TOUCH_TELEMETRY_HEADER    4         // magic, flags, length (uint16)
+
+/*
+ * Binary stream of touch samples on Serial, for collecting traces to tune
+ * thresholds offline.
+ *
+ * While streaming, a low-priority task samples every pad each
+ * TOUCH_TELEMETRY_INTERVAL ms and writes a frame every TOUCH_TELEMETRY_BATCH
+ * samples. It only reads touch registers and the TouchSensor's last filter
+ * state, and drops a frame rather than wait for the serial buffer, so the
+ * input task never waits on it.
+ *
+ * Frame layout (little endian; varints are LEB128, signed ones zigzag):
+ *   0xA5, flags, payload length (uint16)
+ *   payload:
+ *     sequence (uint16, a gap means frames were dropped)
+ *     pad count (uint8), sample count (uint8)
+ *     micros() of the first sample (uint32)
+ *     per sample:
+ *       micros since the previous sample (varint, not on the first sample)
+ *       touched pads (varint bitmap, bit n = pad n)
+ *       per pad: raw, filtered, baseline (signed varints)
+ *   XOR of the payload bytes
+ *
+ * Values are deltas from the previous sample, the previous frame included.
+ * A keyframe starts from zero instead, so its first sample is absolute; one
+ * is sent every TOUCH_TELEMETRY_KEYFRAME frames and after any dropped frame.
+ * Log text may sit between frames; readers resync on magic and checksum.
+ */
+class TouchTelemetry {
+public:
+    TouchTelemetry();
+
+    // Start or stop the stream
+    void start();
+    void stop();
+    bool isStreaming() const { return streaming; }
+
+    // Sample from the input task when no telemetry task could be started (native build)
+    void update();
+    uint32_t getTimeUntilNextSample() const;
+
+    uint32_t getFramesSent() const { return framesSent; }
+    uint32_t getFramesDropped() const { return framesDropped; }
+
+private:
+    volatile bool streaming;
+    std::atomic<bool> taskActive;  // owned by whoever sets it: start() or the exiting task
+    bool taskless;                 // task creation failed, update() samples instead
+
+    // Frame being assembled
+    uint8_t frame[TOUCH_TELEMETRY_FRAME_MAX];
+    uint16_t length;
+    uint8_t sampleCount;
+    uint16_t sequence;
+    uint16_t framesUntilKeyframe;
+    bool keyframe;
+    uint32_t lastSampleMicros;
+    unsigned long lastSampleMillis;
+    int32_t previous[TOUCH_MAX_PADS][3];
+
+    volatile uint32_t framesSent;
+    volatile uint32_t framesDropped;
+
+    void sample();
+    void beginFrame(uint32_t now, uint8_t padCount);
+    void flush();
+    void putVarint(uint32_t value);
+    void putSigned(int32_t value);
+
+    static void telemetryTask(void* arg);
+};
+
+// Global accessor function
+TouchTelemetry& getTouchTelemetry();
+
+#endif // TOUCH_TELEMETRY_H
@@ -1,8 +1,4 @@
 #ifndef CONFIG_H
-// Rotary Encoder Precision Mode Settings
-#define ENCODER_DIRECTION_CONSISTENCY 2    // number of consistent direction readings needed to accept direction change
-#define ENCODER_PRECISION_NOTCH_THRESHOLD 2 // number of notches needed to trigger one arrow in precision mode
-#define ENCODER_PRECISION_RESET_TIMEOUT 500 // milliseconds - time after which notch accumulator resets
 
 #include "logger.h"
 
@@ -15,28 +11,133 @@
 
 // LED Settings
 #define LED_BRIGHTNESS 10        // 0-255
+#define LED_NUM_PIXELS 9
+#define LED_MAX_PIXELS 16        // size of the LedStrip pixel buffer
+#define LED_DATA_PIN 11
+#define LED_CLOCK_PIN 12
+#define LED_SPI_CLOCK_HZ 8000000 // APA102 SPI clock when using the DMA transport
+#ifndef LED_USE_SPI_DMA
+#define LED_USE_SPI_DMA 1        // 1 = hardware SPI + DMA, 0 = Adafruit bit-bang
+#endif
 
 // Input Settings
-#define DEBOUNCE_TIME 50         // milliseconds
+#define DEBOUNCE_TIME 5          // milliseconds of net contact before a press or release registers
+#define ENCODER_DEBOUNCE_TIME 10 // same for the encoder's push switch, which chatters longer than the tact buttons
 #define LONG_PRESS_TIME 700      // milliseconds
 #define DOUBLE_CLICK_TIME 300    // milliseconds
 #define LEFT_BUTTON_PIN   13      // Press to toggle mute
 #define RIGHT_BUTTON_PIN   14     // Press to toggle drop call state (formerly hook button)
+#define BUTTON_MAX_COUNT 8       // buttons in the static button table
+#define BUTTON_EDGE_QUEUE_SIZE 16 // captured edges per button awaiting update() (power of two)
 
 // Rotary Encoder Precision Mode Settings
-#define ENCODER_NON_PRECISION_TIMEOUT 150  // milliseconds - time to wait before sending action in non-precision mode
-#define ENCODER_DIRECTION_CONSISTENCY 2    // number of consistent direction readings needed to accept direction change
-#define ENCODER_PRECISION_NOTCH_THRESHOLD 2 // number of notches (1-3) needed to trigger one arrow in precision mode
-#define ENCODER_PRECISION_RESET_TIMEOUT 500 // milliseconds - time after which notch accumulator resets
+#ifndef ENCODER_FULL_QUAD
+#define ENCODER_FULL_QUAD 1                // 1 = count every A and B edge, 0 = single edge on A
+#endif
+#if ENCODER_FULL_QUAD
+#define ENCODER_COUNTS_PER_DETENT 4        // pulse counts from one detent to the next
+#define ENCODER_DETENT_THRESHOLD 3         // counts away from the resting detent at which the next one registers
+#else
+#define ENCODER_COUNTS_PER_DETENT 2
+#define ENCODER_DETENT_THRESHOLD 2
+#endif
+#define ENCODER_GLITCH_FILTER 1023         // APB cycles (12.8 us) a level must hold before the counter sees it, 0 = off
+#define ENCODER_PRECISION_RESET_TIMEOUT 500 // milliseconds - a turn after this pause starts unaccelerated
+#define ENCODER_ACCEL_MIN_RATE 4           // detents per second below which each detent is one volume step
+#define ENCODER_ACCEL_MAX_RATE 24          // detents per second at which the full gain applies
+#define ENCODER_ACCEL_MAX_GAIN 4           // volume steps per detent on a fast spin
+#define VOLUME_STEP_INTERVAL 8             // milliseconds between consumer reports of a volume burst
 
 // BLE Settings
 #define MAX_BLE_CONNECTIONS 3    // Maximum simultaneous BLE connections
 #define HID_HEADSET 0x0941       // Standard BLE appearance for a headset
+#define HOST_EVENT_QUEUE_SIZE 32 // BLE-to-controller link event ring (power of two)
+
+// Connection parameters requested per host (intervals in 1.25 ms units, timeout in 10 ms units)
+#define BLE_FAST_INTERVAL_MIN 6      // 7.5 ms while any host is in a call
+#define BLE_FAST_INTERVAL_MAX 6
+#define BLE_FAST_LATENCY 0           // answer every connection event
+#define BLE_IDLE_INTERVAL_MIN 48     // 60 ms with no call up
+#define BLE_IDLE_INTERVAL_MAX 80     // 100 ms
+#define BLE_IDLE_LATENCY 4           // may skip up to 4 events when there is nothing to send
+#define BLE_SUPERVISION_TIMEOUT 400  // 4 s
+
+// Per-host transmit queue
+#define BLE_TX_QUEUE_SIZE 8          // reports waiting for, or in flight on, one link
+#define BLE_TX_TELEPHONY_RESERVE 2   // slots keystrokes may not take (hang-up pulse + mute state)
+#define BLE_TX_MAX_ATTEMPTS 4        // a key press is given up after this many; state is retried until it lands
+#define BLE_TX_CONFIRM_TIMEOUT 100   // milliseconds before an unconfirmed notification counts as lost
+#define TX_EVENT_QUEUE_SIZE 32       // BLE-to-controller confirm/congestion ring (power of two)
+
+// Input Task Settings
+#define INPUT_QUEUE_SIZE 32          // pending interrupt events
+#define INPUT_TASK_PRIORITY 6        // above the BLE init task, below the BT controller
+#define INPUT_TASK_STACK 6144        // bytes
+#define INPUT_TASK_CORE 1            // Arduino core; BLE runs on core 0
+
+// Keystroke Scheduler Settings
+#define KEY_SCHEDULER_QUEUE_SIZE 32  // maximum queued press/hold/release steps
 
 // Animation Settings
 #define LED_ANIMATION_SPEED 100  // milliseconds
+#define LED_FRAME_INTERVAL 20    // milliseconds - animation tick period (50 fps)
+#define LED_MAX_KEYFRAMES 8      // maximum keyframes in one animation sequence
 
 // Touch Sensor Settings
+#define TOUCH_MAX_PADS 14              // the S3 has 14 touch channels (GPIO 1-14)
+#define TOUCH_MUTE_PIN 4               // mute pad
+#define TOUCH_PTT_PIN 0                // dedicated push-to-talk pad, 0 = not fitted
 #define CALIBRATION_INTERVAL 5000 // milliseconds
+#define CALIBRATION_SAMPLES 200        // samples averaged per calibration stage
+#define CALIBRATION_SAMPLE_INTERVAL 5  // milliseconds between calibration samples
+#define TOUCH_MIN_SEPARATION 6         // touched/untouched gap needed, in noise standard deviations
+
+// Touch Peripheral Settings
+#ifndef TOUCH_HW_FSM
+#define TOUCH_HW_FSM 1                  // 1 = hardware scanning, smoothing and benchmark; 0 = software filter and baseline
+#endif
+#define TOUCH_FSM_SLEEP_CYCLES 150      // RTC slow clock cycles between sweeps (~1 ms at 150 kHz)
+#define TOUCH_FSM_MEAS_CYCLES 500       // charge/discharge cycles per pad measurement
+
+// Touch Detection Pipeline (fixed point, sample-count based)
+#define TOUCH_SAMPLE_INTERVAL 2         // milliseconds between samples while a touch is in progress
+#define TOUCH_IDLE_SAMPLE_INTERVAL 100  // milliseconds between samples while idle (baseline tracking)
+#define TOUCH_FILTER_SHIFT 1            // IIR low-pass: each sample moves the output 1/2^n of the way
+#define TOUCH_BASELINE_INTERVAL 100     // milliseconds between baseline tracker steps
+#define TOUCH_BASELINE_SHIFT 6          // baseline follows 1/2^n of the error per step (~6.4 s time constant)
+#define TOUCH_RELEASE_PERCENT 60        // release threshold as a percentage of the press threshold
+#define TOUCH_THRESHOLD_PERCENT 0       // press threshold as % of the way to the touched level, 0 = equal noise margins
+#if TOUCH_HW_FSM
+#define TOUCH_PRESS_SAMPLES 1           // the peripheral debounces before it interrupts
+#define TOUCH_RELEASE_SAMPLES 1
+#else
+#define TOUCH_PRESS_SAMPLES 2           // consecutive samples past the press threshold to register a touch
+#define TOUCH_RELEASE_SAMPLES 2         // consecutive samples below the release threshold to register a release
+#endif
+
+// Touch Telemetry Settings (serial command t1 / t0)
+#define TOUCH_TELEMETRY_INTERVAL 1        // milliseconds between samples while streaming (1 kHz)
+#define TOUCH_TELEMETRY_BATCH 10          // samples per binary frame
+#define TOUCH_TELEMETRY_KEYFRAME 100      // frames between keyframes carrying absolute values
+#define TOUCH_TELEMETRY_FRAME_MAX 512     // bytes per frame, header and checksum included
+#define TOUCH_TELEMETRY_TASK_PRIORITY 1   // below the input task, so streaming never delays input
+#define TOUCH_TELEMETRY_TASK_STACK 3072   // bytes
+
+// Log Drain Task Settings (ring sizes are in logger.h)
+#define LOG_TASK_PRIORITY 1               // below the input task; logging never delays input
+#define LOG_TASK_STACK 3072               // bytes, snprintf included
+#define LOG_TASK_CORE INPUT_TASK_CORE
+
+// Loop Profiling Settings (serial command p1 / p0)
+#ifndef PROFILING
+#define PROFILING 1                       // 0 compiles the probes out; 1 costs one flag test per probe while stopped
+#endif
+#define PROFILE_PASS_BUDGET 1000          // microseconds; a longer input pass counts as an overrun
+
+// Event Trace Settings (serial command d)
+#ifndef TRACING
+#define TRACING 1                         // 0 compiles the trace points out
+#endif
+#define TRACE_BUFFER_SIZE 256             // most recent events kept (power of two), 12 bytes each
 
 #endif // CONFIG_H
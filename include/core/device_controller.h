@@ -4,6 +4,8 @@
 #include "hardware/button.h"
 #include "hardware/touch_sensor.h"
 #include "hardware/rotary_encoder.h"
+#include "core/latency_histogram.h"
+#include "hal/hid_transport.h"
 
 /**
  * @brief Main controller class that manages all device functionality
@@ -26,22 +28,61 @@ private:
     bool touchPressed = false;
     bool encoderVolumeMode = true;  // true = volume control, false = arrow keys
     
+    // Input pipeline state
+    uint32_t pendingEventTime = 0;  // micros() of the oldest edge being handled, 0 if none
+    uint32_t eventsProcessed = 0;
+    LatencyHistogram reportLatency; // Edge to the first host confirming the headset report
+    uint8_t awaitedReport = 0;      // Headset report whose confirm ends a latency sample
+    uint32_t awaitedEventTime = 0;  // Its edge, 0 if nothing is awaited
+    uint32_t reportFailures = 0;    // Headset reports refused, or attempts the stack failed
+    
     // Static instance pointer for callbacks
     static DeviceController* instance;
 
 public:
     DeviceController();
     
+    // The running controller, for diagnostics (nullptr before construction)
+    static DeviceController* getInstance() { return instance; }
+    
     /**
      * @brief Initialize all hardware components and communication protocols
      */
     void begin();
     
     /**
-     * @brief Update all components - should be called in main loop
+     * @brief Update all components - one pass of the input loop
      */
     void update();
     
+    /**
+     * @brief Start the input task that blocks on interrupt events and runs update()
+     */
+    void startInputTask();
+    
+    /**
+     * @brief Input task body: wait for an event or the next deadline, then update()
+     */
+    void run();
+    
+    /**
+     * @brief One pass of the input task: drain queued events (waiting up to
+     * timeoutMs for the first one), then update(). The native simulation
+     * calls this directly instead of starting the task.
+     */
+    void step(uint32_t timeoutMs);
+    
+    /**
+     * @brief How long the input task may sleep before some component needs a pass
+     */
+    uint32_t nextWakeTimeout();
+    
+    // Input pipeline statistics
+    uint32_t getEventsProcessed() const { return eventsProcessed; }
+    const LatencyHistogram& getReportLatency() const { return reportLatency; }
+    uint32_t getReportFailures() const { return reportFailures; }
+    void resetInputStats() { eventsProcessed = 0; reportFailures = 0; reportLatency.reset(); }
+    
     /**
      * @brief Update call state for all connected clients
      * @param muteValue Mute state to send
@@ -71,28 +112,35 @@ public:
     void toggleEncoderMode() { encoderVolumeMode = !encoderVolumeMode; }
     
     /**
-     * @brief Handle host state updates from Bluetooth
+     * @brief Handle host state updates from Bluetooth (controller task only)
      * @param callActive Whether a call is active
      * @param muteState Whether the call should be muted
      */
     void onHostStateUpdate(bool callActive, bool muteState);
+    
+    /**
+     * @brief Apply events queued by the BLE stack since the last pass
+     */
+    void processHostEvents();
 
 private:
     // Event handlers (instance methods)
     void onLeftButtonEvent(ButtonEvent event);
     void onRightButtonEvent(ButtonEvent event);
     void onEncoderButtonEvent(ButtonEvent event);
-    void onTouchEvent(TouchEvent event);
-    void onEncoderEvent(EncoderEvent event);
+    void onTouchEvent(TouchEvent event, uint8_t pad);
+    void onEncoderEvent(EncoderEvent event, uint8_t detents, uint8_t steps);
     void updateLedCallStatus();
+    void onReportDelivered(HidChannel channel, uint16_t connId, uint8_t firstByte, bool delivered);
+    
+    static void inputTask(void* pvParameters);
     
     // Static callback functions for hardware (C-style callbacks)
     static void staticLeftButtonCallback(ButtonEvent event);
     static void staticRightButtonCallback(ButtonEvent event);
     static void staticEncoderButtonCallback(ButtonEvent event);
-    static void staticTouchCallback(TouchEvent event);
-    static void staticEncoderCallback(EncoderEvent event);
-    
-    // Static callback for host state updates
-    static void staticHostStateCallback(bool callActive, bool muteState);
+    static void staticTouchCallback(TouchEvent event, uint8_t pad);
+    static void staticEncoderCallback(EncoderEvent event, uint8_t detents, uint8_t steps);
+    static uint8_t staticHeadsetState();
+    static void staticDeliveryCallback(HidChannel channel, uint16_t connId, uint8_t firstByte, bool delivered);
 };
@@ -0,0 +1,113 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "hal/hid_transport.h"
+
+// Host ids in trace arguments: a connId in one byte, with the top values reserved
+#define TRACE_ALL_HOSTS   0xFF  // broadcast notification
+#define TRACE_OTHER_HOST  0xFE  // connId too large for a byte
+
+// Pipeline stages that leave a trace event; arguments in brackets
+enum TraceType : uint8_t {
+    TRACE_TOUCH_EDGE,    // touch threshold interrupt [pad]
+    TRACE_BUTTON_EDGE,   // button pin change [pin, pressed]
+    TRACE_WAKE,          // input task woken by an event [InputSource, pin]
+    TRACE_TOUCH,         // debounced touch event [pad, TouchEvent]
+    TRACE_BUTTON,        // decoded button event [pin, ButtonEvent]
+    TRACE_CALL_STATE,    // controller sends telephony state [report value, call active]
+    TRACE_HOST_STATE,    // controller applies host call state [call active, mute]
+    TRACE_NOTIFY,        // notification handed to the stack [host id, HidChannel, first byte]
+    TRACE_NOTIFY_DONE,   // stack reports on a notification [host id, TxEventType]
+    TRACE_HOST_WRITE,    // host writes its LED output report [host id, report byte]
+    TRACE_TYPE_COUNT
+};
+
+struct TraceEvent {
+    uint32_t time;  // micros()
+    uint8_t type;   // TraceType
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+};
+
+/*
+ * Flight recorder for the mute pipeline: the last TRACE_BUFFER_SIZE events
+ * from touch edge to host LED echo, stamped in microseconds.
+ *
+ * record() may be called from any task, and recordAt() also from interrupt
+ * handlers; it sits in IRAM so it still runs while the flash cache is off.
+ * It claims a slot with one atomic increment and overwrites the oldest
+ * event, so it never blocks and never allocates. Each slot carries the position it was
+ * written for, published after the event, so a reader can tell a complete
+ * event from one that is being overwritten.
+ *
+ * Dump format (serial command d), oldest first, one event per line:
+ *
+ *   trace <micros> <type name> <a> <b> <c>
+ *
+ * The trace env (src/trace/) turns a captured serial log into Chrome
+ * trace-event JSON; lines without the prefix are ignored.
+ */
+class EventTrace {
+public:
+    constexpr EventTrace() : slots(), head(0), enabled(true) {}
+
+    void record(TraceType type, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0) {
+        if (TRACING && isEnabled()) recordAt(micros(), type, a, b, c);
+    }
+
+    // For stages that already took their timestamp (interrupt handlers)
+    void IRAM_ATTR recordAt(uint32_t time, TraceType type, uint8_t a = 0, uint8_t b = 0, uint8_t c = 0) {
+        if (!TRACING || !isEnabled()) return;
+        uint32_t pos = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[pos & (TRACE_BUFFER_SIZE - 1)];
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event.time = time;
+        slot.event.type = type;
+        slot.event.a = a;
+        slot.event.b = b;
+        slot.event.c = c;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    // Stopping keeps the events leading up to it; start() clears
+    void start();
+    void stop() { enabled.store(false, std::memory_order_relaxed); }
+    bool IRAM_ATTR isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Events recorded since start(), including overwritten ones
+    uint32_t getRecorded() const { return head.load(std::memory_order_relaxed); }
+
+    // Copy the event at a position, false if it is gone or still being written
+    bool read(uint32_t pos, TraceEvent& event) const;
+
+    // Positions still held: [getOldest(), getRecorded())
+    uint32_t getOldest() const;
+
+    static const char* getTypeName(uint8_t type);
+
+    // Host id argument for a connId; never TRACE_ALL_HOSTS unless it is HID_ALL_HOSTS
+    static uint8_t hostId(uint16_t connId) {
+        if (connId == HID_ALL_HOSTS) return TRACE_ALL_HOSTS;
+        return connId < TRACE_OTHER_HOST ? (uint8_t)connId : TRACE_OTHER_HOST;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence{0};  // position + 1 once written, 0 while writing
+        TraceEvent event = {};
+    };
+
+    Slot slots[TRACE_BUFFER_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<bool> enabled;
+};
+
+// Global accessor function
+EventTrace& getEventTrace();
+
+#endif // EVENT_TRACE_H
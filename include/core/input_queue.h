@@ -0,0 +1,61 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Where an input wake-up came from
+enum InputSource : uint8_t {
+    INPUT_SOURCE_BUTTON,
+    INPUT_SOURCE_ENCODER,
+    INPUT_SOURCE_TOUCH,
+    INPUT_SOURCE_SERIAL,
+    INPUT_SOURCE_HOST     // BLE host state change or transmit progress, handled promptly
+};
+
+// Timestamped event pushed by an interrupt handler
+struct InputEvent {
+    uint32_t timestamp;  // micros() at the edge
+    InputSource source;
+    uint8_t pin;
+};
+
+#define INPUT_WAIT_FOREVER 0xFFFFFFFFUL
+
+/*
+ * ISR-safe queue between the input interrupts and the input task.
+ * Events only wake the task and carry the edge timestamp; the components
+ * still read their own hardware state when the task runs.
+ *
+ * Implemented per platform: a FreeRTOS queue on the ESP32, a plain ring
+ * in the native simulation.
+ */
+class InputQueue {
+public:
+    InputQueue();
+    
+    void begin();
+    
+    // Push from interrupt context; drops the event if the queue is full
+    void pushFromISR(InputSource source, uint8_t pin);
+    
+    // Push from task context
+    void push(InputSource source, uint8_t pin);
+    
+    // Block until an event arrives or timeoutMs elapses (INPUT_WAIT_FOREVER to block indefinitely)
+    bool wait(InputEvent& event, uint32_t timeoutMs);
+    
+    // Nothing waiting, so the task would block
+    bool isEmpty() const;
+    
+    uint32_t getDropped() const { return dropped; }
+
+private:
+    void* queue;  // Platform queue handle
+    volatile uint32_t dropped;
+};
+
+// Global accessor function
+InputQueue& getInputQueue();
+
+#endif // INPUT_QUEUE_H
@@ -0,0 +1,84 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+/*
+ * Fixed-size log-linear histogram for latency samples. The unit is the
+ * caller's: microseconds unless the owner's accessor says otherwise.
+ *
+ * Values below 16 get one bucket each; above that every power of two is
+ * split into 4 sub-buckets, so percentiles are accurate to ~25%. Samples
+ * from 2^24 up (~16 s in microseconds) land in the last bucket, which
+ * clamps percentiles but not min/max. No allocation, O(1) record.
+ */
+class LatencyHistogram {
+public:
+    static const uint8_t LINEAR_BUCKETS = 16;
+    static const uint8_t SUB_BUCKETS = 4;
+    static const uint8_t MAX_EXPONENT = 24;
+    static const uint8_t NUM_BUCKETS = LINEAR_BUCKETS + (MAX_EXPONENT - 4) * SUB_BUCKETS;
+
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        sum = 0;
+        minValue = UINT32_MAX;
+        maxValue = 0;
+    }
+
+    void record(uint32_t value) {
+        buckets[bucketFor(value)]++;
+        count++;
+        sum += value;
+        if (value < minValue) minValue = value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    uint32_t getCount() const { return count; }
+    uint32_t getMin() const { return count ? minValue : 0; }
+    uint32_t getMax() const { return maxValue; }
+    uint32_t getMean() const { return count ? (uint32_t)(sum / count) : 0; }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint32_t getPercentile(uint8_t percentile) const {
+        if (count == 0) return 0;
+        uint32_t target = ((uint64_t)count * percentile + 99) / 100;
+        if (target == 0) target = 1;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < NUM_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= target) {
+                uint32_t upper = bucketUpperBound(i);
+                return upper < maxValue ? upper : maxValue;
+            }
+        }
+        return maxValue;
+    }
+
+private:
+    uint32_t buckets[NUM_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint32_t minValue;
+    uint32_t maxValue;
+
+    static uint8_t bucketFor(uint32_t value) {
+        if (value < LINEAR_BUCKETS) return value;
+        uint8_t exponent = 31 - __builtin_clz(value);
+        if (exponent >= MAX_EXPONENT) return NUM_BUCKETS - 1;
+        uint8_t sub = (value >> (exponent - 2)) & (SUB_BUCKETS - 1);
+        return LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + sub;
+    }
+
+    static uint32_t bucketUpperBound(uint8_t index) {
+        if (index < LINEAR_BUCKETS) return index;
+        uint8_t exponent = 4 + (index - LINEAR_BUCKETS) / SUB_BUCKETS;
+        uint8_t sub = (index - LINEAR_BUCKETS) % SUB_BUCKETS;
+        return (1UL << exponent) + ((uint32_t)(sub + 1) << (exponent - 2)) - 1;
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
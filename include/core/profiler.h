@@ -0,0 +1,124 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "core/latency_histogram.h"
+#include "hal/clock.h"
+#include "config.h"
+
+// Timed stretches of one input pass, in update() order
+enum ProfileSection : uint8_t {
+    PROFILE_HOST_EVENTS,
+    PROFILE_BUTTONS,
+    PROFILE_TOUCH,
+    PROFILE_ENCODER,
+    PROFILE_SERIAL,
+    PROFILE_TELEMETRY,
+    PROFILE_KEYBOARD,
+    PROFILE_BLE,
+    PROFILE_LED_ANIMATOR,
+    PROFILE_LED_STRIP,
+    PROFILE_PASS,          // the whole pass, queue drain included
+    PROFILE_SECTION_COUNT
+};
+
+// Tasks whose busy time is accounted
+enum ProfileTask : uint8_t {
+    PROFILE_TASK_INPUT,
+    PROFILE_TASK_LOG,
+    PROFILE_TASK_TELEMETRY,
+    PROFILE_TASK_COUNT
+};
+
+/*
+ * Input loop profiler.
+ *
+ * update() chains lap() calls so every component is timed on the cycle
+ * counter with one counter read between neighbours; the durations go into
+ * fixed-bucket histograms in hundredths of a microsecond, which keeps
+ * sub-microsecond sections readable and reaches ~167 ms before the top
+ * bucket. Each pass also records the time since
+ * the previous one, how late a deadline wake came, and whether the pass ran
+ * past PROFILE_PASS_BUDGET. The log and telemetry tasks bracket their work
+ * with busyStart()/busyEnd(), so each task's share of the CPU is its busy
+ * time over the time since start().
+ *
+ * start() and stop() take effect at the next pass, so a pass is timed
+ * either completely or not at all. While stopped a probe is one flag test;
+ * building with PROFILING 0 removes the probes.
+ */
+class Profiler {
+public:
+    Profiler();
+
+    // Clear all statistics and profile from the next pass on
+    void start();
+    void stop();
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Input task: bracket one pass; deadline is true when the wait timed out
+    void beginPass(bool deadline, uint32_t timeoutMs);
+    void endPass();
+
+    // Input task: cycle count to time the first section from (0 while stopped);
+    // lap() records the section that ran since 'since' and returns the next mark
+    uint32_t mark() const { return isActive() ? hal::cycles() : 0; }
+    uint32_t lap(ProfileSection section, uint32_t since) {
+        if (!isActive()) return 0;
+        uint32_t now = hal::cycles();
+        sections[section].record(toCentiMicros(now - since));
+        return now;
+    }
+
+    // Any task: bracket a stretch of work (busyStart() is 0 while stopped)
+    uint32_t busyStart() const { return (PROFILING && isEnabled()) ? hal::micros() : 0; }
+    void busyEnd(ProfileTask task, uint32_t start) {
+        if (start) busyMicros[task].fetch_add(hal::micros() - start, std::memory_order_relaxed);
+    }
+
+    // Statistics; section durations are in hundredths of a microsecond, the rest in microseconds
+    const LatencyHistogram& getSection(ProfileSection section) const { return sections[section]; }
+    const LatencyHistogram& getPeriod() const { return period; }
+    const LatencyHistogram& getLateness() const { return lateness; }
+    uint32_t getPasses() const { return passes; }
+    uint32_t getOverruns() const { return overruns; }
+    uint32_t getBusyMicros(ProfileTask task) const { return busyMicros[task].load(std::memory_order_relaxed); }
+    uint32_t getElapsedMicros() const;
+
+    static const char* getSectionName(ProfileSection section);
+    static const char* getTaskName(ProfileTask task);
+
+private:
+    std::atomic<bool> enabled;
+    std::atomic<bool> resetPending;
+    bool active;                       // enabled, as latched for the current pass
+    uint32_t cyclesPerMicro;
+    uint32_t startTime;                // micros() at the reset
+    uint32_t stopTime;
+
+    LatencyHistogram sections[PROFILE_SECTION_COUNT];
+    LatencyHistogram period;           // pass start to pass start
+    LatencyHistogram lateness;         // deadline wake after its deadline
+    uint32_t passes;
+    uint32_t overruns;
+    std::atomic<uint32_t> busyMicros[PROFILE_TASK_COUNT];
+
+    uint32_t passStartCycles;
+    uint32_t passStartTime;
+    uint32_t lastPassStartTime;
+    uint32_t lastPassEndTime;          // when the task went back to sleep
+
+    bool isActive() const { return PROFILING && active; }
+    
+    // Cycles to hundredths of a microsecond, without a 64-bit divide
+    uint32_t toCentiMicros(uint32_t cycles) const {
+        return cycles < UINT32_MAX / 100 ? cycles * 100 / cyclesPerMicro : cycles / cyclesPerMicro * 100;
+    }
+    void reset();
+};
+
+// Global accessor function
+Profiler& getProfiler();
+
+#endif // PROFILER_H
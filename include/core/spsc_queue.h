@@ -0,0 +1,58 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * One task may push and one other task may pop without locks or critical
+ * sections: each side only writes its own index and publishes it with
+ * release ordering. Capacity must be a power of two. push() fails instead
+ * of blocking when the ring is full.
+ */
+template <typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0), dropped(0) {}
+
+    // Producer side
+    bool push(const T& item) {
+        uint32_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) == Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        buffer[currentHead & (Capacity - 1)] = item;
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T& item) {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = buffer[currentTail & (Capacity - 1)];
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    T buffer[Capacity];
+    std::atomic<uint32_t> head;     // Written by the producer only
+    std::atomic<uint32_t> tail;     // Written by the consumer only
+    std::atomic<uint32_t> dropped;
+};
+
+#endif // SPSC_QUEUE_H
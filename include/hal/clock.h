@@ -0,0 +1,24 @@
+#ifndef HAL_CLOCK_H
+#define HAL_CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * Time base. On the ESP32 this is the Arduino/esp_timer clock; the native
+ * build uses a simulated clock that only moves when the simulation
+ * advances it, so runs are deterministic and faster than real time.
+ */
+namespace hal {
+
+uint32_t millis();
+uint32_t micros();
+void delayMs(uint32_t ms);
+
+// Free-running cycle counter for timing short stretches of code (wraps;
+// take differences only). The native build counts host nanoseconds instead
+uint32_t cycles();
+uint32_t cyclesPerMicro();
+
+} // namespace hal
+
+#endif // HAL_CLOCK_H
@@ -0,0 +1,95 @@
+#ifndef BLE_HID_TRANSPORT_H
+#define BLE_HID_TRANSPORT_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "BLEDevice.h"
+#include "BLEServer.h"
+#include "BLEUtils.h"
+#include "BLEHIDDevice.h"
+#include "esp_gatts_api.h"
+#include "esp_gap_ble_api.h"
+#include "HIDTypes.h"
+#include "hal/hid_transport.h"
+#include "hidmap.h"
+#include "config.h"
+
+// Forward declarations
+class MultiClientServerCallbacks;
+class OutputCallbacks;
+
+/*
+ * HID-over-GATT transport on the Bluedroid stack. Owns the BLE server,
+ * the HID service and its report characteristics.
+ */
+class BleHidTransport : public HidTransport {
+public:
+    BleHidTransport();
+
+    void begin() override;
+    void startAdvertising() override;
+    bool isReady() const override { return (headsetInput != nullptr && keyboardInput != nullptr && consumerInput != nullptr); }
+    bool send(HidChannel channel, const uint8_t* report, size_t length, uint16_t connId) override;
+    void requestLinkProfile(uint16_t connId, HidLinkProfile profile) override;
+
+private:
+    friend class MultiClientServerCallbacks; // Allow the callback to re-enable notifications
+    friend void bluetoothTask(void*); // Allow the task to access private members
+
+    BLEHIDDevice* hid;
+    BLECharacteristic* headsetInput;
+    BLECharacteristic* headsetOutput;
+    BLECharacteristic* keyboardInput;  // Added keyboard input characteristic
+    BLECharacteristic* consumerInput;  // Added consumer control input characteristic
+    BLEServer* pServer;
+
+    // Parameter updates are addressed by device address, events report it back
+    struct PeerInfo {
+        bool connected;
+        uint16_t connId;
+        esp_bd_addr_t address;
+    };
+
+    // Written by the BLE task only, read by the controller task too (send(),
+    // requestLinkProfile()): the version is odd while a write is under way,
+    // so a reader retries instead of seeing a half-updated peer
+    struct Peer {
+        std::atomic<uint32_t> version{0};
+        PeerInfo info = {};
+    };
+    Peer peers[MAX_BLE_CONNECTIONS];
+
+    void initBLE();
+    BLECharacteristic* characteristicFor(HidChannel channel) const;
+    PeerInfo readPeer(uint8_t index) const;
+    bool findPeer(uint16_t connId, PeerInfo& peer) const;
+    void writePeer(uint8_t index, const PeerInfo& info);
+    void addPeer(uint16_t connId, const esp_bd_addr_t address);
+    void removePeer(uint16_t connId);
+
+    bool isInputHandle(uint16_t handle) const;
+
+    static void gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param);
+    static void gattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param);
+};
+
+/*
+ * Callbacks for BLE Server connection events.
+ */
+class MultiClientServerCallbacks : public BLEServerCallbacks {
+public:
+    MultiClientServerCallbacks() {}
+    
+    void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+    void onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) override;
+};
+
+/*
+ * Callback for handling output reports from host
+ */
+class OutputCallbacks : public BLECharacteristicCallbacks {
+public:
+    void onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) override;
+};
+
+#endif // BLE_HID_TRANSPORT_H
@@ -0,0 +1,64 @@
+#ifndef ESP32_LED_TRANSPORTS_H
+#define ESP32_LED_TRANSPORTS_H
+
+#include <Arduino.h>
+#include <Adafruit_DotStar.h>
+#include "driver/spi_master.h"
+#include "hal/led_transport.h"
+#include "config.h"
+
+/*
+ * Software bit-banged output through Adafruit_DotStar. The CPU toggles the
+ * data and clock pins for every bit, so write() costs the whole frame time.
+ */
+class DotStarTransport : public LedTransport {
+public:
+    DotStarTransport(uint16_t maxPixels, uint8_t dataPin, uint8_t clockPin, uint8_t colorOrder);
+
+    bool begin(uint16_t numPixels) override;
+    void end() override;
+    void write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) override;
+    const char* getName() const override { return "DotStar bit-bang"; }
+
+private:
+    Adafruit_DotStar strip;
+    uint8_t dataPin;
+    uint8_t clockPin;
+};
+
+/*
+ * Hardware SPI output with DMA. Frames are encoded into one of two DMA
+ * buffers and queued on the SPI peripheral; write() returns as soon as the
+ * transaction is queued while the previous buffer may still be clocking out.
+ */
+class SpiDmaLedTransport : public LedTransport {
+public:
+    SpiDmaLedTransport(uint8_t dataPin, uint8_t clockPin, uint8_t colorOrder,
+                       uint32_t clockHz = LED_SPI_CLOCK_HZ, spi_host_device_t host = SPI2_HOST);
+
+    bool begin(uint16_t numPixels) override;
+    void end() override;
+    void write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) override;
+    void flush() override;
+    const char* getName() const override { return "SPI DMA"; }
+
+private:
+    static const uint8_t BUFFER_COUNT = 2;
+
+    uint8_t dataPin;
+    uint8_t clockPin;
+    uint8_t rOffset, gOffset, bOffset;
+    uint32_t clockHz;
+    spi_host_device_t host;
+    spi_device_handle_t device;
+    uint8_t* buffers[BUFFER_COUNT];
+    spi_transaction_t transactions[BUFFER_COUNT];
+    bool inFlight[BUFFER_COUNT];
+    uint8_t nextBuffer;
+    size_t frameLength;
+
+    void reapCompleted(bool block);
+    size_t encodeFrame(uint8_t* buffer, const uint32_t* pixels, uint16_t numPixels, uint8_t brightness);
+};
+
+#endif // ESP32_LED_TRANSPORTS_H
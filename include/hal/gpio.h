@@ -0,0 +1,25 @@
+#ifndef HAL_GPIO_H
+#define HAL_GPIO_H
+
+#include <stdint.h>
+
+// Interrupt handler taking a user argument
+typedef void (*HalIsr)(void* arg);
+
+// Which edges raise a pin interrupt
+enum HalEdge : uint8_t {
+    HAL_EDGE_RISING,
+    HAL_EDGE_FALLING,
+    HAL_EDGE_BOTH
+};
+
+namespace hal {
+
+void gpioInputPullup(uint8_t pin);
+bool gpioRead(uint8_t pin);  // true = high
+void gpioAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, HalEdge edge);
+void gpioDetachInterrupt(uint8_t pin);
+
+} // namespace hal
+
+#endif // HAL_GPIO_H
@@ -0,0 +1,55 @@
+#ifndef HAL_HID_TRANSPORT_H
+#define HAL_HID_TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Input report characteristics exposed to the hosts
+enum HidChannel : uint8_t {
+    HID_CHANNEL_HEADSET,
+    HID_CHANNEL_KEYBOARD,
+    HID_CHANNEL_CONSUMER,
+    HID_CHANNEL_COUNT
+};
+
+#define HID_ALL_HOSTS 0xFFFF  // connId that notifies every connected host
+
+// Connection parameter sets the handler asks a host for
+enum HidLinkProfile : uint8_t {
+    HID_LINK_IDLE,  // long interval with peripheral latency (BLE_IDLE_...)
+    HID_LINK_FAST   // shortest interval, no latency (BLE_FAST_...)
+};
+
+/*
+ * Link to the HID hosts. The BLE implementation runs the Bluedroid stack;
+ * the native one records reports for the simulator. Connection, connection
+ * parameter, output report, notification confirm and congestion events are
+ * delivered to BluetoothHandler's on...() methods from the transport's own
+ * task.
+ */
+class HidTransport {
+public:
+    virtual ~HidTransport() {}
+
+    // Start the stack (may finish asynchronously)
+    virtual void begin() = 0;
+    virtual void startAdvertising() = 0;
+    virtual bool isReady() const = 0;
+
+    // Notify an input report to one host, or to all of them with HID_ALL_HOSTS.
+    // False if the stack refused it; once accepted, each host's notification is
+    // answered in order through BluetoothHandler::onNotifyComplete()
+    virtual bool send(HidChannel channel, const uint8_t* report, size_t length, uint16_t connId) = 0;
+
+    // Ask a host to switch connection parameters; the outcome arrives
+    // through BluetoothHandler::onConnectionParams()
+    virtual void requestLinkProfile(uint16_t connId, HidLinkProfile profile) = 0;
+};
+
+namespace hal {
+
+HidTransport& getHidTransport();
+
+} // namespace hal
+
+#endif // HAL_HID_TRANSPORT_H
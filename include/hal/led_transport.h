@@ -0,0 +1,37 @@
+#ifndef HAL_LED_TRANSPORT_H
+#define HAL_LED_TRANSPORT_H
+
+#include <stdint.h>
+
+/*
+ * Output stage for an APA102/DotStar strip.
+ *
+ * LedStrip keeps the pixel colors and brightness; a transport only turns a
+ * finished frame into bits on the wire. write() may return before the frame
+ * has been clocked out, flush() waits for it.
+ */
+class LedTransport {
+public:
+    virtual ~LedTransport() {}
+
+    virtual bool begin(uint16_t numPixels) = 0;
+    virtual void end() = 0;
+
+    // Push one frame of 0x00RRGGBB pixels scaled by brightness (0-255)
+    virtual void write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) = 0;
+
+    // Block until the last written frame is on the wire
+    virtual void flush() {}
+
+    virtual const char* getName() const = 0;
+};
+
+namespace hal {
+
+// Available transports; index 0 is the platform default
+uint8_t getLedTransportCount();
+LedTransport& getLedTransport(uint8_t index);
+
+} // namespace hal
+
+#endif // HAL_LED_TRANSPORT_H
@@ -0,0 +1,122 @@
+#ifndef NATIVE_COMPAT_ARDUINO_H
+#define NATIVE_COMPAT_ARDUINO_H
+
+/*
+ * Minimal Arduino API for the native build. Only what the firmware uses is
+ * provided; timing and pin functions forward to the simulated HAL so the
+ * code under simulation sees the same clock and pins as the simulator.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include "hal/clock.h"
+#include "hal/gpio.h"
+
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+using std::min;
+using std::max;
+
+inline unsigned long millis() { return hal::millis(); }
+inline unsigned long micros() { return hal::micros(); }
+inline void delay(uint32_t ms) { hal::delayMs(ms); }
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == INPUT_PULLUP) hal::gpioInputPullup(pin);
+}
+inline int digitalRead(uint8_t pin) { return hal::gpioRead(pin) ? HIGH : LOW; }
+inline void digitalWrite(uint8_t pin, uint8_t value) {}
+
+// Subset of the Arduino String class used by the firmware
+class String {
+public:
+    String(const char* text = "") : value(text ? text : "") {}
+    String(const std::string& text) : value(text) {}
+
+    unsigned int length() const { return value.length(); }
+    char charAt(unsigned int index) const { return index < value.length() ? value[index] : 0; }
+    String substring(unsigned int from) const { return from < value.length() ? String(value.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const { return from < value.length() ? String(value.substr(from, to - from)) : String(); }
+    long toInt() const { return atol(value.c_str()); }
+    const char* c_str() const { return value.c_str(); }
+
+    String& operator+=(char c) { value += c; return *this; }
+    String& operator+=(const char* text) { value += text; return *this; }
+    bool operator==(const char* text) const { return value == text; }
+
+private:
+    std::string value;
+};
+
+// Serial port backed by stdout; input is injected by the simulator
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) {}
+    void end() {}
+
+    int available() { return (int)(input.length() - inputPos); }
+    int read() { return inputPos < input.length() ? (uint8_t)input[inputPos++] : -1; }
+    int availableForWrite() { return 4096; }
+    void flush() { fflush(stdout); }
+
+    size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* data, size_t length) { return fwrite(data, 1, length, stdout); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, format);
+        int written = vprintf(format, args);
+        va_end(args);
+        return written > 0 ? written : 0;
+    }
+
+    size_t print(const char* text) { return fputs(text, stdout) >= 0 ? strlen(text) : 0; }
+    size_t print(const String& text) { return print(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+
+    void onReceive(std::function<void(void)> callback) { receiveCallback = callback; }
+
+    // Simulator side: queue bytes as if they arrived on the wire
+    void inject(const char* text) {
+        input.erase(0, inputPos);
+        inputPos = 0;
+        input += text;
+        if (receiveCallback) receiveCallback();
+    }
+
+private:
+    std::string input;
+    size_t inputPos = 0;
+    std::function<void(void)> receiveCallback;
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_COMPAT_ARDUINO_H
@@ -0,0 +1,43 @@
+#ifndef NATIVE_COMPAT_PREFERENCES_H
+#define NATIVE_COMPAT_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+/*
+ * In-memory stand-in for the ESP32 NVS Preferences API. Values live for the
+ * lifetime of the process and are shared by all instances, like NVS.
+ */
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) { space = name; return true; }
+    void end() {}
+
+    bool isKey(const char* key) { return store()[space].count(key) > 0; }
+    bool remove(const char* key) { return store()[space].erase(key) > 0; }
+    bool clear() { store()[space].clear(); return true; }
+
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { store()[space][key] = value; return sizeof(value); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return (int32_t)get(key, (uint32_t)defaultValue); }
+    size_t putInt(const char* key, int32_t value) { store()[space][key] = (uint32_t)value; return sizeof(value); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return (uint8_t)get(key, defaultValue); }
+    size_t putUChar(const char* key, uint8_t value) { store()[space][key] = value; return sizeof(value); }
+
+private:
+    std::string space;
+
+    static std::map<std::string, std::map<std::string, uint32_t>>& store() {
+        static std::map<std::string, std::map<std::string, uint32_t>> values;
+        return values;
+    }
+
+    uint32_t get(const char* key, uint32_t defaultValue) {
+        auto& values = store()[space];
+        auto it = values.find(key);
+        return it == values.end() ? defaultValue : it->second;
+    }
+};
+
+#endif // NATIVE_COMPAT_PREFERENCES_H
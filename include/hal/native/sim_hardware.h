@@ -0,0 +1,167 @@
+#ifndef SIM_HARDWARE_H
+#define SIM_HARDWARE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hal/hid_transport.h"
+#include "hal/led_transport.h"
+#include "core/latency_histogram.h"
+#include "config.h"
+
+/*
+ * Controls for the simulated hardware behind the native HAL. The simulator
+ * sets pin levels, touch readings and encoder counts, and the matching
+ * interrupt handlers run synchronously, like an ISR preempting the task.
+ * Touch pads go through a model of the S3 FSM instead: a new level reaches
+ * the raw and smoothed registers, and the threshold interrupt, only at the
+ * following sweeps, as virtual time moves past them.
+ */
+namespace sim {
+
+// Virtual time; nothing moves it except these calls and delay()
+uint64_t now();
+void advanceMicros(uint64_t us);
+void advanceMillis(uint32_t ms);
+// Next touch sweep that can change a register or fire, UINT64_MAX while all pads are settled
+uint64_t nextTouchSweep();
+
+// Inputs
+void setPin(uint8_t pin, bool high);
+void setTouch(uint8_t pin, uint32_t value);
+void setTouchNoise(uint8_t pin, uint32_t amplitude);  // readings vary by +/- amplitude
+// Exact register values from a recorded trace; benchmark 0 = track it like setTouch()
+void playTouch(uint8_t pin, uint32_t raw, uint32_t smoothed, uint32_t benchmark);
+void rotateEncoder(uint8_t unit, int32_t counts);
+void sendSerial(const char* text);
+
+// Host steady clock in nanoseconds, for measuring real CPU cost
+uint64_t hostNanos();
+
+#define SIM_HOST_INTERVAL 24  // 1.25 ms units: the 30 ms a host picks on its own
+
+// Record of one report sent through the simulated HID transport
+struct SentReport {
+    uint64_t time;       // simulated micros
+    uint64_t airTime;    // connection event that carries it to the (last) host
+    uint64_t hostTime;   // hostNanos() at send
+    HidChannel channel;
+    uint16_t connId;     // HID_ALL_HOSTS for a broadcast
+    uint8_t length;
+    uint8_t data[8];
+};
+
+/*
+ * HID transport that keeps every report in a fixed log instead of sending
+ * it. Host-side events are injected through the BluetoothHandler callbacks.
+ * Each host link has connection events every interval from the moment its
+ * parameters last changed; a report goes on air at the first one after it
+ * is sent, and that is when the stack confirms it. A notification sent
+ * while its link is congested fails at once.
+ */
+class SimHidTransport : public HidTransport {
+public:
+    static const size_t LOG_SIZE = 1024;
+
+    SimHidTransport();
+
+    void begin() override { ready = true; }
+    void startAdvertising() override {}
+    bool isReady() const override { return ready; }
+    bool send(HidChannel channel, const uint8_t* report, size_t length, uint16_t connId) override;
+    void requestLinkProfile(uint16_t connId, HidLinkProfile profile) override;
+
+    // Host side
+    void connectHost(uint16_t connId);
+    void disconnectHost(uint16_t connId);
+    void writeHostLeds(uint16_t connId, uint8_t value);
+    // A host that refuses parameter updates stays on SIM_HOST_INTERVAL
+    void setAcceptsLinkUpdates(bool accept);
+    uint16_t getInterval(uint16_t connId) const;
+    // A congested link drops what is sent to it, as the stack does
+    void setCongested(uint16_t connId, bool congested);
+
+    // Confirms are held until their connection event; the simulator hands
+    // over the due ones and wakes for the next
+    void deliverConfirms();
+    uint64_t getNextConfirmTime() const;  // simulated micros, UINT64_MAX if none
+    const LatencyHistogram& getConfirmLatency() const { return confirmLatency; }  // send to confirm, us
+    uint32_t getLateConfirms() const { return lateConfirms; }  // not within one interval of the send
+
+    // Sent reports; the log keeps the last LOG_SIZE entries
+    uint32_t getReportCount() const { return reportCount; }
+    uint32_t getReportCount(HidChannel channel) const { return channelCounts[channel]; }
+    const SentReport& getReport(uint32_t index) const { return reports[index % LOG_SIZE]; }
+    void clear();
+
+private:
+    struct Link {
+        bool connected;
+        uint16_t connId;
+        uint16_t interval;      // 1.25 ms units
+        uint64_t anchor;        // simulated micros of a connection event
+        HidLinkProfile requested;
+        bool congested;
+    };
+
+    struct PendingConfirm {
+        uint64_t due;           // the connection event carrying the notification
+        uint64_t sent;
+        uint32_t period;        // the link's interval in micros when it was sent
+        uint16_t connId;
+    };
+    static const uint8_t MAX_CONFIRMS = 16;
+
+    bool ready;
+    bool acceptsLinkUpdates;
+    Link links[MAX_BLE_CONNECTIONS];
+    PendingConfirm confirms[MAX_CONFIRMS];  // in send order
+    uint8_t confirmCount;
+    LatencyHistogram confirmLatency;
+    uint32_t lateConfirms;
+    SentReport reports[LOG_SIZE];
+    uint32_t reportCount;
+    uint32_t channelCounts[HID_CHANNEL_COUNT];
+
+    Link* findLink(uint16_t connId);
+    void setInterval(Link& link, uint16_t interval, uint16_t latency);
+    uint64_t nextEvent(const Link& link, uint64_t time) const;
+    void confirm(const PendingConfirm& pending);
+};
+
+/*
+ * LED transport that keeps the last frame for inspection, and when each
+ * recent frame was written.
+ */
+class SimLedTransport : public LedTransport {
+public:
+    static const size_t LOG_SIZE = 64;
+
+    SimLedTransport();
+
+    bool begin(uint16_t numPixels) override;
+    void end() override {}
+    void write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) override;
+    const char* getName() const override { return "Simulated"; }
+
+    // Frame times; the log keeps the last LOG_SIZE frames
+    uint32_t getFrameCount() const { return frameCount; }
+    uint64_t getFrameTime(uint32_t index) const { return frameTimes[index % LOG_SIZE]; }          // simulated micros
+    uint64_t getFrameHostTime(uint32_t index) const { return frameHostTimes[index % LOG_SIZE]; }  // hostNanos()
+    uint32_t getPixel(uint16_t index) const;
+    uint8_t getBrightness() const { return brightness; }
+
+private:
+    uint32_t frame[LED_MAX_PIXELS];
+    uint16_t numPixels;
+    uint8_t brightness;
+    uint32_t frameCount;
+    uint64_t frameTimes[LOG_SIZE];
+    uint64_t frameHostTimes[LOG_SIZE];
+};
+
+SimHidTransport& getHidTransport();
+SimLedTransport& getLedTransport();
+
+} // namespace sim
+
+#endif // SIM_HARDWARE_H
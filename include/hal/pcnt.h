@@ -0,0 +1,24 @@
+#ifndef HAL_PCNT_H
+#define HAL_PCNT_H
+
+#include <stdint.h>
+#include "hal/gpio.h"
+
+#define HAL_PCNT_UNITS 4
+
+enum HalPcntMode {
+    HAL_PCNT_SINGLE_EDGE,  // count one edge of A, two counts per quadrature cycle
+    HAL_PCNT_FULL_QUAD     // count both edges of A and B, four counts per cycle
+};
+
+namespace hal {
+
+// Attach a quadrature encoder to a pulse counter unit; isr fires on every count change.
+// Levels shorter than glitchFilter APB cycles are ignored by the peripheral (0 = off).
+void pcntAttach(uint8_t unit, uint8_t pinA, uint8_t pinB, HalPcntMode mode, uint16_t glitchFilter, HalIsr isr, void* arg);
+int64_t pcntGetCount(uint8_t unit);
+void pcntClearCount(uint8_t unit);
+
+} // namespace hal
+
+#endif // HAL_PCNT_H
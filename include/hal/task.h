@@ -0,0 +1,27 @@
+#ifndef HAL_TASK_H
+#define HAL_TASK_H
+
+#include <stdint.h>
+
+typedef void (*HalTaskFunction)(void* arg);
+typedef void* HalTaskHandle;
+
+#define HAL_WAIT_FOREVER 0xFFFFFFFFUL
+
+namespace hal {
+
+// Start a task; core < 0 lets the scheduler pick
+bool createTask(HalTaskFunction function, const char* name, uint32_t stackSize, void* arg, uint8_t priority, int8_t core = -1);
+
+// End the calling task; a task function must call this instead of returning
+void endTask();
+
+// Sleep/wake without polling: a task blocks in waitForNotify() until another
+// task notifies its handle (task context only, not from interrupts)
+HalTaskHandle currentTask();
+void notifyTask(HalTaskHandle task);
+bool waitForNotify(uint32_t timeoutMs);  // false on timeout
+
+} // namespace hal
+
+#endif // HAL_TASK_H
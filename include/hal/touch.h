@@ -0,0 +1,30 @@
+#ifndef HAL_TOUCH_H
+#define HAL_TOUCH_H
+
+#include <stdint.h>
+#include "hal/gpio.h"
+
+/*
+ * Capacitive touch pads. On the ESP32-S3 the peripheral scans the pads in
+ * timer-driven FSM mode, smooths each channel in hardware and keeps a
+ * benchmark (untouched level) per channel; reads only fetch registers.
+ */
+namespace hal {
+
+// Start background scanning of the given pads
+void touchBegin(const uint8_t* pins, uint8_t count);
+
+// Latest raw and hardware-smoothed measurements of a pad
+uint32_t touchReadRaw(uint8_t pin);
+uint32_t touchReadSmoothed(uint8_t pin);
+
+// Untouched level tracked by the peripheral; frozen while the pad is active
+uint32_t touchReadBenchmark(uint8_t pin);
+
+// Interrupt on crossings of benchmark + threshold, in both directions
+void touchAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, uint32_t threshold);
+void touchDetachInterrupt(uint8_t pin);
+
+} // namespace hal
+
+#endif // HAL_TOUCH_H
@@ -2,7 +2,7 @@
 #define BUTTON_H
 
 #include <Arduino.h>
-#include <PinButton.h>
+#include "core/spsc_queue.h"
 #include "config.h"
 
 // Event types that can be triggered by buttons
@@ -17,27 +17,104 @@ enum ButtonEvent {
 // Callback function type
 typedef void (*ButtonCallback)(ButtonEvent event);
 
+// Raw pin change captured by the edge interrupt
+struct ButtonEdge {
+    uint32_t time;  // micros() at the edge
+    bool pressed;   // pin level after the edge (active low)
+};
+
+/*
+ * Active-low push button decoded from GPIO edge interrupts.
+ *
+ * The interrupt only timestamps each edge into a per-button ring; update()
+ * replays the edges through an integrating debounce (the pin must have been
+ * down, net of bounce, for debounceTime before a press registers, and up as
+ * long before a release does) and a click / double-click / long-press state
+ * machine. Press and release are emitted as soon as they register, and every
+ * gesture is timed from the first edge of its bounce burst, so durations do
+ * not depend on how often update() runs.
+ *
+ * Buttons live in static storage and enter a fixed table on begin(), so the
+ * input task can update them all and sleep until the earliest deadline.
+ */
 class Button {
 public:
     // Constructor
     Button(uint8_t buttonPin, uint16_t debounceTime = DEBOUNCE_TIME, uint16_t longPressTime = LONG_PRESS_TIME, uint16_t doubleClickTime = DOUBLE_CLICK_TIME);
-    
-    // Initialization
+
+    // Initialization - configures the pin, attaches the edge interrupt and joins the button table
     void begin();
-    
+
     // Register callback for button events
     void setCallback(ButtonCallback callback);
-    
-    // Update method to be called in the main loop
+
+    // Process captured edges and expired gesture windows
     void update();
 
+    // Debounced state
+    bool isPressed() const { return pressed; }
+
+    // micros() at which the last event happened: the first edge of a press or
+    // release, or the instant a gesture window closed; and how long the last
+    // completed press was held
+    uint32_t getEventTime() const { return eventTime; }
+    uint32_t getPressDuration() const { return pressDuration; }
+
+    // Milliseconds until update() has something to resolve (UINT32_MAX if nothing pending)
+    uint32_t getTimeUntilNextEvent() const;
+
+    // Edges lost to a full ring; the pin is re-read when that happens
+    uint32_t getDroppedEdges() const { return edges.getDropped(); }
+
+    // Every button that has begun
+    static void updateAll();
+    static uint32_t getTimeUntilAnyEvent();
+    static uint8_t getCount() { return count; }
+    static Button* get(uint8_t index) { return index < count ? table[index] : nullptr; }
+
 private:
+    // Gesture state between debounced transitions
+    enum GestureState : uint8_t {
+        GESTURE_IDLE,
+        GESTURE_DOWN,          // first press, long press not yet reached
+        GESTURE_UP,            // released, double-click window open
+        GESTURE_SECOND_DOWN,   // second press of a double click
+        GESTURE_LONG           // long press reported, waiting for release
+    };
+
     uint8_t pin;
-    PinButton* button;
     ButtonCallback callback;
-    
-    // Custom configuration for the button
-    MultiButtonConfig buttonConfig;
+    uint32_t debounceTime;     // microseconds
+    uint32_t longPressTime;    // microseconds
+    uint32_t doubleClickTime;  // microseconds
+
+    SpscQueue<ButtonEdge, BUTTON_EDGE_QUEUE_SIZE> edges;
+
+    // Debounce: the raw level since the last edge and the integrated
+    // contact time, between 0 (released) and debounceTime (pressed)
+    bool rawPressed;
+    uint32_t rawTime;
+    uint32_t integrator;
+    bool pressed;
+    uint32_t transitionTime;   // first edge of the burst leaving the debounced state
+    uint32_t lastEdgeTime;
+
+    GestureState gesture;
+    uint32_t pressTime;
+    uint32_t releaseTime;
+    uint32_t eventTime;
+    uint32_t pressDuration;
+
+    void applyEdge(uint32_t time, bool level);
+    void integrate(uint32_t time);
+    void registerTransition();
+    void expireGestures(uint32_t time);
+    void emit(ButtonEvent event, uint32_t time);
+
+    static void onEdge(void* arg);
+
+    static Button* table[BUTTON_MAX_COUNT];
+    static uint8_t count;
 };
 
 #endif // BUTTON_H
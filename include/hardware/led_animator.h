@@ -0,0 +1,75 @@
+#ifndef LED_ANIMATOR_H
+#define LED_ANIMATOR_H
+
+#include <Arduino.h>
+#include "hardware/led_strip.h"
+#include "config.h"
+
+// How a keyframe reaches its color
+enum LedKeyframeMode : uint8_t {
+    LED_STEP,  // Jump to the color and hold it for the duration
+    LED_FADE   // Blend linearly from the previous color over the duration
+};
+
+// One step of an animation sequence
+struct LedKeyframe {
+    uint32_t color;
+    uint16_t duration;  // milliseconds
+    LedKeyframeMode mode;
+};
+
+/*
+ * Non-blocking keyframe animation engine on top of LedStrip.
+ *
+ * The animator keeps a base color (the call/mute status) and plays
+ * temporary sequences over it. Frames are computed from the timestamp of a
+ * fixed-rate tick, so a late loop pass never stretches an animation, and the
+ * base color is restored when the sequence finishes.
+ */
+class LedAnimator {
+public:
+    // Constructor
+    LedAnimator(LedStrip& strip);
+
+    // Play a keyframe sequence; repeat = 0 loops until stop() or another play()
+    void play(const LedKeyframe* frames, uint8_t count, uint8_t repeat = 1);
+
+    // Common sequences
+    void flash(uint32_t color, uint8_t times, uint16_t onTime, uint16_t offTime);
+    void blink(uint32_t color, uint16_t period);  // Loops until stopped
+    void fade(uint32_t fromColor, uint32_t toColor, uint16_t duration);
+    void pulse(uint32_t color, uint16_t period, uint8_t times);
+
+    // Cancel the running sequence and show the base color
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Color shown whenever no sequence is running
+    void setBaseColor(uint32_t color);
+    uint32_t getBaseColor() const { return baseColor; }
+
+    // Advance the running sequence - call from the main loop
+    void update();
+
+private:
+    LedStrip& strip;
+    LedKeyframe frames[LED_MAX_KEYFRAMES];
+    uint8_t frameCount;
+    uint8_t repeatCount;
+    uint32_t cycleDuration;
+    uint32_t startTime;
+    uint32_t lastTickTime;
+    bool running;
+    uint32_t baseColor;
+    uint32_t renderedColor;
+    bool renderValid;
+
+    void render(uint32_t color);
+    uint32_t colorAt(uint32_t elapsed) const;
+    static uint32_t blend(uint32_t from, uint32_t to, uint32_t position, uint32_t duration);
+};
+
+// Global accessor function
+LedAnimator& getLedAnimator();
+
+#endif // LED_ANIMATOR_H
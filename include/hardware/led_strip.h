@@ -2,14 +2,14 @@
 #define LED_STRIP_H
 
 #include <Arduino.h>
-#include <Adafruit_DotStar.h>
 #include <Preferences.h>
-#include <SPI.h>
+#include "hal/led_transport.h"
+#include "config.h"
 
 class LedStrip {
 public:
     // Constructor
-    LedStrip(uint16_t numPixels, uint8_t dataPin, uint8_t clockPin);
+    LedStrip(uint16_t numPixels, LedTransport* transport);
     
     // Initialization
     void begin(uint8_t brightness = 80);
@@ -23,23 +23,44 @@ public:
     void setPixelColor(uint16_t pixelIndex, uint32_t color);
     void setPixelColor(uint16_t pixelIndex, uint8_t r, uint8_t g, uint8_t b);
     void clear();
-    void show();
+    void show();  // Requests a frame; it goes out on the next update()
+    
+    // Push the framebuffer if anything changed since the last push - call once per tick
+    void update();
+    
+    // Frame counters: show() requests vs. frames actually sent to the transport
+    uint32_t getFramesRequested() const { return framesRequested; }
+    uint32_t getFramesPushed() const { return framesPushed; }
+    void resetFrameCounters() { framesRequested = 0; framesPushed = 0; }
+    
+    // Output transport (bit-bang or SPI DMA)
+    LedTransport* getTransport() const { return transport; }
+    bool setTransport(LedTransport* newTransport);
+    
+    // Average CPU time in microseconds spent in show() over the given number of frames
+    uint32_t benchmarkTransport(LedTransport* candidate, uint16_t frames);
     
     // Pre-defined colors
-    uint32_t colorRed() { return strip.Color(255, 0, 0); }
-    uint32_t colorGreen() { return strip.Color(0, 255, 0); }
-    uint32_t colorBlue() { return strip.Color(0, 0, 255); }
-    uint32_t colorYellow() { return strip.Color(255, 255, 0); }
-    uint32_t colorMagenta() { return strip.Color(255, 0, 255); }
-    uint32_t colorCyan() { return strip.Color(0, 255, 255); }
-    uint32_t colorWhite() { return strip.Color(255, 255, 255); }
-    uint32_t color(uint8_t r, uint8_t g, uint8_t b) { return strip.Color(r, g, b); }
+    uint32_t colorRed() { return color(255, 0, 0); }
+    uint32_t colorGreen() { return color(0, 255, 0); }
+    uint32_t colorBlue() { return color(0, 0, 255); }
+    uint32_t colorYellow() { return color(255, 255, 0); }
+    uint32_t colorMagenta() { return color(255, 0, 255); }
+    uint32_t colorCyan() { return color(0, 255, 255); }
+    uint32_t colorWhite() { return color(255, 255, 255); }
+    uint32_t color(uint8_t r, uint8_t g, uint8_t b) { return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b; }
 
 private:
-    Adafruit_DotStar strip;
+    uint16_t numPixels;
+    uint32_t pixels[LED_MAX_PIXELS];
+    LedTransport* transport;
     uint8_t _brightness;
+    bool dirty;                 // Framebuffer differs from what the strip shows
+    uint32_t framesRequested;
+    uint32_t framesPushed;
     Preferences preferences;
     
+    void pushFrame();
     void loadBrightness();
     void saveBrightness();
 };
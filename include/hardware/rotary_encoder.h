@@ -2,7 +2,6 @@
 #define ROTARY_ENCODER_H
 
 #include <Arduino.h>
-#include <ESP32Encoder.h>
 #include "button.h"
 
 // Event types that can be triggered by the rotary encoder
@@ -11,13 +10,14 @@ enum EncoderEvent {
     ENCODER_COUNTER_CLOCKWISE
 };
 
-// Callback function type
-typedef void (*EncoderCallback)(EncoderEvent event);
+// Callback function type: detents turned since the last event, and the
+// volume steps they are worth after acceleration (steps >= detents)
+typedef void (*EncoderCallback)(EncoderEvent event, uint8_t detents, uint8_t steps);
 
 class RotaryEncoder {
 public:
     // Constructor
-    RotaryEncoder(uint8_t pinA, uint8_t pinB, uint8_t buttonPin, uint16_t debounceTime = DEBOUNCE_TIME, uint16_t longPressTime = LONG_PRESS_TIME, uint16_t doubleClickTime = DOUBLE_CLICK_TIME);
+    RotaryEncoder(uint8_t pcntUnit, uint8_t pinA, uint8_t pinB, uint8_t buttonPin, uint16_t debounceTime = ENCODER_DEBOUNCE_TIME, uint16_t longPressTime = LONG_PRESS_TIME, uint16_t doubleClickTime = DOUBLE_CLICK_TIME);
     
     // Initialization
     void begin();
@@ -35,27 +35,33 @@ public:
     Button& getClickButton();
 
 private:
+    uint8_t pcntUnit;
     uint8_t pinA, pinB, buttonPin;
-    ESP32Encoder encoder;
-    int64_t lastCount;
     int64_t lastUpdateCount;
     
-    // Button instance for the rotary encoder's click
+    // Button instance for the rotary encoder's click, updated from the button table
     Button clickButton;
     
     EncoderCallback callback;
     
-    // Precision mode variables for accumulation
-    int notchAccumulator = 0;
-    EncoderEvent accumulatedDirection = ENCODER_CLOCKWISE;
-    unsigned long lastNotchTime = 0;
+    // Count at the detent the knob last rested in; the next detent
+    // registers ENCODER_DETENT_THRESHOLD counts away from it in either
+    // direction, so a count bouncing around a boundary cannot chatter
+    int64_t detentCount = 0;
     
-    // Directional bounce filtering
+    // Acceleration: time and direction of the last emitted detents and the
+    // fractional step (1/256ths) carried into the next one
+    unsigned long lastDetentTime = 0;
     EncoderEvent lastDirection = ENCODER_CLOCKWISE;
-    int consistentDirectionCount = 0;
+    uint16_t stepRemainder = 0;
     
-    void handleButtonState(int reading);
-    void handleEncoderEvent(EncoderEvent event);
+    void emitDetents(EncoderEvent event, uint8_t detents);
+    
+    // Volume step gain (8.8 fixed point) for a detent rate
+    static uint16_t accelerationGain(uint32_t detentsPerSecond);
+    
+    // PCNT interrupt - fires on every count change and wakes the input task
+    static void onPulse(void* arg);
 };
 
 // Global accessor function
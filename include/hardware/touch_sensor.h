@@ -11,61 +11,164 @@ enum TouchEvent {
     TOUCH_RELEASED
 };
 
-// Callback function type
-typedef void (*TouchCallback)(TouchEvent event);
+// What a pad does when touched
+enum TouchAction : uint8_t {
+    TOUCH_ACTION_MUTE,          // Toggle mute, or push-to-talk when that mode is on
+    TOUCH_ACTION_PUSH_TO_TALK   // Always push-to-talk: unmuted only while held
+};
+
+// Detector tuning, shared by all pads; defaults come from config.h
+struct TouchDetectorConfig {
+    uint8_t filterShift = TOUCH_FILTER_SHIFT;
+    uint8_t baselineShift = TOUCH_BASELINE_SHIFT;
+    uint8_t pressSamples = TOUCH_PRESS_SAMPLES;
+    uint8_t releaseSamples = TOUCH_RELEASE_SAMPLES;
+    uint8_t releasePercent = TOUCH_RELEASE_PERCENT;
+    uint8_t thresholdPercent = TOUCH_THRESHOLD_PERCENT;
+    uint16_t sampleInterval = TOUCH_SAMPLE_INTERVAL;  // milliseconds while a touch is in progress
+};
+
+// Callback function type; pad is the index returned by addPad()
+typedef void (*TouchCallback)(TouchEvent event, uint8_t pad);
 
+/*
+ * Up to TOUCH_MAX_PADS capacitive pads, sampled together in one sweep.
+ *
+ * Filter and baseline state is kept as one array per field (struct of
+ * arrays), so a sweep is a few short branch-free loops over all pads that
+ * the compiler can vectorize, followed by the per-pad decisions. Each pad
+ * is calibrated on its own and bound to a TouchAction.
+ */
 class TouchSensor {
 public:
     // Constructor
-    TouchSensor(uint8_t touchPin, uint16_t debounceTime = DEBOUNCE_TIME);
-    
+    TouchSensor();
+
+    // Register a pad before begin(); returns its index, or -1 when full
+    int addPad(uint8_t pin, TouchAction action);
+    uint8_t getPadCount() const { return padCount; }
+    uint8_t getPadPin(uint8_t pad) const { return pins[pad]; }
+    TouchAction getPadAction(uint8_t pad) const { return actions[pad]; }
+
     // Initialization
     void begin();
-    
-    // Calibration methods
-    void startCalibration();
+
+    // Replace the detector tuning; call before begin()
+    void setDetectorConfig(const TouchDetectorConfig& config) { detector = config; }
+    const TouchDetectorConfig& getDetectorConfig() const { return detector; }
+
+    // Calibration methods - one pad at a time
+    void startCalibration(uint8_t pad = 0);
     bool isCalibrating() const { return calibrationInProgress; }
-    bool isCalibrated() const { return calibrationComplete; }
-    
+    bool isCalibrated(uint8_t pad = 0) const { return calibrated[pad]; }
+
     // Get calibration values
-    int getUntouchedValue() const { return untouchedValue; }
-    int getTouchedValue() const { return touchedValue; }
-    
+    int getUntouchedValue(uint8_t pad = 0) const { return untouchedValue[pad]; }
+    int getTouchedValue(uint8_t pad = 0) const { return touchedValue[pad]; }
+
+    // Measured noise (standard deviation) of each calibration stage
+    int getUntouchedNoise(uint8_t pad = 0) const { return untouchedNoise[pad]; }
+    int getTouchedNoise(uint8_t pad = 0) const { return touchedNoise[pad]; }
+
     // Register callback for touch events
     void setCallback(TouchCallback callback);
-    
+
     // Update method to be called in the main loop
     void update();
-    
+
     // Get current touch state
-    bool isTouched() const { return touchState == 1; }
-    
+    bool isTouched(uint8_t pad = 0) const { return touchState[pad] != 0; }
+    bool isAnyTouched() const;
+
     // Get raw touch value
-    int getRawValue() const;
-    
+    int getRawValue(uint8_t pad = 0) const;
+
     // Get threshold value
-    int getThreshold() const { return touchThreshold; }
+    int getThreshold(uint8_t pad = 0) const { return touchThreshold[pad]; }
+
+    // Filter state, in raw touch units
+    int getFilteredValue(uint8_t pad = 0) const { return filteredValue[pad] >> TOUCH_FIXED_SHIFT; }
+    int getBaseline(uint8_t pad = 0) const { return baselineValue[pad] >> TOUCH_FIXED_SHIFT; }
+
+    // micros() of the interrupt behind the last touch/release event, 0 if it was found by idle sampling
+    uint32_t getEventTime() const { return eventTime; }
+
+    // Milliseconds until update() wants to take its next sample (UINT32_MAX if never)
+    uint32_t getTimeUntilNextSample() const;
 
 private:
-    uint8_t touchPin;
-    uint16_t debounceTime;
-    int touchThreshold;
-    int touchState;
-    int lastReading;
-    unsigned long lastDebounceTime;
+    static const uint8_t TOUCH_FIXED_SHIFT = 4;  // fractional bits of the filter state
+
+    TouchDetectorConfig detector;
+
+    // Pad configuration and calibration
+    uint8_t padCount;
+    uint8_t pins[TOUCH_MAX_PADS];
+    TouchAction actions[TOUCH_MAX_PADS];
+    bool calibrated[TOUCH_MAX_PADS];
+    int32_t untouchedValue[TOUCH_MAX_PADS];
+    int32_t touchedValue[TOUCH_MAX_PADS];
+    int32_t untouchedNoise[TOUCH_MAX_PADS];
+    int32_t touchedNoise[TOUCH_MAX_PADS];
+    int32_t touchThreshold[TOUCH_MAX_PADS];
+
+    // Detection pipeline, one entry per pad: low-pass -> baseline subtraction -> hysteresis
+    int32_t samples[TOUCH_MAX_PADS];        // last sweep, Q4
+    int32_t filteredValue[TOUCH_MAX_PADS];  // IIR low-passed reading, Q4
+    int32_t baselineValue[TOUCH_MAX_PADS];  // slow untouched level, Q4; frozen while touched
+    int32_t direction[TOUCH_MAX_PADS];      // +1 if touching raises the reading, -1 if it lowers it
+    int32_t pressDelta[TOUCH_MAX_PADS];     // distance above baseline that counts as touched
+    int32_t releaseDelta[TOUCH_MAX_PADS];   // distance below which a touch is released
+    int32_t delta[TOUCH_MAX_PADS];          // last sweep's distance from baseline, toward "touched"
+    uint8_t sampleStreak[TOUCH_MAX_PADS];   // consecutive samples past the pending threshold
+    uint8_t touchState[TOUCH_MAX_PADS];
+
+    // Calibration in progress
     bool calibrationInProgress;
-    bool calibrationComplete;
-    unsigned long calibrationStartTime;
+    uint8_t calibrationPad;
     int calibrationStage;  // 0=untouched, 1=touched
-    int untouchedValue;
-    int touchedValue;
-    
+    unsigned long calibrationStartTime;
+    unsigned long calibrationSampleTime;
+
+    // Running statistics of the current calibration stage (Welford)
+    uint16_t sampleCount;
+    float sampleMean;
+    float sampleM2;
+
+    unsigned long lastSampleTime;
+    unsigned long lastBaselineTime;
+
+    // Threshold interrupt context, one per pad
+    struct PadInterrupt {
+        TouchSensor* sensor;
+        uint8_t pad;
+    };
+    PadInterrupt interruptContext[TOUCH_MAX_PADS];
+    volatile bool sampleRequested;    // set by the threshold interrupt
+    volatile uint32_t interruptTime;  // micros() of the last threshold interrupt not yet resolved
+    uint32_t eventTime;
+
     TouchCallback callback;
     Preferences preferences;
-    
-    void loadSettings();
-    void saveSettings();
-    void completeCalibration(int baselineValue);
+
+    void loadSettings(uint8_t pad);
+    void saveSettings(uint8_t pad);
+    void openSettings(uint8_t pad, bool readOnly);
+    void addCalibrationSample(int value);
+    void completeCalibration(int meanValue, int noise);
+    void startNextCalibration();
+    int computeThreshold(uint8_t pad) const;
+    void resetFilter(uint8_t pad);
+    void sweep(unsigned long now);
+    bool decide(uint8_t pad);  // true if the pad changed state
+    bool isSettling() const;
+    uint32_t sampleInterval() const;
+    int readSample(uint8_t pad) const;
+
+    // Threshold interrupt that wakes the input task on touch/release
+    void attachTouchInterrupt(uint8_t pad);
+    void detachTouchInterrupt(uint8_t pad);
+    static void onThreshold(void* arg);
 };
 
 // Global accessor function
@@ -2,7 +2,7 @@
 #define HIDMAP_H
 
 #include <Arduino.h>
-#include <tusb.h>
+#include "HIDTypes.h"
 
 // --- HID Report ID ---
 #define HID_REPORTID_PHONE_INPUT 0x01
@@ -10,6 +10,10 @@
 #define HID_REPORTID_KEYBOARD_INPUT 0x03
 #define HID_REPORTID_CONSUMER_INPUT 0x04
 
+// --- Headset Input Report Bits ---
+#define HEADSET_MUTE            0x01  // Bit 0, a state
+#define HEADSET_DROP            0x02  // Bit 1, pulsed to hang up
+
 // --- Consumer Control Usage Codes ---
 #define CONSUMER_VOLUME_UP      0x01  // Bit 0
 #define CONSUMER_VOLUME_DOWN    0x02  // Bit 1
@@ -2,6 +2,9 @@
 #define LOGGER_H
 
 #include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+#include "hal/task.h"
 
 // Log levels
 #define LOG_LEVEL_NONE    0
@@ -23,39 +26,161 @@
 #define LOG_PREFIX_DEBUG   "[DEBUG] "
 #define LOG_PREFIX_VERBOSE "[VERB]  "
 
+// Deferred log ring
+#define LOG_RING_SIZE 64   // records (power of two)
+#define LOG_MAX_ARGS 8     // arguments per record
+#define LOG_LINE_MAX 192   // bytes per formatted line
+
+// One captured argument, widened so the drain can format any printf conversion
+union LogArg {
+    uint64_t u;
+    double d;
+    const void* p;
+};
+
+// Format string (its address doubles as the message ID) and raw arguments
+struct LogRecord {
+    std::atomic<uint32_t> sequence{0};  // slot state, see Logger::commit(); zero is free
+    const char* format = nullptr;
+    uint8_t level = 0;
+    uint8_t argCount = 0;
+    LogArg args[LOG_MAX_ARGS] = {};
+};
+
+/*
+ * Deferred logger. A LOG_...() call checks the level before evaluating its
+ * arguments, then copies the format pointer and the raw argument values
+ * into a lock-free ring; a low-priority task formats the records and writes
+ * them to Serial, so the logging task never waits on the port.
+ *
+ * Any task may log, but not an interrupt handler. Formatting happens later,
+ * so a %s argument must outlive the call: a literal or a static name, never
+ * a stack buffer. A full ring drops the record and counts it.
+ *
+ * When no drain task can be started (native build) the logging call writes
+ * the ring out itself.
+ */
+class Logger {
+public:
+    constexpr Logger()
+        : ring(),
+          head(0),
+          tail(0),
+          runtimeLevel(LOG_LEVEL),
+          written(0),
+          dropped(0),
+          droppedReported(0),
+          drainTask(nullptr),
+          drainSleeping(false),
+          draining(false),
+          taskless(false) {}
+
+    // Start the drain task; records logged before this wait in the ring
+    void begin();
+
+    // Runtime threshold below the compile-time LOG_LEVEL
+    bool isEnabled(uint8_t level) const { return level <= runtimeLevel.load(std::memory_order_relaxed); }
+    void setLevel(uint8_t level) { runtimeLevel.store(level, std::memory_order_relaxed); }
+    uint8_t getLevel() const { return runtimeLevel.load(std::memory_order_relaxed); }
+
+    template <typename... Args>
+    void write(uint8_t level, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many arguments for one log record");
+        const LogArg packed[sizeof...(Args) + 1] = { pack(args)... };
+        commit(level, format, packed, sizeof...(Args));
+    }
+
+    uint32_t getWritten() const { return written.load(std::memory_order_relaxed); }
+    uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    LogRecord ring[LOG_RING_SIZE];
+    std::atomic<uint32_t> head;  // next slot to reserve, shared by every producer
+    uint32_t tail;               // next slot to drain, drain side only
+    std::atomic<uint8_t> runtimeLevel;
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> dropped;
+    uint32_t droppedReported;
+
+    HalTaskHandle drainTask;
+    std::atomic<bool> drainSleeping;  // set by the drain task before it blocks
+    std::atomic<bool> draining;       // taskless only: a logging call is writing out
+    bool taskless;
+
+    void commit(uint8_t level, const char* format, const LogArg* args, uint8_t argCount);
+    bool drainOne();
+    void drain();
+    size_t format(const LogRecord& record, char* line, size_t size) const;
+
+    static void drainTaskMain(void* arg);
+    static uint32_t lap(uint32_t pos) { return pos & ~(uint32_t)(LOG_RING_SIZE - 1); }
+
+    // Argument capture by type; the conversion in the format picks the width back out
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, LogArg>::type pack(T value) {
+        LogArg arg;
+        arg.u = (uint64_t)value;
+        return arg;
+    }
+    static LogArg pack(double value) {
+        LogArg arg;
+        arg.d = value;
+        return arg;
+    }
+    static LogArg pack(const void* value) {
+        LogArg arg;
+        arg.p = value;
+        return arg;
+    }
+};
+
+// Global accessor function
+Logger& getLogger();
+
+// Never called: keeps printf format checking on the deferred macros
+static inline void logFormatCheck(const char* format, ...) __attribute__((format(printf, 1, 2)));
+static inline void logFormatCheck(const char* format, ...) {
+    (void)format;
+}
+
+#define LOG_AT(level, format, ...) do { \
+    if (false) logFormatCheck(format, ##__VA_ARGS__); \
+    if (getLogger().isEnabled(level)) getLogger().write(level, format, ##__VA_ARGS__); \
+  } while (0)
+
 // Logging macros
 #if LOG_LEVEL >= LOG_LEVEL_ERROR
-  #define LOG_ERROR(format, ...) Serial.printf(LOG_PREFIX_ERROR format "\n", ##__VA_ARGS__)
+  #define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, LOG_PREFIX_ERROR format, ##__VA_ARGS__)
 #else
   #define LOG_ERROR(format, ...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_WARN
-  #define LOG_WARN(format, ...) Serial.printf(LOG_PREFIX_WARN format "\n", ##__VA_ARGS__)
+  #define LOG_WARN(format, ...) LOG_AT(LOG_LEVEL_WARN, LOG_PREFIX_WARN format, ##__VA_ARGS__)
 #else
   #define LOG_WARN(format, ...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_INFO
-  #define LOG_INFO(format, ...) Serial.printf(LOG_PREFIX_INFO format "\n", ##__VA_ARGS__)
+  #define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, LOG_PREFIX_INFO format, ##__VA_ARGS__)
 #else
   #define LOG_INFO(format, ...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_DEBUG
-  #define LOG_DEBUG(format, ...) Serial.printf(LOG_PREFIX_DEBUG format "\n", ##__VA_ARGS__)
+  #define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, LOG_PREFIX_DEBUG format, ##__VA_ARGS__)
 #else
   #define LOG_DEBUG(format, ...)
 #endif
 
 #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
-  #define LOG_VERBOSE(format, ...) Serial.printf(LOG_PREFIX_VERBOSE format "\n", ##__VA_ARGS__)
+  #define LOG_VERBOSE(format, ...) LOG_AT(LOG_LEVEL_VERBOSE, LOG_PREFIX_VERBOSE format, ##__VA_ARGS__)
 #else
   #define LOG_VERBOSE(format, ...)
 #endif
 
 // Additional convenience macros
-#define LOG_INIT() do { Serial.begin(115200); delay(100); } while(0)
+#define LOG_INIT() do { Serial.begin(115200); delay(100); getLogger().begin(); } while(0)
 
 // Function entry/exit logging (verbose level)
 #if LOG_LEVEL >= LOG_LEVEL_VERBOSE
@@ -0,0 +1,56 @@
+#ifndef TOUCH_TRACE_H
+#define TOUCH_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "config.h"
+
+/*
+ * Touch trace captured from the device's binary telemetry stream (see
+ * communication/touch_telemetry.h), decoded into flat per-sample arrays.
+ *
+ * Frames that fail their checksum, and delta frames before the first
+ * keyframe or after a sequence gap, are skipped; the time base is unwrapped
+ * across micros() overflow.
+ */
+class TouchTrace {
+public:
+    TouchTrace();
+
+    // Decode a raw capture of the serial port; false if nothing could be read
+    bool load(const char* path);
+
+    size_t getSampleCount() const { return times.size(); }
+    uint8_t getPadCount() const { return padCount; }
+    bool isHardwareFiltered() const { return hardwareFiltered; }  // filtered/baseline are peripheral registers
+
+    uint64_t getTime(size_t sample) const { return times[sample]; }  // micros
+    bool wasTouched(size_t sample, uint8_t pad) const { return (touched[sample] >> pad) & 1; }  // device's detector at capture
+    int32_t getRaw(size_t sample, uint8_t pad) const { return values[index(sample, pad)]; }
+    int32_t getFiltered(size_t sample, uint8_t pad) const { return values[index(sample, pad) + 1]; }
+    int32_t getBaseline(size_t sample, uint8_t pad) const { return values[index(sample, pad) + 2]; }
+
+    uint32_t getFrameCount() const { return frameCount; }
+    uint32_t getSkippedFrames() const { return skippedFrames; }
+
+private:
+    uint8_t padCount;
+    bool hardwareFiltered;
+    std::vector<uint64_t> times;
+    std::vector<uint16_t> touched;
+    std::vector<int32_t> values;  // raw, filtered, baseline per pad per sample
+    uint32_t frameCount;
+    uint32_t skippedFrames;
+
+    // Decoder state carried from frame to frame
+    int32_t previous[TOUCH_MAX_PADS][3];
+    bool synced;
+    uint16_t lastSequence;
+    uint32_t lastMicros;
+
+    size_t index(size_t sample, uint8_t pad) const { return (sample * padCount + pad) * 3; }
+    bool decodeFrame(const uint8_t* frame, uint16_t length, uint8_t flags);
+};
+
+#endif // TOUCH_TRACE_H
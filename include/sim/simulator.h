@@ -0,0 +1,59 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "core/device_controller.h"
+
+/*
+ * Discrete-event driver for the native build.
+ *
+ * Scripted actions (pin edges, touch readings, host writes) are kept in a
+ * time-ordered queue. run() jumps the virtual clock straight to whichever
+ * comes first: the next action, the next transmit confirm of the simulated
+ * HID transport, or the deadline the controller reports through
+ * nextWakeTimeout(). Idle stretches cost nothing, so hours of
+ * interaction replay in milliseconds, and equal scripts give equal results.
+ */
+class Simulator {
+public:
+    typedef std::function<void()> Action;
+
+    Simulator(DeviceController& controller);
+
+    // Schedule an action at an absolute virtual time, or relative to now
+    void at(uint64_t timeMs, Action action);
+    void atMicros(uint64_t timeUs, Action action);
+    void after(uint32_t delayMs, Action action);
+
+    // Advance virtual time by durationMs, running actions and controller passes as they fall due
+    void run(uint32_t durationMs);
+
+    uint64_t nowMs() const;
+    uint64_t getSteps() const { return steps; }
+    size_t getPending() const { return actions.size(); }
+
+private:
+    struct ScheduledAction {
+        uint64_t time;      // virtual micros
+        uint64_t sequence;  // keeps actions at the same time in scheduling order
+        Action action;
+    };
+
+    struct Later {
+        bool operator()(const ScheduledAction& a, const ScheduledAction& b) const {
+            return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+        }
+    };
+
+    DeviceController& controller;
+    std::priority_queue<ScheduledAction, std::vector<ScheduledAction>, Later> actions;
+    uint64_t nextSequence;
+    uint64_t steps;
+
+    void runDueActions();
+};
+
+#endif // SIMULATOR_H
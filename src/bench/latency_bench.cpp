@@ -0,0 +1,398 @@
+/*
+ * End-to-end input latency benchmark for the native build.
+ *
+ * Drives synthetic touch, button, encoder and host input through the full
+ * DeviceController -> KeyboardHandler / updateCallState -> BluetoothHandler
+ * path against the simulated transports, and times each input edge to the
+ * first report it causes. Latency is measured in simulated time, so it
+ * covers debounce, gesture windows and scheduling but not the ESP32's own
+ * CPU time; the host CPU time from stimulus to report is shown alongside.
+ * The air columns time each HID report to the connection event that
+ * carries it, under whichever link parameters the case ends up with; the
+ * link column shows the interval and peripheral latency the device last
+ * had reported for it. Inputs that work both in and out of a call run on
+ * the fast and on the relaxed link, each with its own budget.
+ *
+ * Usage: program [trials]
+ * Exits with status 1 if any input never reports, or if its p99 misses
+ * either budget: edge to report sent, or edge to the connection event that
+ * carries the report.
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <vector>
+#include "config.h"
+#include "core/device_controller.h"
+#include "core/input_queue.h"
+#include "communication/bluetooth_handler.h"
+#include "hardware/touch_sensor.h"
+#include "hal/native/sim_hardware.h"
+#include "sim/simulator.h"
+
+#define BENCH_TRIALS      200
+#define BENCH_SETTLE_MS   2000   // idle gap between trials, longer than any gesture window
+#define BENCH_TOUCH_PIN   4
+#define BENCH_ENCODER     0
+#define BENCH_ENCODER_PIN 7      // the encoder's push switch, as getRotaryEncoder() wires it
+#define BENCH_UNTOUCHED   20000
+#define BENCH_TOUCHED     40000
+#define BENCH_CLICK_HOLD  80     // milliseconds
+#define BENCH_SWEEPS      20000  // touch sweeps timed per pad count
+#define BENCH_SWEEP_GAP   10     // milliseconds for a touch to get through the peripheral's filter
+
+// One connection interval of each link a case can run on, in micros: the
+// most an on-air budget allows on top of the in-device one
+#define BENCH_FAST_LINK   (BLE_FAST_INTERVAL_MAX * 1250UL)
+#define BENCH_HOST_LINK   (SIM_HOST_INTERVAL * 1250UL)
+#define BENCH_IDLE_LINK   (BLE_IDLE_INTERVAL_MAX * 1250UL)
+
+// Button budgets: the gesture windows plus 20 ms of slack
+#define BENCH_CLICK_BUDGET ((DEBOUNCE_TIME + DOUBLE_CLICK_TIME + BENCH_CLICK_HOLD + 20) * 1000UL)
+#define BENCH_LONG_BUDGET  ((DEBOUNCE_TIME + LONG_PRESS_TIME + 20) * 1000UL)
+#define BENCH_ENCODER_CLICK_BUDGET ((ENCODER_DEBOUNCE_TIME + DOUBLE_CLICK_TIME + BENCH_CLICK_HOLD + 20) * 1000UL)
+
+// What a benchmark case waits for
+enum BenchOutput : uint8_t {
+    BENCH_OUTPUT_HEADSET,
+    BENCH_OUTPUT_KEYBOARD,
+    BENCH_OUTPUT_CONSUMER,
+    BENCH_OUTPUT_LED
+};
+
+struct BenchCase {
+    const char* name;
+    BenchOutput output;
+    uint32_t budgetUs;                   // p99 limit on simulated latency to the report being sent
+    uint32_t airBudgetUs;                // p99 limit to the connection event carrying it
+    void (*setup)();                     // put the controller in the needed mode
+    uint64_t (*stimulus)(uint64_t at);   // schedule input from 'at' (sim micros), return the timed edge
+};
+
+DeviceController controller;
+Simulator simulator(controller);
+
+static uint64_t stimulusHostTime;
+static uint32_t randomState = 0x2545F491;
+
+// Deterministic jitter so edges land at every phase of the polling grid
+static uint32_t nextRandom(uint32_t range) {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState % range;
+}
+
+static void edge(uint64_t at, Simulator::Action action) {
+    simulator.atMicros(at, [action] {
+        stimulusHostTime = sim::hostNanos();
+        action();
+    });
+}
+
+// --- Setups ---
+
+static void setupToggleMode() {
+    controller.setPushToTalkMode(false);
+    sim::getHidTransport().setAcceptsLinkUpdates(true);
+    sim::getHidTransport().writeHostLeds(0, 0x02);  // Call active, unmuted
+}
+
+static void setupPushToTalk() {
+    controller.setPushToTalkMode(true);
+    sim::getHidTransport().setAcceptsLinkUpdates(true);
+    sim::getHidTransport().writeHostLeds(0, 0x03);  // Call active, muted
+}
+
+static void setupHostDefaultLink() {
+    // Same call, but the host keeps its own interval
+    setupToggleMode();
+    sim::getHidTransport().setAcceptsLinkUpdates(false);
+}
+
+static void setupNoCall() {
+    controller.setPushToTalkMode(false);
+    sim::getHidTransport().setAcceptsLinkUpdates(true);
+    sim::getHidTransport().writeHostLeds(0, 0x00);  // No call: relaxed link
+}
+
+// --- Stimuli ---
+
+static uint64_t touchPress(uint64_t at) {
+    edge(at, [] { sim::setTouch(BENCH_TOUCH_PIN, BENCH_TOUCHED); });
+    simulator.atMicros(at + (100 + nextRandom(200)) * 1000, [] { sim::setTouch(BENCH_TOUCH_PIN, BENCH_UNTOUCHED); });
+    return at;
+}
+
+static uint64_t touchRelease(uint64_t at) {
+    uint64_t release = at + (200 + nextRandom(200)) * 1000 + nextRandom(1000);
+    simulator.atMicros(at, [] { sim::setTouch(BENCH_TOUCH_PIN, BENCH_TOUCHED); });
+    edge(release, [] { sim::setTouch(BENCH_TOUCH_PIN, BENCH_UNTOUCHED); });
+    return release;
+}
+
+static void contactBounce(uint8_t pin, uint64_t at, bool high, uint8_t transitions, uint32_t gapUs) {
+    // Contact chatter after the edge, gaps of 0.5-1.5x gapUs, then the settled level
+    uint64_t t = at;
+    for (uint8_t i = 0; i < transitions; i++) {
+        t += gapUs / 2 + nextRandom(gapUs);
+        bool level = (i % 2 == 0) ? !high : high;
+        simulator.atMicros(t, [pin, level] { sim::setPin(pin, level); });
+    }
+}
+
+static void buttonBounce(uint64_t at, bool high) {
+    // Tact switch: about a millisecond of chatter
+    contactBounce(LEFT_BUTTON_PIN, at, high, 4, 200);
+}
+
+static uint64_t buttonClick(uint64_t at) {
+    uint64_t release = at + BENCH_CLICK_HOLD * 1000;
+    edge(at, [] { sim::setPin(LEFT_BUTTON_PIN, false); });
+    buttonBounce(at, false);
+    simulator.atMicros(release, [] { sim::setPin(LEFT_BUTTON_PIN, true); });
+    buttonBounce(release, true);
+    return at;
+}
+
+static uint64_t buttonLongPress(uint64_t at) {
+    uint64_t release = at + (LONG_PRESS_TIME + 200) * 1000;
+    edge(at, [] { sim::setPin(LEFT_BUTTON_PIN, false); });
+    buttonBounce(at, false);
+    simulator.atMicros(release, [] { sim::setPin(LEFT_BUTTON_PIN, true); });
+    buttonBounce(release, true);
+    return at;
+}
+
+static uint64_t encoderClick(uint64_t at) {
+    // The encoder's dome switch chatters for up to about 5 ms on each edge
+    uint64_t release = at + BENCH_CLICK_HOLD * 1000;
+    edge(at, [] { sim::setPin(BENCH_ENCODER_PIN, false); });
+    contactBounce(BENCH_ENCODER_PIN, at, false, 8, 600);
+    simulator.atMicros(release, [] { sim::setPin(BENCH_ENCODER_PIN, true); });
+    contactBounce(BENCH_ENCODER_PIN, release, true, 8, 600);
+    return at;
+}
+
+static uint64_t encoderTurn(uint64_t at) {
+    // One brisk detent: four counts 2-4 ms apart, alternating direction per trial
+    static int32_t direction = 1;
+    direction = -direction;
+    int32_t step = direction;
+    uint64_t t = at;
+    edge(t, [step] { sim::rotateEncoder(BENCH_ENCODER, step); });
+    for (uint8_t i = 1; i < 4; i++) {
+        t += (2 + nextRandom(3)) * 1000;
+        simulator.atMicros(t, [step] { sim::rotateEncoder(BENCH_ENCODER, step); });
+    }
+    return at;
+}
+
+static uint64_t hostMuteToggle(uint64_t at) {
+    static uint8_t value = 0x02;
+    value ^= 0x01;
+    uint8_t report = value;
+    edge(at, [report] { sim::getHidTransport().writeHostLeds(0, report); });
+    return at;
+}
+
+static const BenchCase cases[] = {
+    { "Touch press (toggle)",   BENCH_OUTPUT_HEADSET,  5000,  5000 + BENCH_FAST_LINK, setupToggleMode, touchPress },
+    { "Touch press (host link)", BENCH_OUTPUT_HEADSET, 5000,  5000 + BENCH_HOST_LINK, setupHostDefaultLink, touchPress },
+    { "Touch release (PTT)",    BENCH_OUTPUT_HEADSET,  10000, 10000 + BENCH_FAST_LINK, setupPushToTalk, touchRelease },
+    { "Button click",           BENCH_OUTPUT_KEYBOARD, BENCH_CLICK_BUDGET, BENCH_CLICK_BUDGET + BENCH_FAST_LINK, setupToggleMode, buttonClick },
+    { "Button long press",      BENCH_OUTPUT_HEADSET,  BENCH_LONG_BUDGET, BENCH_LONG_BUDGET + BENCH_FAST_LINK, setupToggleMode, buttonLongPress },
+    { "Encoder detent (fast)",  BENCH_OUTPUT_CONSUMER, 20000, 20000 + BENCH_FAST_LINK, setupToggleMode, encoderTurn },
+    { "Encoder detent (idle)",  BENCH_OUTPUT_CONSUMER, 20000, 20000 + BENCH_IDLE_LINK, setupNoCall, encoderTurn },
+    { "Encoder click -> LED",   BENCH_OUTPUT_LED,      BENCH_ENCODER_CLICK_BUDGET, BENCH_ENCODER_CLICK_BUDGET, setupNoCall, encoderClick },
+    { "Host state -> LED",      BENCH_OUTPUT_LED,      5000,  5000, setupToggleMode, hostMuteToggle },
+};
+
+// --- Measurement ---
+
+struct Sample {
+    uint32_t latencyUs;
+    uint32_t airUs;      // to the connection event; same as latencyUs for LED frames
+    uint32_t hostNanos;
+};
+
+// First output of the right kind at or after the edge
+static bool findOutput(BenchOutput output, uint64_t edgeTime, uint32_t framesBefore, Sample& sample) {
+    if (output == BENCH_OUTPUT_LED) {
+        sim::SimLedTransport& led = sim::getLedTransport();
+        uint32_t count = led.getFrameCount();
+        uint32_t first = count - framesBefore > sim::SimLedTransport::LOG_SIZE ? count - sim::SimLedTransport::LOG_SIZE : framesBefore;
+        for (uint32_t i = first; i < count; i++) {
+            if (led.getFrameTime(i) >= edgeTime) {
+                sample.latencyUs = led.getFrameTime(i) - edgeTime;
+                sample.airUs = sample.latencyUs;
+                sample.hostNanos = led.getFrameHostTime(i) - stimulusHostTime;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const HidChannel channels[] = { HID_CHANNEL_HEADSET, HID_CHANNEL_KEYBOARD, HID_CHANNEL_CONSUMER };
+    sim::SimHidTransport& hid = sim::getHidTransport();
+    for (uint32_t i = 0; i < hid.getReportCount(); i++) {
+        const sim::SentReport& report = hid.getReport(i);
+        if (report.channel == channels[output] && report.time >= edgeTime) {
+            sample.latencyUs = report.time - edgeTime;
+            sample.airUs = report.airTime - edgeTime;
+            sample.hostNanos = report.hostTime - stimulusHostTime;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The bench host as the device sees it, with the parameters the stack last reported
+static const HostConnection* benchHost() {
+    BluetoothHandler& ble = getBLEHandler();
+    for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        const HostConnection& host = ble.getHost(i);
+        if (host.connected && host.connId == 0) return &host;
+    }
+    return nullptr;
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, uint8_t percent) {
+    if (sorted.empty()) return 0;
+    size_t rank = (sorted.size() * percent + 99) / 100;
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static bool runCase(const BenchCase& benchCase, uint32_t trials) {
+    std::vector<uint32_t> latencies;
+    std::vector<uint32_t> airTimes;
+    std::vector<uint32_t> hostTimes;
+    uint32_t missed = 0;
+
+    benchCase.setup();
+    simulator.run(BENCH_SETTLE_MS);
+
+    for (uint32_t trial = 0; trial < trials; trial++) {
+        sim::getHidTransport().clear();
+        uint32_t framesBefore = sim::getLedTransport().getFrameCount();
+
+        uint64_t start = sim::now() + nextRandom(20000);
+        uint64_t edgeTime = benchCase.stimulus(start);
+        simulator.run(BENCH_SETTLE_MS);
+
+        Sample sample;
+        if (findOutput(benchCase.output, edgeTime, framesBefore, sample)) {
+            latencies.push_back(sample.latencyUs);
+            airTimes.push_back(sample.airUs);
+            hostTimes.push_back(sample.hostNanos);
+        } else {
+            missed++;
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(airTimes.begin(), airTimes.end());
+    std::sort(hostTimes.begin(), hostTimes.end());
+
+    uint32_t p99 = percentile(latencies, 99);
+    uint32_t airP99 = percentile(airTimes, 99);
+    bool pass = missed == 0 && p99 <= benchCase.budgetUs && airP99 <= benchCase.airBudgetUs;
+
+    char link[16] = "-";
+    const HostConnection* host = benchHost();
+    if (host) {
+        snprintf(link, sizeof(link), "%.1f/%u", host->interval * 1.25, host->latency);
+    }
+
+    Serial.printf("%-24s %5u %8u %8u %8u %8u %8u %9s %8u %8u %8u %9.1f %5u  %s\n",
+                  benchCase.name, (unsigned)latencies.size(),
+                  latencies.empty() ? 0 : latencies.front(),
+                  percentile(latencies, 50), p99,
+                  latencies.empty() ? 0 : latencies.back(),
+                  benchCase.budgetUs,
+                  link,
+                  percentile(airTimes, 50), airP99,
+                  benchCase.airBudgetUs,
+                  percentile(hostTimes, 50) / 1000.0,
+                  missed,
+                  pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+// Saved calibration for a pad, in the namespace TouchSensor loads it from
+static void seedTouchSettings(uint8_t pad) {
+    char name[16];
+    if (pad == 0) {
+        snprintf(name, sizeof(name), "touch-settings");
+    } else {
+        snprintf(name, sizeof(name), "touch-pad%u", pad);
+    }
+    Preferences preferences;
+    preferences.begin(name, false);
+    preferences.putUInt("untouched", BENCH_UNTOUCHED);
+    preferences.putUInt("touched", BENCH_TOUCHED);
+    preferences.putUInt("touchThresh", (BENCH_UNTOUCHED + BENCH_TOUCHED) / 2);
+    preferences.end();
+}
+
+// --- Touch sweep cost ---
+
+// Mean host time of one TouchSensor sweep over padCount calibrated pads on GPIO 1..n
+static double sweepNanos(TouchSensor& sensor, uint8_t padCount) {
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        seedTouchSettings(pad);
+        sim::setTouch(pad + 1, BENCH_UNTOUCHED);
+        sensor.addPad(pad + 1, TOUCH_ACTION_MUTE);
+    }
+    sensor.begin();
+
+    uint64_t total = 0;
+    InputEvent event;
+    for (uint32_t i = 0; i < BENCH_SWEEPS; i++) {
+        // A threshold crossing on the first pad requests a sweep of all of them
+        sim::setTouch(1, (i & 1) ? BENCH_UNTOUCHED : BENCH_TOUCHED);
+        sim::advanceMillis(BENCH_SWEEP_GAP);
+
+        uint64_t start = sim::hostNanos();
+        sensor.update();
+        total += sim::hostNanos() - start;
+
+        while (getInputQueue().wait(event, 0)) {}
+    }
+    return (double)total / BENCH_SWEEPS;
+}
+
+int main(int argc, char** argv) {
+    uint32_t trials = (argc > 1) ? atoi(argv[1]) : BENCH_TRIALS;
+
+    // Start from a calibrated touch pad instead of running the calibration
+    seedTouchSettings(0);
+    sim::setTouch(BENCH_TOUCH_PIN, BENCH_UNTOUCHED);
+
+    controller.begin();
+    sim::getHidTransport().connectHost(0);
+
+    Serial.printf("\n--- Input Latency Benchmark (%u trials, simulated us) ---\n", trials);
+    Serial.printf("%-24s %5s %8s %8s %8s %8s %8s %9s %8s %8s %8s %9s %5s  %s\n",
+                  "Input", "n", "min", "p50", "p99", "max", "budget", "link ms/l", "air p50", "air p99", "air bdgt", "cpu p50", "miss", "result");
+
+    bool pass = true;
+    for (const BenchCase& benchCase : cases) {
+        pass &= runCase(benchCase, trials);
+    }
+
+    // CPU load proxy: how often the input task wakes with nobody touching anything
+    uint64_t stepsBefore = simulator.getSteps();
+    simulator.run(60000);
+    Serial.printf("Idle wakes per minute: %llu\n", (unsigned long long)(simulator.getSteps() - stepsBefore));
+
+    // Per-sweep filter cost as the pad count grows; replaces the controller's pad interrupts, so run last
+    static TouchSensor onePad;
+    static TouchSensor allPads;
+    double oneNanos = sweepNanos(onePad, 1);
+    double allNanos = sweepNanos(allPads, TOUCH_MAX_PADS);
+    Serial.printf("Touch sweep (host ns): 1 pad %.0f, %d pads %.0f\n", oneNanos, TOUCH_MAX_PADS, allNanos);
+
+    Serial.printf("%s\n", pass ? "All inputs within budget" : "Latency budget exceeded");
+    return pass ? 0 : 1;
+}
@@ -1,10 +1,8 @@
 #include "communication/bluetooth_handler.h"
-#include "communication/keyboard_handler.h"
-#include "hardware/led_strip.h"
+#include "core/input_queue.h"
+#include "core/event_trace.h"
 #include "config.h"
-
-// Forward declaration for the task function
-void bluetoothTask(void* pvParameters);
+#include "hidmap.h"
 
 // Static accessor function
 BluetoothHandler& getBLEHandler() {
@@ -12,71 +10,333 @@ BluetoothHandler& getBLEHandler() {
 }
 
 BluetoothHandler::BluetoothHandler() 
-    : connectedClients(0), hid(nullptr), headsetInput(nullptr), headsetOutput(nullptr), keyboardInput(nullptr), consumerInput(nullptr), pServer(nullptr) {
+    : connectedClients(0),
+      inputHost(HID_ALL_HOSTS),
+      deliveryCallback(nullptr) {
+    memset(hosts, 0, sizeof(hosts));
+    memset(stages, 0, sizeof(stages));
+    memset(txQueues, 0, sizeof(txQueues));
+    resetReportStats();
 }
 
 void BluetoothHandler::begin() {
-    xTaskCreate(bluetoothTask, "bluetooth", 5000, NULL, 5, NULL);
+    hal::getHidTransport().begin();
 }
 
-void BluetoothHandler::initBLE() {
-    BLEDevice::init(DEVICE_NAME);
-    pServer = BLEDevice::createServer();
-    pServer->setCallbacks(new MultiClientServerCallbacks());
+bool BluetoothHandler::sendReport(HidChannel channel, const uint8_t* report, size_t length) {
+  if (connectedClients == 0) return false;
 
-    hid = new BLEHIDDevice(pServer);
-    headsetInput = hid->inputReport(HID_REPORTID_PHONE_INPUT);
-    keyboardInput = hid->inputReport(HID_REPORTID_KEYBOARD_INPUT);
-    consumerInput = hid->inputReport(HID_REPORTID_CONSUMER_INPUT);
-    
-    // Initialize output report with report ID and set callback
-    headsetOutput = hid->outputReport(HID_REPORTID_LED_OUTPUT);
-    headsetOutput->setCallbacks(new OutputCallbacks());
+  LOG_DEBUG("Report on channel %d (%d bytes), first byte %02X", channel, (int)length, report[0]);
 
-    hid->manufacturer()->setValue(DEVICE_MANUFACTURER);
-    hid->pnp(0x02, DEVICE_VID, DEVICE_PID, DEVICE_VERSION);
-    hid->hidInfo(0x00, 0x01);
+  // Only telephony state fans out; keystrokes must not land on a host that is not in the call
+  uint16_t input = getInputHost();
+  bool staged = false;
+  bool success = true;
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS && length <= sizeof(OutboundStage::last); i++) {
+    if (!hosts[i].connected) continue;
+    if (channel != HID_CHANNEL_HEADSET && hosts[i].connId != input) continue;
+    staged = true;
+    success = stageReport(i, channel, report, (uint8_t)length) && success;
+  }
+  if (staged) return success;
 
-    BLESecurity* pSecurity = new BLESecurity();
-    pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+  // Not in the host table yet (or table full): send unstaged
+  uint16_t target = (channel == HID_CHANNEL_HEADSET) ? HID_ALL_HOSTS : input;
+  getEventTrace().record(TRACE_NOTIFY, EventTrace::hostId(target), channel, report[0]);
+  return hal::getHidTransport().send(channel, report, length, target);
+}
 
-    hid->reportMap((uint8_t*)REPORT_MAP, sizeof(REPORT_MAP));
-    hid->startServices();
+OutboundStage& BluetoothHandler::stageFor(uint8_t slot, HidChannel channel) {
+  // A reconnect in the same slot starts from scratch: the host has seen nothing yet
+  OutboundStage& stage = stages[slot][channel];
+  uint32_t generation = hosts[slot].generation;
+  if (stage.generation != generation) {
+    memset(&stage, 0, sizeof(stage));
+    stage.generation = generation;
+  }
+  return stage;
+}
+
+bool BluetoothHandler::stageReport(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length) {
+  OutboundStage& stage = stageFor(slot, channel);
 
-    BLEAdvertising* pAdvertising = pServer->getAdvertising();
-    // Change the appearance to a keyboard+pointer device
-    pAdvertising->setAppearance(0x03C0);  // Keyboard/pointer HID
-    pAdvertising->addServiceUUID(hid->hidService()->getUUID());
-    pAdvertising->start();
+  if (stage.pendingLength) {
+    // A hook pulse must reach the host even if the release follows within the same interval
+    bool dropsPulse = (stage.pending[0] & HEADSET_DROP) && !(report[0] & HEADSET_DROP);
+    if (!dropsPulse) {
+      memcpy(stage.pending, report, length);
+      stage.pendingLength = length;
+      reportsCollapsed[channel]++;
+      return true;
+    }
+    flush(slot, channel);
+  }
 
-    LOG_INFO("BLE Initialized: %s", DEVICE_NAME);
+  if (stage.lastLength == length && memcmp(stage.last, report, length) == 0) {
+    reportsElided[channel]++;
+    return true;
+  }
+
+  // Keystrokes and volume steps are edges, so only telephony state may wait and collapse
+  if (channel == HID_CHANNEL_HEADSET && busyFor(slot, stage) > 0) {
+    memcpy(stage.pending, report, length);
+    stage.pendingLength = length;
+    return true;
+  }
+  return transmit(slot, channel, report, length);
 }
 
-bool BluetoothHandler::sendReport(BLECharacteristic* characteristic, uint8_t* report, size_t length, bool notifyAll) {
-  if (connectedClients == 0 || !characteristic) return false;
+bool BluetoothHandler::transmit(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length) {
+  if (!enqueue(slot, channel, report, length)) {
+    return false;
+  }
+  OutboundStage& stage = stages[slot][channel];
+  memcpy(stage.last, report, length);
+  stage.lastLength = length;
+  stage.lastSendTime = micros();
+  pump(slot);
+  return true;
+}
 
-  LOG_DEBUG("Report data (hex, length=%d): ", length);
-  char buffer[length * 3 + 1]; // 2 hex chars + space for each byte + null terminator
-  int bufferIndex = 0;
-  for (int i = 0; i < length; i++) {
-    sprintf(buffer + bufferIndex, "%02X ", report[i]);
-    bufferIndex += 3;
+void BluetoothHandler::flush(uint8_t slot, HidChannel channel) {
+  OutboundStage& stage = stages[slot][channel];
+  uint8_t length = stage.pendingLength;
+  stage.pendingLength = 0;
+  if (stage.lastLength == length && memcmp(stage.last, stage.pending, length) == 0) {
+    reportsElided[channel]++;  // collapsed back into what the host already has
+    return;
   }
-  buffer[bufferIndex] = '\0'; // Null-terminate the string
-  LOG_DEBUG("%s", buffer);
+  transmit(slot, channel, stage.pending, length);
+}
 
-  // Set the report value
-  characteristic->setValue(report, length);
+int32_t BluetoothHandler::busyFor(uint8_t slot, const OutboundStage& stage) const {
+  // One notification per connection event; an unknown interval never holds reports back
+  if (!stage.lastLength) return 0;
+  uint32_t interval = hosts[slot].interval * 1250UL;
+  return (int32_t)(interval - (micros() - stage.lastSendTime));
+}
 
-  // Notify clients
-  characteristic->notify(notifyAll);
-  
-  // The ESP32 BLE notify() returns void, so we just return success if we got this far
+TxQueue& BluetoothHandler::queueFor(uint8_t slot) {
+  // Whatever was queued for a previous connection in this slot is gone with it
+  TxQueue& queue = txQueues[slot];
+  uint32_t generation = hosts[slot].generation;
+  if (queue.generation != generation) {
+    memset(&queue, 0, sizeof(queue));
+    queue.generation = generation;
+  }
+  return queue;
+}
+
+bool BluetoothHandler::enqueue(uint8_t slot, HidChannel channel, const uint8_t* report, uint8_t length) {
+  TxQueue& queue = queueFor(slot);
+  bool telephony = (channel == HID_CHANNEL_HEADSET);
+
+  // Newest entry of this characteristic still waiting; the in-flight head is already with the stack
+  TxEntry* stale = nullptr;
+  for (uint8_t i = queue.count; i > (queue.inFlight ? 1 : 0); i--) {
+    if (queue.entries[i - 1].channel == channel) {
+      stale = &queue.entries[i - 1];
+      break;
+    }
+  }
+  bool keepsPulse = telephony && stale && (stale->data[0] & HEADSET_DROP) && !(report[0] & HEADSET_DROP);
+
+  // Telephony state supersedes what has not gone out yet, except a hang-up pulse
+  if (telephony && stale && !keepsPulse) {
+    memcpy(stale->data, report, length);
+    stale->length = length;
+    stale->attempts = 0;
+    reportsCollapsed[channel]++;
+    return true;
+  }
+
+  uint8_t limit = telephony ? BLE_TX_QUEUE_SIZE : BLE_TX_QUEUE_SIZE - BLE_TX_TELEPHONY_RESERVE;
+  if (queue.count >= limit) {
+    reportsDropped[channel]++;
+    if (telephony || !stale) {
+      LOG_WARN("Transmit queue full, report for conn %d dropped", hosts[slot].connId);
+      return false;
+    }
+    // Out of room for keystrokes: the newest state wins, so no key is left held
+    memcpy(stale->data, report, length);
+    stale->length = length;
+    stale->attempts = 0;
+    return true;
+  }
+
+  // Telephony goes ahead of every waiting keystroke
+  uint8_t pos = queue.count;
+  if (telephony) {
+    pos = queue.inFlight ? 1 : 0;
+    while (pos < queue.count && queue.entries[pos].channel == HID_CHANNEL_HEADSET) pos++;
+    memmove(&queue.entries[pos + 1], &queue.entries[pos], (queue.count - pos) * sizeof(TxEntry));
+  }
+  TxEntry& entry = queue.entries[pos];
+  entry.channel = channel;
+  entry.length = length;
+  entry.attempts = 0;
+  memcpy(entry.data, report, length);
+  queue.count++;
+  return true;
+}
+
+void BluetoothHandler::pump(uint8_t slot) {
+  TxQueue& queue = queueFor(slot);
+  if (!queue.count || queue.congested || !hosts[slot].connected) return;
+
+  uint32_t now = micros();
+  if (queue.inFlight) {
+    // A confirm that never comes must not stall the link
+    if (now - queue.sendTime >= BLE_TX_CONFIRM_TIMEOUT * 1000UL) {
+      LOG_WARN("No confirm from conn %d, resending", hosts[slot].connId);
+      completeHead(slot, false);
+    }
+    return;
+  }
+  if ((int32_t)(now - queue.sendTime) < 0) return;  // retry not due yet
+
+  // One notification in flight per host keeps confirms in order
+  TxEntry& head = queue.entries[0];
+  head.attempts++;
+  queue.inFlight = true;
+  queue.sendTime = now;
+  getEventTrace().record(TRACE_NOTIFY, EventTrace::hostId(hosts[slot].connId), head.channel, head.data[0]);
+  if (!hal::getHidTransport().send(head.channel, head.data, head.length, hosts[slot].connId)) {
+    completeHead(slot, false);
+  }
+}
+
+void BluetoothHandler::completeHead(uint8_t slot, bool success) {
+  TxQueue& queue = txQueues[slot];
+  if (!queue.inFlight) return;  // a broadcast, or a queue a reconnect has reset
+  queue.inFlight = false;
+
+  TxEntry& head = queue.entries[0];
+  HidChannel channel = head.channel;
+  uint8_t firstByte = head.data[0];
+  bool dropHead = success;
+  if (success) {
+    reportsSent[head.channel]++;
+  } else {
+    reportsRetried[head.channel]++;
+
+    // Telephony state and key releases are retried until they land; a press may be given up
+    bool release = true;
+    for (uint8_t i = 0; i < head.length; i++) {
+      if (head.data[i]) release = false;
+    }
+    if (head.channel != HID_CHANNEL_HEADSET && !release && head.attempts >= BLE_TX_MAX_ATTEMPTS) {
+      LOG_WARN("Gave up on a report to conn %d after %d attempts", hosts[slot].connId, head.attempts);
+      reportsDropped[head.channel]++;
+      dropHead = true;
+    } else {
+      // Try again at the next connection event
+      uint32_t interval = hosts[slot].interval * 1250UL;
+      queue.sendTime = micros() + (interval > 1000 ? interval : 1000);
+    }
+  }
+
+  if (dropHead) {
+    queue.count--;
+    memmove(&queue.entries[0], &queue.entries[1], queue.count * sizeof(TxEntry));
+  }
+  if (deliveryCallback) {
+    deliveryCallback(channel, hosts[slot].connId, firstByte, success);
+  }
+}
+
+void BluetoothHandler::processTxEvents() {
+  TxEvent event;
+  while (txEvents.pop(event)) {
+    int8_t slot = findSlot(event.connId);
+    if (slot < 0) continue;
+    TxQueue& queue = queueFor(slot);
+    switch (event.type) {
+      case TX_CONFIRMED:   completeHead(slot, true); break;
+      case TX_FAILED:      completeHead(slot, false); break;
+      case TX_CONGESTED:   queue.congested = true; break;
+      case TX_UNCONGESTED: queue.congested = false; break;
+    }
+  }
+}
+
+int8_t BluetoothHandler::findSlot(uint16_t connId) const {
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (hosts[i].connected && hosts[i].connId == connId) return i;
+  }
+  return -1;
+}
+
+void BluetoothHandler::update() {
+  processTxEvents();
+
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (!hosts[i].connected) {
+      // Nothing waits for a host that is gone
+      for (uint8_t c = 0; c < HID_CHANNEL_COUNT; c++) {
+        stageFor(i, (HidChannel)c).pendingLength = 0;
+      }
+      queueFor(i).count = 0;
+      txQueues[i].inFlight = false;
+      continue;
+    }
+    for (uint8_t c = 0; c < HID_CHANNEL_COUNT; c++) {
+      OutboundStage& stage = stageFor(i, (HidChannel)c);
+      if (stage.pendingLength && busyFor(i, stage) <= 0) {
+        flush(i, (HidChannel)c);
+      }
+    }
+    pump(i);
+  }
+}
+
+uint32_t BluetoothHandler::getTimeUntilNextFlush() const {
+  uint32_t timeout = UINT32_MAX;
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (!hosts[i].connected) continue;
+    for (uint8_t c = 0; c < HID_CHANNEL_COUNT; c++) {
+      const OutboundStage& stage = stages[i][c];
+      if (!stage.pendingLength || stage.generation != hosts[i].generation) continue;
+      int32_t busy = busyFor(i, stage);
+      uint32_t wait = busy > 0 ? (busy + 999) / 1000 : 0;
+      if (wait < timeout) timeout = wait;
+    }
+
+    // A congested link wakes us when it clears; a confirm wakes us or times out
+    const TxQueue& queue = txQueues[i];
+    if (!queue.count || queue.congested || queue.generation != hosts[i].generation) continue;
+    int32_t due = queue.inFlight
+        ? (int32_t)(queue.sendTime + BLE_TX_CONFIRM_TIMEOUT * 1000UL - micros())
+        : (int32_t)(queue.sendTime - micros());
+    uint32_t wait = due > 0 ? (due + 999) / 1000 : 0;
+    if (wait < timeout) timeout = wait;
+  }
+  return timeout;
+}
+
+bool BluetoothHandler::isDelivered(HidChannel channel) const {
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (!hosts[i].connected) continue;
+    if (stages[i][channel].generation == hosts[i].generation && stages[i][channel].pendingLength) return false;
+    const TxQueue& queue = txQueues[i];
+    if (queue.generation != hosts[i].generation) continue;
+    for (uint8_t e = 0; e < queue.count; e++) {
+      if (queue.entries[e].channel == channel) return false;
+    }
+  }
   return true;
 }
 
+void BluetoothHandler::resetReportStats() {
+  memset(reportsSent, 0, sizeof(reportsSent));
+  memset(reportsElided, 0, sizeof(reportsElided));
+  memset(reportsCollapsed, 0, sizeof(reportsCollapsed));
+  memset(reportsRetried, 0, sizeof(reportsRetried));
+  memset(reportsDropped, 0, sizeof(reportsDropped));
+}
+
 bool BluetoothHandler::sendHeadsetReport(uint8_t reportValue) {
-  if (!headsetInput) {
+  if (!isInitialized()) {
     LOG_ERROR("Headset input not initialized.");
     return false;
   }
@@ -84,7 +344,7 @@ bool BluetoothHandler::sendHeadsetReport(uint8_t reportValue) {
     LOG_WARN("No connected clients to send headset report.");
     return false; 
   }
-  bool success = sendReport(headsetInput, &reportValue, 1);
+  bool success = sendReport(HID_CHANNEL_HEADSET, &reportValue, 1);
   if (!success) {
     LOG_ERROR("Failed to send headset report!");
   }
@@ -92,7 +352,7 @@ bool BluetoothHandler::sendHeadsetReport(uint8_t reportValue) {
 }
 
 bool BluetoothHandler::sendKeyboardReport(uint8_t* reportValue) {
-  if (!keyboardInput) {
+  if (!isInitialized()) {
     LOG_ERROR("Keyboard input not initialized.");
     return false;
   }
@@ -100,8 +360,7 @@ bool BluetoothHandler::sendKeyboardReport(uint8_t* reportValue) {
     LOG_WARN("No connected clients to send keyboard report.");
     return false; 
   }
-  // Silently fail if keyboard input is not initialized
-  bool success = sendReport(keyboardInput, reportValue, 8);
+  bool success = sendReport(HID_CHANNEL_KEYBOARD, reportValue, 8);
   if (!success) {
     LOG_ERROR("Failed to send keyboard report!");
   }
@@ -109,7 +368,7 @@ bool BluetoothHandler::sendKeyboardReport(uint8_t* reportValue) {
 }
 
 bool BluetoothHandler::sendConsumerReport(uint16_t consumerCode) {
-  if (!consumerInput) {
+  if (!isInitialized()) {
     LOG_ERROR("Consumer input not initialized.");
     return false;
   }
@@ -121,7 +380,7 @@ bool BluetoothHandler::sendConsumerReport(uint16_t consumerCode) {
   // Consumer report is 1 byte as per the HID descriptor
   uint8_t report = (uint8_t)(consumerCode & 0xFF);
   
-  bool success = sendReport(consumerInput, &report, 1);
+  bool success = sendReport(HID_CHANNEL_CONSUMER, &report, 1);
   if (!success) {
     LOG_ERROR("Failed to send consumer report!");
   }
@@ -129,80 +388,245 @@ bool BluetoothHandler::sendConsumerReport(uint16_t consumerCode) {
 }
 
 void BluetoothHandler::startAdvertising() {
-  BLEAdvertising* pAdvertising = pServer->getAdvertising();
-  if (!pServer || !pAdvertising) {
+  if (!isInitialized()) {
     LOG_ERROR("BLE Server or Advertising not initialized");
     return;
   }
 
-  pAdvertising->start();
+  hal::getHidTransport().startAdvertising();
 }
 
-void bluetoothTask(void* pvParameters) {
-    BluetoothHandler& handler = BluetoothHandler::getInstance();
-    handler.initBLE();
-    vTaskDelete(NULL);
+// --- Transport callbacks ---
+// The BLE stack calls these on its own task; each only queues an event for
+// the controller task, which owns the host table
+
+void BluetoothHandler::onClientConnected(uint16_t connId) {
+    HostEvent event = {};
+    event.type = HOST_CONNECTED;
+    event.connId = connId;
+    postHostEvent(event);
 }
 
-// MultiClientServerCallbacks implementation
-void MultiClientServerCallbacks::onConnect(BLEServer* pServer) {
-    BluetoothHandler& handler = BluetoothHandler::getInstance();
-    handler.connectedClients++;
-    LOG_INFO("BLE Client connected. Total clients: %d", handler.connectedClients);
+void BluetoothHandler::onClientDisconnected(uint16_t connId) {
+    HostEvent event = {};
+    event.type = HOST_DISCONNECTED;
+    event.connId = connId;
+    postHostEvent(event);
+}
 
-    // Workaround for Windows and other devices that don't register for notifications
-    // when reconnecting to a previously paired device
-    auto enableNotifications = [&](BLECharacteristic* characteristic) {
-      if (characteristic) {
-        BLEDescriptor* desc = characteristic->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
-        if (desc) {
-          uint8_t val[] = {0x01, 0x00};
-          desc->setValue(val, 2);
+void BluetoothHandler::onOutputReport(uint16_t connId, const uint8_t* data, size_t length) {
+    // Process LED commands from host if they are the right length
+    if (length == 0) return;
+    HostEvent event = {};
+    event.type = HOST_LEDS;
+    event.connId = connId;
+    event.leds = data[0];
+    postHostEvent(event);
+}
+
+void BluetoothHandler::onConnectionParams(uint16_t connId, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    HostEvent event = {};
+    event.type = HOST_PARAMS;
+    event.connId = connId;
+    event.interval = interval;
+    event.latency = latency;
+    event.timeout = timeout;
+    postHostEvent(event);
+}
+
+void BluetoothHandler::onNotifyComplete(uint16_t connId, bool success) {
+    postTxEvent(success ? TX_CONFIRMED : TX_FAILED, connId);
+}
+
+void BluetoothHandler::onCongestion(uint16_t connId, bool congested) {
+    if (congested) {
+        LOG_DEBUG("Conn %d congested", connId);
+    }
+    postTxEvent(congested ? TX_CONGESTED : TX_UNCONGESTED, connId);
+}
+
+void BluetoothHandler::postTxEvent(TxEventType type, uint16_t connId) {
+    getEventTrace().record(TRACE_NOTIFY_DONE, EventTrace::hostId(connId), type);
+    
+    // Anything but the onset of congestion lets the controller send again
+    TxEvent event = { type, connId };
+    if (txEvents.push(event) && type != TX_CONGESTED) {
+        getInputQueue().push(INPUT_SOURCE_HOST, 0);
+    }
+}
+
+HostConnection* BluetoothHandler::findHost(uint16_t connId) {
+    for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        if (hosts[i].connected && hosts[i].connId == connId) return &hosts[i];
+    }
+    return nullptr;
+}
+
+void BluetoothHandler::updateInputHost() {
+    // Latest host to go off-hook wins; without a call, the latest to connect or hang up
+    const HostConnection* best = nullptr;
+    for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        const HostConnection& host = hosts[i];
+        if (!host.connected) continue;
+        if (!best || host.callActive > best->callActive ||
+            (host.callActive == best->callActive && (int32_t)(host.stateTime - best->stateTime) > 0)) {
+            best = &host;
         }
-      }
-    };
+    }
+    
+    uint16_t connId = best ? best->connId : HID_ALL_HOSTS;
+    if (inputHost.exchange(connId, std::memory_order_relaxed) != connId && best) {
+        LOG_INFO("Keystrokes now go to conn %d (call %s)", connId, best->callActive ? "active" : "idle");
+    }
+}
 
-    enableNotifications(handler.headsetInput);
-    enableNotifications(handler.keyboardInput);
-    enableNotifications(handler.consumerInput);
+void BluetoothHandler::applyLinkProfile() {
+    // Telephony reports fan out to every host, so every link is sped up during a call
+    bool anyCall = false;
+    for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        if (hosts[i].connected && hosts[i].callActive) anyCall = true;
+    }
+    HidLinkProfile wanted = anyCall ? HID_LINK_FAST : HID_LINK_IDLE;
     
-    // pServer->getAdvertising()->start();
+    for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+        HostConnection& host = hosts[i];
+        if (!host.connected || host.profile == wanted) continue;
+        host.profile = wanted;
+        LOG_DEBUG("Requesting %s link on conn %d", anyCall ? "fast" : "idle", host.connId);
+        hal::getHidTransport().requestLinkProfile(host.connId, wanted);
+    }
+}
+
+void BluetoothHandler::postHostEvent(const HostEvent& event) {
+    // Hand the event to the controller task; never touch the host table,
+    // controller state or the LED strip from the BLE stack's context
+    if (hostEvents.push(event)) {
+        getInputQueue().push(INPUT_SOURCE_HOST, 0);
+    } else {
+        LOG_WARN("Host event ring full, event %d for conn %d lost", event.type, event.connId);
+    }
+}
+
+// --- Host table (controller task) ---
+
+bool BluetoothHandler::pollHostEvent(HostEvent& event) {
+    HostEvent link;
+    while (hostEvents.pop(link)) {
+        if (applyHostEvent(link, event)) return true;
+    }
+    return false;
+}
+
+bool BluetoothHandler::applyHostEvent(const HostEvent& event, HostEvent& state) {
+    switch (event.type) {
+        case HOST_CONNECTED:
+            applyConnected(event.connId);
+            return false;
+        case HOST_DISCONNECTED:
+            return applyDisconnected(event.connId, state);
+        case HOST_LEDS:
+            return applyLeds(event.connId, event.leds, state);
+        case HOST_PARAMS:
+            applyParams(event);
+            return false;
+        default:
+            return false;
+    }
 }
 
-void MultiClientServerCallbacks::onDisconnect(BLEServer* pServer) {
-    BluetoothHandler& handler = BluetoothHandler::getInstance();
-    handler.connectedClients--;
-    LOG_INFO("Client disconnected. Total clients: %d", handler.connectedClients);
+void BluetoothHandler::applyConnected(uint16_t connId) {
+    connectedClients++;
+    LOG_INFO("BLE Client connected (conn %d). Total clients: %d", connId, connectedClients);
+    
+    HostConnection* host = findHost(connId);
+    for (uint8_t i = 0; !host && i < MAX_BLE_CONNECTIONS; i++) {
+        if (!hosts[i].connected) host = &hosts[i];
+    }
+    if (!host) {
+        LOG_WARN("Host table full, conn %d only gets broadcasts", connId);
+        return;
+    }
+    host->connId = connId;
+    host->connected = true;
+    host->callActive = false;
+    host->muteState = false;
+    host->stateTime = millis();
+    host->interval = 0;
+    host->latency = 0;
+    host->timeout = 0;
+    host->profile = HID_LINK_IDLE;  // whatever the host picked; only sped-up links get relaxed
+    host->generation++;
+    updateInputHost();
+    applyLinkProfile();
 }
 
-// OutputCallbacks implementation
-void OutputCallbacks::onWrite(BLECharacteristic* pCharacteristic) {
-    // Serial.print("Received packet from host, characteristic UUID: ");
-    // Serial.println(pCharacteristic->getUUID().toString().c_str());
-    // Serial.print("Data length: ");
-    // Serial.println(pCharacteristic->getValue().length());
+bool BluetoothHandler::applyDisconnected(uint16_t connId, HostEvent& state) {
+    if (connectedClients > 0) {
+        connectedClients--;
+    }
+    LOG_INFO("Client disconnected (conn %d). Total clients: %d", connId, connectedClients);
     
-    std::string value = pCharacteristic->getValue();
-    // Serial.print("Data (hex): ");
-    // for (int i = 0; i < value.length(); i++) {
-    //   Serial.printf("%02X ", value[i]);
-    // }
-    // Serial.println();
+    HostConnection* host = findHost(connId);
+    if (!host) return false;
+    bool hadInput = (connId == getInputHost());
+    host->connected = false;
+    updateInputHost();
+    applyLinkProfile();
     
-    // Process LED commands from host if they are the right length
-    if (value.length() > 0) {
-      uint8_t reportData = value[0];
-      bool ledMuteState = reportData & 0x01;
-      bool ledOffHookState = reportData & 0x02;
-      
-      LOG_DEBUG("Host state: Call %s, %s", 
-        ledOffHookState ? "ACTIVE" : "IDLE",
-        ledMuteState ? "MUTED" : "UNMUTED");
-
-      // Use callback to update device controller state
-      BluetoothHandler& handler = BluetoothHandler::getInstance();
-      if (handler.hostStateCallback) {
-          handler.hostStateCallback(ledOffHookState, ledMuteState);
-      }
+    // Losing the host in the call hands call state to whoever takes over input
+    if (!hadInput || !host->callActive) return false;
+    HostConnection* next = findHost(getInputHost());
+    state = {};
+    state.type = HOST_STATE_UPDATE;
+    state.connId = getInputHost();
+    state.callActive = next && next->callActive;
+    state.muteState = next && next->callActive && next->muteState;
+    return true;
+}
+
+bool BluetoothHandler::applyLeds(uint16_t connId, uint8_t leds, HostEvent& state) {
+    bool ledMuteState = leds & 0x01;
+    bool ledOffHookState = leds & 0x02;
+    
+    LOG_DEBUG("Host state (conn %d): Call %s, %s", connId,
+      ledOffHookState ? "ACTIVE" : "IDLE",
+      ledMuteState ? "MUTED" : "UNMUTED");
+
+    HostConnection* host = findHost(connId);
+    if (host) {
+        if (host->callActive != ledOffHookState) {
+            host->stateTime = millis();
+        }
+        host->callActive = ledOffHookState;
+        host->muteState = ledMuteState;
+        
+        // The host may have changed state on its own, so what it was last sent
+        // no longer says what it has: the next report must not be elided
+        stageFor(host - hosts, HID_CHANNEL_HEADSET).lastLength = 0;
+        updateInputHost();
+        applyLinkProfile();
+        
+        // A bystander host reporting idle must not end the call another host is in
+        if (connId != getInputHost()) {
+            HostConnection* input = findHost(getInputHost());
+            if (input && input->callActive) return false;
+        }
     }
+
+    state = {};
+    state.type = HOST_STATE_UPDATE;
+    state.connId = connId;
+    state.callActive = ledOffHookState;
+    state.muteState = ledMuteState;
+    return true;
+}
+
+void BluetoothHandler::applyParams(const HostEvent& event) {
+    HostConnection* host = findHost(event.connId);
+    if (!host) return;
+    host->interval = event.interval;
+    host->latency = event.latency;
+    host->timeout = event.timeout;
+    LOG_INFO("Conn %d parameters: interval %u.%02u ms, latency %u, timeout %u ms", event.connId,
+             event.interval * 125 / 100, event.interval * 125 % 100, event.latency, event.timeout * 10);
 }
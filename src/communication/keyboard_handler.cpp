@@ -15,86 +15,73 @@ KeyboardHandler::KeyboardHandler() {
 
 void KeyboardHandler::sendRightArrow() {
     // Right arrow key - no modifiers
-    sendKeys(0, KEY_RIGHT_ARROW);
-    delay(200);  // Small delay for key press
-    releaseAllKeys();
+    queueKeyTap(0, KEY_RIGHT_ARROW, 200);
 }
 
 void KeyboardHandler::sendLeftArrow() {
     // Left arrow key - no modifiers
-    sendKeys(0, KEY_LEFT_ARROW);
-    delay(200);  // Small delay for key press
-    releaseAllKeys();
+    queueKeyTap(0, KEY_LEFT_ARROW, 200);
 }
 
 void KeyboardHandler::sendCtrlShiftF1() {
     // CTRL+SHIFT+F1 - combining CTRL and SHIFT with F1
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_SHIFT, KEY_F1);
-    delay(200);  // Small delay for key press
-    releaseAllKeys();
+    queueKeyTap(KEY_LEFT_CTRL | KEY_LEFT_SHIFT, KEY_F1, 200);
 }
 
 void KeyboardHandler::sendCtrlE() {
     // CTRL+E - combining CTRL with E
-    sendKeys(KEY_LEFT_CTRL, KEY_E);
-    delay(200);  // Small delay for key press
-    releaseAllKeys();
+    queueKeyTap(KEY_LEFT_CTRL, KEY_E, 200);
 }
 
 void KeyboardHandler::sendCtrlAltH() {
     // CTRL+ALT+H - combining CTRL and ALT with H
     // Try shorter delay first - Google Meet might be timing-sensitive
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT);
-    delay(50);
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
-    delay(50);
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT);
-    delay(50);
-    releaseAllKeys();
+    if (!beginSequence(4)) return;
+    queueKeys(0, KEY_LEFT_CTRL | KEY_LEFT_ALT);
+    queueKeys(50, KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
+    queueKeys(50, KEY_LEFT_CTRL | KEY_LEFT_ALT);
+    queueKeys(50);
 }
 
 void KeyboardHandler::sendCtrlAltHAlternative1() {
     // Alternative 1: Sequential key presses
     LOG_DEBUG("Sending Ctrl+Alt+H (Sequential method)");
+    if (!beginSequence(3)) return;
     
     // Press and hold modifiers first
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT, 0);
-    delay(50);
+    queueKeys(0, KEY_LEFT_CTRL | KEY_LEFT_ALT, 0);
     
     // Add H key while holding modifiers
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
-    delay(100);
+    queueKeys(50, KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
     
     // Release all keys
-    releaseAllKeys();
-    delay(50);
+    queueKeys(100);
+    queueGap(50);
 }
 
 void KeyboardHandler::sendCtrlAltHAlternative2() {
     // Alternative 2: Very short timing (more like a real keypress)
     LOG_DEBUG("Sending Ctrl+Alt+H (Fast timing method)");
+    if (!beginSequence(2)) return;
     
-    sendKeys(KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
-    delay(50);   // Very short delay
-    releaseAllKeys();
-    delay(25);
+    queueKeys(0, KEY_LEFT_CTRL | KEY_LEFT_ALT, KEY_H);
+    queueKeys(50);   // Very short hold
+    queueGap(25);
 }
 
 void KeyboardHandler::sendCtrlAltHAlternative3() {
     // Alternative 3: Use right modifiers instead of left
     LOG_DEBUG("Sending Ctrl+Alt+H (Right modifiers method)");
+    if (!beginSequence(2)) return;
     
-    sendKeys(KEY_RIGHT_CTRL | KEY_RIGHT_ALT, KEY_H);
-    delay(100);
-    releaseAllKeys();
-    delay(50);
+    queueKeys(0, KEY_RIGHT_CTRL | KEY_RIGHT_ALT, KEY_H);
+    queueKeys(100);
+    queueGap(50);
 }
 
 void KeyboardHandler::sendA() {
     // Send 'a' key - no modifiers
-    sendKeys(0, KEY_A);
-    delay(200);  // Small delay for key press
-    releaseAllKeys();
+    queueKeyTap(0, KEY_A, 200);
 }
 
 void KeyboardHandler::sendShortcut(uint8_t shortcutType) {
@@ -148,29 +135,177 @@ void KeyboardHandler::releaseAllKeys() {
 }
 
 // --- Consumer Control Methods ---
-void KeyboardHandler::sendVolumeUp() {
-    LOG_DEBUG("Sending Volume Up");
-    // Send volume up command (bit 0 set)
-    getBLEHandler().sendConsumerReport(CONSUMER_VOLUME_UP);
-    delay(50);  // Brief press
-    // Send release (all bits clear)
-    getBLEHandler().sendConsumerReport(0x00);
+void KeyboardHandler::sendVolumeUp(uint8_t steps) {
+    LOG_DEBUG("Sending Volume Up x%d", steps);
+    // Volume up (bit 0 set), one press/release pair per step
+    queueConsumerSteps(CONSUMER_VOLUME_UP, steps);
 }
 
-void KeyboardHandler::sendVolumeDown() {
-    LOG_DEBUG("Sending Volume Down");
-    // Send volume down command (bit 1 set)
-    getBLEHandler().sendConsumerReport(CONSUMER_VOLUME_DOWN);
-    delay(50);  // Brief press
-    // Send release (all bits clear)
-    getBLEHandler().sendConsumerReport(0x00);
+void KeyboardHandler::sendVolumeDown(uint8_t steps) {
+    LOG_DEBUG("Sending Volume Down x%d", steps);
+    // Volume down (bit 1 set), one press/release pair per step
+    queueConsumerSteps(CONSUMER_VOLUME_DOWN, steps);
 }
 
 void KeyboardHandler::sendConsumerMute() {
     LOG_DEBUG("Sending Consumer Mute");
-    // Send mute command (bit 2 set)
-    getBLEHandler().sendConsumerReport(CONSUMER_MUTE);
-    delay(50);  // Brief press
-    // Send release (all bits clear)
-    getBLEHandler().sendConsumerReport(0x00);
-}
\ No newline at end of file
+    // Mute (bit 2 set), released after a brief press
+    queueConsumerTap(CONSUMER_MUTE, 50);
+}
+
+void KeyboardHandler::sendHeadsetPulse(uint8_t pulseBits, uint16_t holdTime) {
+    // Only the pulse bits are queued; the rest of each report is read when it
+    // goes out, so a mute change during the hold is not reverted by the release
+    if (!beginSequence(2)) return;
+    queueHeadset(0, REPORT_HEADSET_PRESS, pulseBits);
+    queueHeadset(holdTime, REPORT_HEADSET_RELEASE, pulseBits);
+}
+
+// --- Keystroke Scheduler ---
+// Shortcuts are queued as timed steps and emitted from update(), so the main
+// loop never sleeps between press and release. Sequences are laid out back to
+// back on a shared timeline, so a new shortcut never interleaves with the
+// release of the previous one.
+
+void KeyboardHandler::update() {
+    uint32_t now = millis();
+    while (queueCount > 0) {
+        ScheduledReport& report = queue[queueHead];
+        if ((int32_t)(now - report.dueTime) < 0) break;
+        
+        emit(report);
+        queueHead = (queueHead + 1) % KEY_SCHEDULER_QUEUE_SIZE;
+        queueCount--;
+    }
+}
+
+uint32_t KeyboardHandler::getTimeUntilNextReport() const {
+    if (queueCount == 0) return UINT32_MAX;
+    int32_t remaining = (int32_t)(queue[queueHead].dueTime - millis());
+    return remaining > 0 ? remaining : 0;
+}
+
+void KeyboardHandler::emit(const ScheduledReport& report) {
+    bool sent = false;
+    switch (report.type) {
+        case REPORT_KEYBOARD:
+            LOG_DEBUG("Sending keyboard report: [%02X %02X %02X %02X %02X %02X %02X %02X]",
+                      report.data[0], report.data[1], report.data[2], report.data[3],
+                      report.data[4], report.data[5], report.data[6], report.data[7]);
+            sent = getBLEHandler().sendKeyboardReport((uint8_t*)report.data);
+            break;
+        case REPORT_CONSUMER:
+            sent = getBLEHandler().sendConsumerReport(report.data[0]);
+            break;
+        case REPORT_HEADSET_PRESS:
+        case REPORT_HEADSET_RELEASE: {
+            if (report.type == REPORT_HEADSET_PRESS) {
+                headsetHeld |= report.data[0];
+            } else {
+                headsetHeld &= ~report.data[0];
+            }
+            uint8_t live = headsetStateCallback ? headsetStateCallback() : 0;
+            sent = getBLEHandler().sendHeadsetReport(live | headsetHeld);
+            break;
+        }
+    }
+    
+    if (!sent) {
+        reportsDropped++;
+        return;
+    }
+    reportsSent++;
+    if (report.requestTime != 0) {
+        latencyStats.record(micros() - report.requestTime);
+    }
+}
+
+bool KeyboardHandler::beginSequence(uint16_t stepCount) {
+    if (queueCount + stepCount > KEY_SCHEDULER_QUEUE_SIZE) {
+        LOG_WARN("Keystroke queue full, dropping shortcut (%d queued)", queueCount);
+        reportsDropped += stepCount;
+        return false;
+    }
+    
+    // Start now, or right after the last queued step if it is still pending
+    uint32_t now = millis();
+    if ((int32_t)(scheduleCursor - now) < 0) {
+        scheduleCursor = now;
+    }
+    sequenceRequestTime = inputTime ? inputTime : micros();
+    if (sequenceRequestTime == 0) sequenceRequestTime = 1; // 0 marks follow-up steps
+    return true;
+}
+
+void KeyboardHandler::queueStep(uint16_t delayMs, ScheduledReportType type, const uint8_t* data, size_t length) {
+    scheduleCursor += delayMs;
+    
+    ScheduledReport& report = queue[(queueHead + queueCount) % KEY_SCHEDULER_QUEUE_SIZE];
+    report.dueTime = scheduleCursor;
+    report.requestTime = sequenceRequestTime;
+    report.type = type;
+    memset(report.data, 0, sizeof(report.data));
+    memcpy(report.data, data, length);
+    queueCount++;
+    
+    // Only the first step of a sequence measures input-to-report latency
+    sequenceRequestTime = 0;
+}
+
+void KeyboardHandler::queueKeys(uint16_t delayMs, uint8_t modifiers, uint8_t key1) {
+    // Standard keyboard report structure: [modifier, reserved, key1, key2, key3, key4, key5, key6]
+    uint8_t keyReport[8] = { modifiers, 0, key1, 0, 0, 0, 0, 0 };
+    queueStep(delayMs, REPORT_KEYBOARD, keyReport, sizeof(keyReport));
+}
+
+void KeyboardHandler::queueConsumer(uint16_t delayMs, uint8_t consumerBits) {
+    queueStep(delayMs, REPORT_CONSUMER, &consumerBits, 1);
+}
+
+void KeyboardHandler::queueHeadset(uint16_t delayMs, ScheduledReportType type, uint8_t pulseBits) {
+    queueStep(delayMs, type, &pulseBits, 1);
+}
+
+void KeyboardHandler::queueGap(uint16_t delayMs) {
+    // Pad the timeline without emitting anything
+    scheduleCursor += delayMs;
+}
+
+void KeyboardHandler::queueKeyTap(uint8_t modifiers, uint8_t key, uint16_t holdTime) {
+    if (!beginSequence(2)) return;
+    queueKeys(0, modifiers, key);
+    queueKeys(holdTime);  // Release all keys
+}
+
+void KeyboardHandler::queueConsumerTap(uint8_t consumerBits, uint16_t holdTime) {
+    if (!beginSequence(2)) return;
+    queueConsumer(0, consumerBits);
+    queueConsumer(holdTime, 0x00);  // Release (all bits clear)
+}
+
+void KeyboardHandler::queueConsumerSteps(uint8_t consumerBits, uint8_t steps) {
+    // Volume usages are one-shot controls: the host counts press edges, so a
+    // burst needs no hold time, just enough spacing for each report to get
+    // its own connection event. Steps beyond the free queue space are dropped
+    // rather than the whole burst.
+    uint8_t room = (KEY_SCHEDULER_QUEUE_SIZE - queueCount) / 2;
+    if (steps > room) {
+        reportsDropped += (uint32_t)(steps - room) * 2;
+        steps = room;
+    }
+    if (steps == 0) return;
+    
+    // A burst queued behind another keeps the spacing across the seam
+    uint16_t firstDelay = (queueCount > 0) ? VOLUME_STEP_INTERVAL : 0;
+    if (!beginSequence(steps * 2)) return;
+    for (uint8_t i = 0; i < steps; i++) {
+        queueConsumer(i == 0 ? firstDelay : VOLUME_STEP_INTERVAL, consumerBits);
+        queueConsumer(VOLUME_STEP_INTERVAL, 0x00);  // Release (all bits clear)
+    }
+}
+
+void KeyboardHandler::resetStats() {
+    reportsSent = 0;
+    reportsDropped = 0;
+    latencyStats.reset();
+}
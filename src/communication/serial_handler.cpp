@@ -1,6 +1,13 @@
 #include "communication/serial_handler.h"
 #include "hardware/touch_sensor.h"
 #include "hardware/led_strip.h"
+#include "communication/keyboard_handler.h"
+#include "core/device_controller.h"
+#include "core/input_queue.h"
+#include "core/profiler.h"
+#include "core/event_trace.h"
+#include "communication/bluetooth_handler.h"
+#include "communication/touch_telemetry.h"
 #include "config.h"
 
 // Singleton instance
@@ -11,6 +18,11 @@ SerialHandler& getSerialHandler() {
 
 void SerialHandler::begin(unsigned long baudRate) {
     Serial.begin(baudRate);
+    
+    // Wake the input task when command bytes arrive instead of polling
+    Serial.onReceive([]() {
+        getInputQueue().push(INPUT_SOURCE_SERIAL, 0);
+    });
     // Print available serial commands
     printHelpMessage();
 }
@@ -30,8 +42,9 @@ void SerialHandler::update() {
             commandBuffer += incomingChar;
         }
         
-        // Fallback for single character commands
-        if (commandBuffer.length() == 1 && (incomingChar == 'c' || incomingChar == 'h')) {
+        // Fallback for single character commands; with several pads 'c' takes a pad number
+        bool singleCalibrate = incomingChar == 'c' && getTouchSensor().getPadCount() <= 1;
+        if (commandBuffer.length() == 1 && (singleCalibrate || incomingChar == 'h')) {
             processCommand(incomingChar);
             commandBuffer = "";
         }
@@ -85,9 +98,25 @@ void SerialHandler::processCommandString(const String& command) {
             break;
         }
         
-        case 'c':
-            LOG_INFO("Serial command 'c' received: Starting touch sensor calibration");
-            getTouchSensor().startCalibration();
+        case 'c': {
+            // Calibrate a touch pad: c or c<pad>
+            int pad = (command.length() > 1) ? command.substring(1).toInt() : 0;
+            LOG_INFO("Serial command 'c' received: Starting calibration of touch pad %d", pad);
+            getTouchSensor().startCalibration(pad);
+            break;
+        }
+            
+        case 'd':
+            // Event trace: d to dump, d1 to clear and restart, d0 to stop (keeps the events)
+            if (command.length() > 1 && command.charAt(1) == '1') {
+                getEventTrace().start();
+                Serial.println("Event trace cleared and started");
+            } else if (command.length() > 1 && command.charAt(1) == '0') {
+                getEventTrace().stop();
+                Serial.println("Event trace stopped");
+            } else {
+                printTrace();
+            }
             break;
             
         case 'h':
@@ -96,6 +125,77 @@ void SerialHandler::processCommandString(const String& command) {
             printLedStatus();
             break;
             
+        case 'l': {
+            // LED transport benchmark: l or l<frames>
+            int frames = (command.length() > 1) ? command.substring(1).toInt() : 100;
+            if (frames <= 0 || frames > 10000) frames = 100;
+            printLedBenchmark(frames);
+            break;
+        }
+            
+        case 'i':
+            // Input pipeline stats: i to show, i0 to reset
+            if (command.length() > 1 && command.charAt(1) == '0') {
+                if (DeviceController::getInstance()) {
+                    DeviceController::getInstance()->resetInputStats();
+                }
+                getBLEHandler().resetReportStats();
+                Serial.println("Input pipeline stats reset");
+            } else {
+                printInputStatus();
+            }
+            break;
+            
+        case 'k':
+            // Keystroke scheduler stats: k to show, k0 to reset
+            if (command.length() > 1 && command.charAt(1) == '0') {
+                getKeyboardHandler().resetStats();
+                Serial.println("Keystroke scheduler stats reset");
+            } else {
+                printKeyboardStatus();
+            }
+            break;
+            
+        case 'p':
+            // Loop profiling: p1 to (re)start, p0 to stop, p to show
+            if (command.length() > 1 && command.charAt(1) == '1') {
+                getProfiler().start();
+                Serial.println("Profiling started");
+            } else if (command.length() > 1 && command.charAt(1) == '0') {
+                getProfiler().stop();
+                Serial.println("Profiling stopped");
+            } else {
+                printProfile();
+            }
+            break;
+            
+        case 't':
+            // Binary touch telemetry: t1 to start, t0 to stop, t for stats
+            if (command.length() > 1 && command.charAt(1) == '1') {
+                getTouchTelemetry().start();
+            } else if (command.length() > 1 && command.charAt(1) == '0') {
+                getTouchTelemetry().stop();
+            } else {
+                Serial.printf("Touch telemetry: %s, %u frames sent, %u dropped\n",
+                              getTouchTelemetry().isStreaming() ? "streaming" : "off",
+                              getTouchTelemetry().getFramesSent(), getTouchTelemetry().getFramesDropped());
+            }
+            break;
+            
+        case 'v': {
+            // Log level: v<0-5> to set (up to the compiled-in LOG_LEVEL), v for stats
+            if (command.length() > 1) {
+                int level = command.substring(1).toInt();
+                if (level < LOG_LEVEL_NONE) level = LOG_LEVEL_NONE;
+                if (level > LOG_LEVEL) level = LOG_LEVEL;
+                getLogger().setLevel(level);
+            }
+            Serial.printf("Log level %u (compiled %u): %lu records written, %lu dropped\n",
+                          getLogger().getLevel(), LOG_LEVEL,
+                          (unsigned long)getLogger().getWritten(), (unsigned long)getLogger().getDropped());
+            break;
+        }
+            
         default:
             Serial.print("Unknown command: ");
             Serial.println(command);
@@ -106,27 +206,36 @@ void SerialHandler::processCommandString(const String& command) {
 
 void SerialHandler::printHelpMessage() {
   Serial.println("------ Available Serial Commands ------");
-  Serial.println("c - Start touch sensor calibration");
+  Serial.println("c[pad] - Start touch sensor calibration (pad 0 if omitted)");
   Serial.println("h - Display this help message");
+  Serial.println("d - Dump the event trace (d1 to clear and restart, d0 to stop)");
   Serial.println("b[0-255] - Set LED brightness (e.g., b255, b128, b0)");
   Serial.println("b - Show current LED brightness");
+  Serial.println("l[frames] - Benchmark LED transports (CPU time per frame)");
+  Serial.println("i - Show input event and edge-to-report latency (i0 to reset)");
+  Serial.println("k - Show keystroke scheduler latency (k0 to reset)");
+  Serial.println("p1/p0 - Start (clearing stats)/stop loop profiling (p to show)");
+  Serial.println("t1/t0 - Start/stop binary touch telemetry (t for stats)");
+  Serial.println("v[0-5] - Set log level, 0 off to 5 verbose (v for stats)");
   Serial.println("------------------------------------");
 }
 
 void SerialHandler::printTouchSensorStatus() {
   Serial.println("------ Touch Sensor Status ------");
-  Serial.print("Calibrated: ");
-  Serial.println(getTouchSensor().isCalibrated() ? "YES" : "NO");
+  TouchSensor& touch = getTouchSensor();
   
-  if (getTouchSensor().isCalibrated()) {
-    Serial.print("Untouched value: ");
-    Serial.println(getTouchSensor().getUntouchedValue());
-    Serial.print("Touched value: ");
-    Serial.println(getTouchSensor().getTouchedValue());
-    Serial.print("Threshold: ");
-    Serial.println(getTouchSensor().getThreshold());
-    Serial.print("Current raw value: ");
-    Serial.println(getTouchSensor().getRawValue());
+  for (uint8_t pad = 0; pad < touch.getPadCount(); pad++) {
+    Serial.printf("Pad %d (GPIO %d, %s): calibrated %s\n", pad, touch.getPadPin(pad),
+                  touch.getPadAction(pad) == TOUCH_ACTION_PUSH_TO_TALK ? "push-to-talk" : "mute",
+                  touch.isCalibrated(pad) ? "YES" : "NO");
+    
+    if (touch.isCalibrated(pad)) {
+      Serial.printf("  Untouched value: %d (noise %d)\n", touch.getUntouchedValue(pad), touch.getUntouchedNoise(pad));
+      Serial.printf("  Touched value: %d (noise %d)\n", touch.getTouchedValue(pad), touch.getTouchedNoise(pad));
+      Serial.printf("  Threshold: %d\n", touch.getThreshold(pad));
+      Serial.printf("  Baseline: %d, filtered: %d\n", touch.getBaseline(pad), touch.getFilteredValue(pad));
+      Serial.printf("  Current raw value: %d\n", touch.getRawValue(pad));
+    }
   }
   
   Serial.println("-------------------------------");
@@ -137,5 +246,167 @@ void SerialHandler::printLedStatus() {
   Serial.print("Current brightness: ");
   Serial.print(getLedStrip().getBrightness());
   Serial.println("/255");
+  Serial.print("Transport: ");
+  Serial.println(getLedStrip().getTransport()->getName());
+  Serial.printf("Frames pushed/requested: %lu/%lu\n",
+                (unsigned long)getLedStrip().getFramesPushed(),
+                (unsigned long)getLedStrip().getFramesRequested());
+  Serial.println("-------------------------------");
+}
+
+void SerialHandler::printKeyboardStatus() {
+  const LatencyHistogram& stats = getKeyboardHandler().getLatencyStats();
+  Serial.println("------ Keystroke Scheduler ------");
+  Serial.printf("Queued steps: %u/%u\n", getKeyboardHandler().getQueueDepth(), KEY_SCHEDULER_QUEUE_SIZE);
+  Serial.printf("Reports sent: %lu, dropped: %lu\n",
+                (unsigned long)getKeyboardHandler().getReportsSent(),
+                (unsigned long)getKeyboardHandler().getReportsDropped());
+  Serial.printf("Input-to-report latency (us, n=%lu): min %lu, p50 %lu, p99 %lu, max %lu\n",
+                (unsigned long)stats.getCount(),
+                (unsigned long)stats.getMin(),
+                (unsigned long)stats.getPercentile(50),
+                (unsigned long)stats.getPercentile(99),
+                (unsigned long)stats.getMax());
+  Serial.println("-------------------------------");
+}
+
+void SerialHandler::printLedBenchmark(uint16_t frames) {
+  Serial.println("------ LED Transport Benchmark ------");
+  Serial.printf("Frames: %u, pixels: %u\n", frames, LED_NUM_PIXELS);
+  
+  // Transport 0 is the active default; compare every other one against it
+  uint32_t baseline = getLedStrip().benchmarkTransport(&hal::getLedTransport(0), frames);
+  Serial.printf("%s: %lu us CPU/frame\n", hal::getLedTransport(0).getName(), (unsigned long)baseline);
+  
+  for (uint8_t i = 1; i < hal::getLedTransportCount(); i++) {
+    LedTransport& transport = hal::getLedTransport(i);
+    uint32_t frameTime = getLedStrip().benchmarkTransport(&transport, frames);
+    Serial.printf("%s: %lu us CPU/frame", transport.getName(), (unsigned long)frameTime);
+    if (baseline > 0) {
+      Serial.printf(" (%lu.%02lux of %s)",
+                    (unsigned long)(frameTime / baseline),
+                    (unsigned long)((frameTime * 100 / baseline) % 100),
+                    hal::getLedTransport(0).getName());
+    }
+    Serial.println();
+  }
+  Serial.println("-------------------------------");
+}
+
+void SerialHandler::printInputStatus() {
+  DeviceController* controller = DeviceController::getInstance();
+  if (!controller) return;
+  
+  const LatencyHistogram& stats = controller->getReportLatency();
+  Serial.println("------ Input Pipeline ------");
+  Serial.printf("Events processed: %lu, dropped: %lu\n",
+                (unsigned long)controller->getEventsProcessed(),
+                (unsigned long)getInputQueue().getDropped());
+  Serial.printf("Host events dropped: %lu, transmit events dropped: %lu\n",
+                (unsigned long)getBLEHandler().getDroppedHostEvents(),
+                (unsigned long)getBLEHandler().getDroppedTxEvents());
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    const HostConnection& host = getBLEHandler().getHost(i);
+    if (!host.connected) continue;
+    Serial.printf("Host conn %d: call %s, %s, interval %u.%02u ms, latency %u (%s link), %u queued%s%s\n", host.connId,
+                  host.callActive ? "active" : "idle",
+                  host.muteState ? "muted" : "unmuted",
+                  host.interval * 125 / 100, host.interval * 125 % 100, host.latency,
+                  host.profile == HID_LINK_FAST ? "fast" : "idle",
+                  getBLEHandler().getQueuedReports(i),
+                  getBLEHandler().isCongested(i) ? ", congested" : "",
+                  host.connId == getBLEHandler().getInputHost() ? " (keystrokes)" : "");
+  }
+  static const char* const channelNames[HID_CHANNEL_COUNT] = { "Headset", "Keyboard", "Consumer" };
+  for (uint8_t c = 0; c < HID_CHANNEL_COUNT; c++) {
+    HidChannel channel = (HidChannel)c;
+    Serial.printf("%s notifications: sent %lu, elided %lu, collapsed %lu, retried %lu, dropped %lu%s\n", channelNames[c],
+                  (unsigned long)getBLEHandler().getReportsSent(channel),
+                  (unsigned long)getBLEHandler().getReportsElided(channel),
+                  (unsigned long)getBLEHandler().getReportsCollapsed(channel),
+                  (unsigned long)getBLEHandler().getReportsRetried(channel),
+                  (unsigned long)getBLEHandler().getReportsDropped(channel),
+                  getBLEHandler().isDelivered(channel) ? "" : " (undelivered)");
+  }
+  Serial.printf("Edge-to-headset-confirm latency (us, n=%lu): min %lu, p50 %lu, p99 %lu, max %lu\n",
+                (unsigned long)stats.getCount(),
+                (unsigned long)stats.getMin(),
+                (unsigned long)stats.getPercentile(50),
+                (unsigned long)stats.getPercentile(99),
+                (unsigned long)stats.getMax());
+  Serial.printf("Headset report failures: %lu\n", (unsigned long)controller->getReportFailures());
+  Serial.println("-------------------------------");
+}
+
+// Hundredths of a microsecond as microseconds with two decimals
+static void printCentis(const char* label, uint32_t centis) {
+  Serial.printf(" %s %lu.%02lu", label, (unsigned long)(centis / 100), (unsigned long)(centis % 100));
+}
+
+void SerialHandler::printProfile() {
+  Profiler& profiler = getProfiler();
+  uint32_t elapsed = profiler.getElapsedMicros();
+  
+  Serial.println("------ Loop Profile ------");
+  Serial.printf("Profiling %s: %lu passes in %lu ms, %lu over the %u us budget\n",
+                profiler.isEnabled() ? "on" : "off",
+                (unsigned long)profiler.getPasses(), (unsigned long)(elapsed / 1000),
+                (unsigned long)profiler.getOverruns(), PROFILE_PASS_BUDGET);
+  
+  for (uint8_t i = 0; i < PROFILE_SECTION_COUNT; i++) {
+    const LatencyHistogram& stats = profiler.getSection((ProfileSection)i);
+    if (stats.getCount() == 0) continue;
+    Serial.printf("%s (us, n=%lu):", Profiler::getSectionName((ProfileSection)i), (unsigned long)stats.getCount());
+    printCentis("mean", stats.getMean());
+    printCentis("p50", stats.getPercentile(50));
+    printCentis("p99", stats.getPercentile(99));
+    printCentis("max", stats.getMax());
+    Serial.println();
+  }
+  
+  const LatencyHistogram& period = profiler.getPeriod();
+  Serial.printf("Pass period (us, n=%lu): min %lu, p50 %lu, p99 %lu, max %lu\n",
+                (unsigned long)period.getCount(),
+                (unsigned long)period.getMin(),
+                (unsigned long)period.getPercentile(50),
+                (unsigned long)period.getPercentile(99),
+                (unsigned long)period.getMax());
+  const LatencyHistogram& lateness = profiler.getLateness();
+  Serial.printf("Deadline wake lateness (us, n=%lu): mean %lu, p50 %lu, p99 %lu, max %lu\n",
+                (unsigned long)lateness.getCount(),
+                (unsigned long)lateness.getMean(),
+                (unsigned long)lateness.getPercentile(50),
+                (unsigned long)lateness.getPercentile(99),
+                (unsigned long)lateness.getMax());
+  
+  Serial.print("CPU share:");
+  for (uint8_t i = 0; i < PROFILE_TASK_COUNT; i++) {
+    uint32_t share = elapsed ? (uint64_t)profiler.getBusyMicros((ProfileTask)i) * 10000 / elapsed : 0;
+    Serial.printf(" %s %lu.%02lu%%", Profiler::getTaskName((ProfileTask)i),
+                  (unsigned long)(share / 100), (unsigned long)(share % 100));
+  }
+  Serial.println();
+  Serial.println("-------------------------------");
+}
+
+void SerialHandler::printTrace() {
+  EventTrace& trace = getEventTrace();
+  
+  // Events recorded while dumping may overwrite the oldest ones; those are skipped
+  uint32_t end = trace.getRecorded();
+  uint32_t oldest = trace.getOldest();
+  uint32_t lost = 0;
+  Serial.println("------ Event Trace ------");
+  for (uint32_t pos = oldest; pos != end; pos++) {
+    TraceEvent event;
+    if (!trace.read(pos, event)) {
+      lost++;
+      continue;
+    }
+    Serial.printf("trace %lu %s %u %u %u\n", (unsigned long)event.time,
+                  EventTrace::getTypeName(event.type), event.a, event.b, event.c);
+  }
+  Serial.printf("Events: %lu recorded, %lu overwritten, %lu lost while dumping, tracing %s\n",
+                (unsigned long)end, (unsigned long)oldest, (unsigned long)lost, trace.isEnabled() ? "on" : "stopped");
   Serial.println("-------------------------------");
 }
@@ -0,0 +1,206 @@
+#include "communication/touch_telemetry.h"
+#include "hardware/touch_sensor.h"
+#include "hal/clock.h"
+#include "hal/task.h"
+#include "hal/touch.h"
+#include "core/profiler.h"
+#include "config.h"
+
+// Largest encoding of one sample: time delta, bitmap and three values per pad
+#define SAMPLE_MAX_BYTES(pads) (5 + 3 + (pads) * 3 * 5)
+
+// Singleton instance
+TouchTelemetry& getTouchTelemetry() {
+    static TouchTelemetry instance;
+    return instance;
+}
+
+TouchTelemetry::TouchTelemetry()
+    : streaming(false),
+      taskActive(false),
+      taskless(false),
+      length(0),
+      sampleCount(0),
+      sequence(0),
+      framesUntilKeyframe(0),
+      keyframe(true),
+      lastSampleMicros(0),
+      lastSampleMillis(0),
+      framesSent(0),
+      framesDropped(0) {
+    memset(previous, 0, sizeof(previous));
+}
+
+void TouchTelemetry::start() {
+    if (streaming) return;
+    streaming = true;
+
+    // A task still winding down after stop() sees the flag and carries on
+    if (taskless || !taskActive.exchange(true)) {
+        // Readers need absolute values to start decoding
+        keyframe = true;
+        framesUntilKeyframe = 0;
+        sampleCount = 0;
+        lastSampleMillis = millis();
+
+        if (!taskless && !hal::createTask(telemetryTask, "telemetry", TOUCH_TELEMETRY_TASK_STACK, this,
+                                          TOUCH_TELEMETRY_TASK_PRIORITY, INPUT_TASK_CORE)) {
+            // Sample from the input task instead
+            taskActive = false;
+            taskless = true;
+        }
+    }
+    LOG_INFO("Touch telemetry started");
+}
+
+void TouchTelemetry::stop() {
+    if (!streaming) return;
+    streaming = false;
+
+    // The task sends its partial frame itself on the way out
+    if (taskless && sampleCount > 0) {
+        flush();
+    }
+    LOG_INFO("Touch telemetry stopped: %u frames sent, %u dropped", framesSent, framesDropped);
+}
+
+void TouchTelemetry::telemetryTask(void* arg) {
+    TouchTelemetry* self = static_cast<TouchTelemetry*>(arg);
+
+    while (true) {
+        while (self->streaming) {
+            uint32_t busy = getProfiler().busyStart();
+            self->sample();
+            getProfiler().busyEnd(PROFILE_TASK_TELEMETRY, busy);
+            hal::delayMs(TOUCH_TELEMETRY_INTERVAL);
+        }
+        if (self->sampleCount > 0) {
+            self->flush();
+        }
+
+        // Hand over; keep going if start() came back before it could see us leave
+        self->taskActive = false;
+        if (!self->streaming || self->taskActive.exchange(true)) break;
+    }
+    hal::endTask();
+}
+
+void TouchTelemetry::update() {
+    if (!streaming || !taskless) return;
+    if (millis() - lastSampleMillis < TOUCH_TELEMETRY_INTERVAL) return;
+    lastSampleMillis = millis();
+    sample();
+}
+
+uint32_t TouchTelemetry::getTimeUntilNextSample() const {
+    if (!streaming || !taskless) return UINT32_MAX;
+    unsigned long sinceSample = millis() - lastSampleMillis;
+    return sinceSample >= TOUCH_TELEMETRY_INTERVAL ? 0 : TOUCH_TELEMETRY_INTERVAL - sinceSample;
+}
+
+void TouchTelemetry::sample() {
+    TouchSensor& touch = getTouchSensor();
+    uint8_t padCount = touch.getPadCount();
+    uint32_t now = micros();
+
+    if (sampleCount == 0) {
+        beginFrame(now, padCount);
+    } else {
+        putVarint(now - lastSampleMicros);
+    }
+    lastSampleMicros = now;
+
+    uint32_t touched = 0;
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        if (touch.isTouched(pad)) touched |= 1UL << pad;
+    }
+    putVarint(touched);
+
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        uint8_t pin = touch.getPadPin(pad);
+        int32_t values[3];
+        values[0] = hal::touchReadRaw(pin);
+#if TOUCH_HW_FSM
+        // Fresh from the peripheral rather than as of the sensor's last sweep
+        values[1] = hal::touchReadSmoothed(pin);
+        values[2] = hal::touchReadBenchmark(pin);
+#else
+        values[1] = touch.getFilteredValue(pad);
+        values[2] = touch.getBaseline(pad);
+#endif
+        for (uint8_t i = 0; i < 3; i++) {
+            putSigned(values[i] - previous[pad][i]);
+            previous[pad][i] = values[i];
+        }
+    }
+    sampleCount++;
+
+    if (sampleCount >= TOUCH_TELEMETRY_BATCH ||
+        length + SAMPLE_MAX_BYTES(padCount) + 1 > TOUCH_TELEMETRY_FRAME_MAX) {
+        flush();
+    }
+}
+
+void TouchTelemetry::beginFrame(uint32_t now, uint8_t padCount) {
+    if (framesUntilKeyframe == 0) {
+        keyframe = true;
+    }
+    if (keyframe) {
+        memset(previous, 0, sizeof(previous));
+        framesUntilKeyframe = TOUCH_TELEMETRY_KEYFRAME;
+    }
+    framesUntilKeyframe--;
+
+    frame[0] = TOUCH_TELEMETRY_MAGIC;
+    frame[1] = keyframe ? TOUCH_TELEMETRY_KEYFRAME_FLAG : 0;
+#if TOUCH_HW_FSM
+    frame[1] |= TOUCH_TELEMETRY_HARDWARE_FLAG;
+#endif
+    length = TOUCH_TELEMETRY_HEADER;
+    frame[length++] = sequence & 0xFF;
+    frame[length++] = sequence >> 8;
+    frame[length++] = padCount;
+    frame[length++] = 0;  // sample count, filled in by flush()
+    for (uint8_t shift = 0; shift < 32; shift += 8) {
+        frame[length++] = (now >> shift) & 0xFF;
+    }
+}
+
+void TouchTelemetry::flush() {
+    uint16_t payloadLength = length - TOUCH_TELEMETRY_HEADER;
+    frame[2] = payloadLength & 0xFF;
+    frame[3] = payloadLength >> 8;
+    frame[TOUCH_TELEMETRY_HEADER + 3] = sampleCount;
+
+    uint8_t checksum = 0;
+    for (uint16_t i = TOUCH_TELEMETRY_HEADER; i < length; i++) {
+        checksum ^= frame[i];
+    }
+    frame[length++] = checksum;
+
+    // Never block on the serial port: drop the frame and restart the delta chain
+    if (Serial.availableForWrite() >= length) {
+        Serial.write(frame, length);
+        framesSent++;
+        keyframe = false;
+    } else {
+        framesDropped++;
+        keyframe = true;
+    }
+
+    sequence++;
+    sampleCount = 0;
+}
+
+void TouchTelemetry::putVarint(uint32_t value) {
+    while (value >= 0x80) {
+        frame[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    frame[length++] = value;
+}
+
+void TouchTelemetry::putSigned(int32_t value) {
+    // Zigzag: small magnitudes of either sign stay small
+    putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
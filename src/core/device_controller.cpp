@@ -2,10 +2,17 @@
 #include "communication/bluetooth_handler.h"
 #include "communication/serial_handler.h"
 #include "communication/keyboard_handler.h"
+#include "communication/touch_telemetry.h"
 #include "hardware/led_strip.h"
+#include "hardware/led_animator.h"
 #include "hardware/touch_sensor.h"
 #include "hardware/rotary_encoder.h"
+#include "core/input_queue.h"
+#include "core/profiler.h"
+#include "core/event_trace.h"
+#include "hal/task.h"
 #include "config.h"
+#include "hidmap.h"
 
 // Initialize static instance pointer
 DeviceController* DeviceController::instance = nullptr;
@@ -23,35 +30,160 @@ DeviceController::DeviceController()
 }
 
 void DeviceController::begin() {
+    // The queue must exist before any interrupt is attached
+    getInputQueue().begin();
+    
     // Initialize all components
     getSerialHandler().begin(115200);
+    getLogger().begin();
+    leftButton.begin();
+    rightButton.begin();
     getLedStrip().begin(LED_BRIGHTNESS);
+    getTouchSensor().addPad(TOUCH_MUTE_PIN, TOUCH_ACTION_MUTE);
+    if (TOUCH_PTT_PIN) {
+        getTouchSensor().addPad(TOUCH_PTT_PIN, TOUCH_ACTION_PUSH_TO_TALK);
+    }
     getTouchSensor().begin();
     getTouchSensor().setCallback(staticTouchCallback);
     getRotaryEncoder().begin();
     getRotaryEncoder().setCallback(staticEncoderCallback);
     getRotaryEncoder().getClickButton().setCallback(staticEncoderButtonCallback);
+    getKeyboardHandler().setHeadsetStateCallback(staticHeadsetState);
+    getBLEHandler().setDeliveryCallback(staticDeliveryCallback);
     getBLEHandler().begin();
-    
-    // Register callback for host state updates from Bluetooth
-    getBLEHandler().setHostStateCallback(staticHostStateCallback);
 }
 
 void DeviceController::update() {
-    leftButton.update();
-    rightButton.update();
+    // Each lap() times the component that ran since the previous mark
+    Profiler& profiler = getProfiler();
+    uint32_t mark = profiler.mark();
+    
+    // Host updates first, so input below acts on the latest call state
+    processHostEvents();
+    mark = profiler.lap(PROFILE_HOST_EVENTS, mark);
+    
+    Button::updateAll();  // left, right and encoder click
+    mark = profiler.lap(PROFILE_BUTTONS, mark);
     getTouchSensor().update();
+    mark = profiler.lap(PROFILE_TOUCH, mark);
     getRotaryEncoder().update();
+    mark = profiler.lap(PROFILE_ENCODER, mark);
     getSerialHandler().update();
+    mark = profiler.lap(PROFILE_SERIAL, mark);
+    getTouchTelemetry().update();
+    mark = profiler.lap(PROFILE_TELEMETRY, mark);
+    
+    // Emit any keystrokes that came due, including ones queued above
+    getKeyboardHandler().update();
+    mark = profiler.lap(PROFILE_KEYBOARD, mark);
+    getBLEHandler().update();  // held telephony state whose link came free
+    mark = profiler.lap(PROFILE_BLE, mark);
+    getLedAnimator().update();
+    mark = profiler.lap(PROFILE_LED_ANIMATOR, mark);
+    
+    // Push at most one LED frame per pass, after every component had its say
+    getLedStrip().update();
+    profiler.lap(PROFILE_LED_STRIP, mark);
+}
+
+void DeviceController::startInputTask() {
+    hal::createTask(inputTask, "input", INPUT_TASK_STACK, this, INPUT_TASK_PRIORITY, INPUT_TASK_CORE);
+}
+
+void DeviceController::inputTask(void* pvParameters) {
+    static_cast<DeviceController*>(pvParameters)->run();
+}
+
+void DeviceController::run() {
+    while (true) {
+        step(nextWakeTimeout());
+    }
+}
+
+void DeviceController::step(uint32_t timeoutMs) {
+    InputEvent event;
+    bool woken = getInputQueue().wait(event, timeoutMs);
+    getProfiler().beginPass(!woken, timeoutMs);
+    if (woken) {
+        getEventTrace().record(TRACE_WAKE, event.source, event.pin);
+        // Handle everything that piled up in one pass, timed from the oldest
+        // edge; host and serial wakes carry no edge to time a report from
+        do {
+            bool edge = (event.source != INPUT_SOURCE_HOST && event.source != INPUT_SOURCE_SERIAL);
+            if (edge && pendingEventTime == 0) {
+                pendingEventTime = event.timestamp ? event.timestamp : 1;
+            }
+            eventsProcessed++;
+        } while (getInputQueue().wait(event, 0));
+    }
+    
+    update();
+    getProfiler().endPass();
+    pendingEventTime = 0;
+    getKeyboardHandler().setInputTime(0);
+}
+
+uint32_t DeviceController::nextWakeTimeout() {
+    uint32_t timeout = getKeyboardHandler().getTimeUntilNextReport();
+    
+    // Debounce and gesture windows end at known times
+    timeout = min(timeout, Button::getTimeUntilAnyEvent());
+    
+    // Telephony state held back until its link's next connection event
+    timeout = min(timeout, getBLEHandler().getTimeUntilNextFlush());
+    
+    // Touch filter sampling, fast while a touch is in progress
+    timeout = min(timeout, getTouchSensor().getTimeUntilNextSample());
+    
+    // Telemetry only lands here when it has no task of its own
+    timeout = min(timeout, getTouchTelemetry().getTimeUntilNextSample());
+    
+    if (getLedAnimator().isRunning()) {
+        timeout = min(timeout, (uint32_t)LED_FRAME_INTERVAL);
+    }
+    
+    // Nothing pending: sleep until the next interrupt
+    return (timeout == UINT32_MAX) ? INPUT_WAIT_FOREVER : timeout;
 }
 
 void DeviceController::updateCallState(bool muteValue, bool dropValue) {
-    uint8_t reportValue = (muteValue ? 0x01 : 0x00) | (dropValue ? 0x02 : 0x00);
+    // A drop pulse still being held stays in the report
+    uint8_t reportValue = (muteValue ? HEADSET_MUTE : 0) | (dropValue ? HEADSET_DROP : 0);
+    reportValue |= getKeyboardHandler().getHeldHeadsetBits();
+    getEventTrace().record(TRACE_CALL_STATE, reportValue, callActive);
+    
+    // A newer report supersedes whatever confirm was awaited
+    awaitedEventTime = 0;
+    if (!getBLEHandler().sendHeadsetReport(reportValue)) {
+        reportFailures++;
+        return;
+    }
+    LOG_DEBUG("Call %s: %s queued",
+          callActive ? "Active" : "Idle",
+          muteValue ? "Muted" : "Unmuted");
     
-    if (getBLEHandler().sendHeadsetReport(reportValue)) {
-        LOG_DEBUG("Call %s: %s", 
-              callActive ? "Active" : "Idle",
-              muteValue ? "Muted" : "Unmuted");
+    // Latency runs until a host confirms; a report every host already has is done now
+    if (pendingEventTime != 0) {
+        if (getBLEHandler().isDelivered(HID_CHANNEL_HEADSET)) {
+            reportLatency.record(micros() - pendingEventTime);
+        } else {
+            awaitedReport = reportValue;
+            awaitedEventTime = pendingEventTime;
+        }
+    }
+}
+
+void DeviceController::onReportDelivered(HidChannel channel, uint16_t connId, uint8_t firstByte, bool delivered) {
+    if (channel != HID_CHANNEL_HEADSET) return;
+    if (!delivered) {
+        // Retried at the next connection event; counted so a lossy link shows up
+        reportFailures++;
+        LOG_DEBUG("Headset report %02X to conn %d failed, retrying", firstByte, connId);
+        return;
+    }
+    if (awaitedEventTime != 0 && firstByte == awaitedReport) {
+        reportLatency.record(micros() - awaitedEventTime);
+        awaitedEventTime = 0;
     }
 }
 
@@ -68,9 +200,8 @@ void DeviceController::onLeftButtonEvent(ButtonEvent event) {
     } else if (event == BUTTON_LONG_PRESSED) {
         // Send hang up/drop call command
         LOG_INFO("Left button long pressed: Sending hang up/drop call command");
-        updateCallState(muteState, true);
-        delay(100);    // Small delay to ensure the signal is registered
-        updateCallState(muteState, false);
+        // Hold the drop bit briefly to ensure the signal is registered
+        getKeyboardHandler().sendHeadsetPulse(HEADSET_DROP, 100);
     }
 }
 
@@ -99,26 +230,10 @@ void DeviceController::onEncoderButtonEvent(ButtonEvent event) {
             LOG_INFO("Encoder clicked - Switched to %s mode", 
                      encoderVolumeMode ? "Volume Control" : "Arrow Keys");
             
-            // Flash LED to indicate mode change
-            if (encoderVolumeMode) {
-                // Green flash for Volume Control mode
-                getLedStrip().setColor(getLedStrip().colorGreen());
-                delay(150);
-                getLedStrip().clear();
-                delay(150);
-                getLedStrip().setColor(getLedStrip().colorGreen());
-                delay(150);
-                getLedStrip().clear();
-            } else {
-                // Orange flash for Arrow Keys mode
-                getLedStrip().setColor(255, 165, 0); // Orange
-                delay(150);
-                getLedStrip().clear();
-                delay(150);
-                getLedStrip().setColor(255, 165, 0);
-                delay(150);
-                getLedStrip().clear();
-            }
+            // Flash LED to indicate mode change: green for Volume Control, orange for Arrow Keys
+            getLedAnimator().flash(
+                encoderVolumeMode ? getLedStrip().colorGreen() : getLedStrip().color(255, 165, 0),
+                2, 150, 150);
         } else {
             LOG_DEBUG("Encoder click ignored - call is active");
         }
@@ -129,27 +244,11 @@ void DeviceController::onEncoderButtonEvent(ButtonEvent event) {
         LOG_DEBUG("Encoder double clicked - Switched to %s mode", 
                   pushToTalkMode ? "Push-to-Talk" : "Toggle Mute");
         
-        // Flash LED to indicate mode change
-        if (pushToTalkMode) {
-            // Blue flash for Push-to-Talk mode
-            getLedStrip().setColor(getLedStrip().colorBlue());
-            delay(200);
-            getLedStrip().clear();
-            delay(200);
-            getLedStrip().setColor(getLedStrip().colorBlue());
-            delay(200);
-        } else {
-            // Purple flash for Toggle mode
-            getLedStrip().setColor(255, 0, 255);
-            delay(200);
-            getLedStrip().clear();
-            delay(200);
-            getLedStrip().setColor(255, 0, 255);
-            delay(200);
-        }
-        
-        // Restore LED state based on call and mute status
-        updateLedCallStatus();
+        // Flash LED to indicate mode change: blue for Push-to-Talk, purple for Toggle
+        // The call/mute status is restored once the flash finishes
+        getLedAnimator().flash(
+            pushToTalkMode ? getLedStrip().colorBlue() : getLedStrip().colorMagenta(),
+            2, 200, 200);
     }
     else if (event == BUTTON_LONG_PRESSED) {
         LOG_INFO("Encoder long pressed - Activating Bluetooth pairing mode");
@@ -158,19 +257,22 @@ void DeviceController::onEncoderButtonEvent(ButtonEvent event) {
         getBLEHandler().startAdvertising();
         
         // Flash blue LED to indicate pairing mode
-        for (int i = 0; i < 5; i++) {
-            getLedStrip().setColor(0, 0, 255); // Blue for BT pairing
-            delay(100);
-            getLedStrip().clear();
-            delay(100);
-        }
+        getLedAnimator().flash(getLedStrip().colorBlue(), 5, 100, 100);
     }
 }
 
 // --- Touch Event Handler ---
-void DeviceController::onTouchEvent(TouchEvent event) {
+void DeviceController::onTouchEvent(TouchEvent event, uint8_t pad) {
+    // The filter confirms a touch a few samples after its interrupt; time the report from the edge
+    if (pendingEventTime == 0) {
+        pendingEventTime = getTouchSensor().getEventTime();
+    }
+    
+    // A dedicated push-to-talk pad behaves as if push-to-talk mode were on
+    bool pushToTalk = pushToTalkMode || getTouchSensor().getPadAction(pad) == TOUCH_ACTION_PUSH_TO_TALK;
+    
     if (event == TOUCH_PRESSED) {
-        LOG_DEBUG("Touch sensor activated");
+        LOG_DEBUG("Touch pad %d activated", pad);
         touchPressed = true;
         
         // Only allow mute/unmute if there's an active call
@@ -179,7 +281,7 @@ void DeviceController::onTouchEvent(TouchEvent event) {
             return;
         }
         
-        if (pushToTalkMode) {
+        if (pushToTalk) {
             // In push-to-talk mode, unmute only while touching
             if (muteState) {
                 muteState = false;
@@ -204,8 +306,8 @@ void DeviceController::onTouchEvent(TouchEvent event) {
         }
     }
     else if (event == TOUCH_RELEASED) {
-        LOG_DEBUG("Touch sensor released");
-        touchPressed = false;
+        LOG_DEBUG("Touch pad %d released", pad);
+        touchPressed = getTouchSensor().isAnyTouched();
         
         // Only allow mute/unmute if there's an active call
         if (!callActive) {
@@ -213,7 +315,7 @@ void DeviceController::onTouchEvent(TouchEvent event) {
             return;
         }
         
-        if (pushToTalkMode) {
+        if (pushToTalk) {
             // In push-to-talk mode, mute when released
             muteState = true;
             LOG_DEBUG("Push-to-talk: Muting on release");
@@ -228,40 +330,42 @@ void DeviceController::onTouchEvent(TouchEvent event) {
 }
 
 // --- Encoder Event Handler ---
-void DeviceController::onEncoderEvent(EncoderEvent event) {
+void DeviceController::onEncoderEvent(EncoderEvent event, uint8_t detents, uint8_t steps) {
     // Encoder behavior is the same whether in a call or not
     // Switch between volume control and arrow keys based on encoder mode
     if (encoderVolumeMode) {
-        // Volume control mode (inverted direction)
+        // Volume control mode (inverted direction), accelerated on fast spins
         switch (event) {
             case ENCODER_CLOCKWISE:
                 // Volume down (inverted)
-                LOG_DEBUG("Encoder rotated clockwise (volume mode): Volume Down");
-                getKeyboardHandler().sendVolumeDown();
+                LOG_DEBUG("Encoder rotated clockwise (volume mode): Volume Down x%d", steps);
+                getKeyboardHandler().sendVolumeDown(steps);
                 break;
             case ENCODER_COUNTER_CLOCKWISE:
                 // Volume up (inverted)
-                LOG_DEBUG("Encoder rotated counter-clockwise (volume mode): Volume Up");
-                getKeyboardHandler().sendVolumeUp();
+                LOG_DEBUG("Encoder rotated counter-clockwise (volume mode): Volume Up x%d", steps);
+                getKeyboardHandler().sendVolumeUp(steps);
                 break;
             default:
                 break;
         }
     } else {
-        // Arrow key mode
-        switch (event) {
-            case ENCODER_CLOCKWISE:
-                // Left Arrow key
-                LOG_DEBUG("Encoder rotated clockwise (arrow mode): Sending Left Arrow");
-                getKeyboardHandler().sendLeftArrow();
-                break;
-            case ENCODER_COUNTER_CLOCKWISE:
-                // Right Arrow key
-                LOG_DEBUG("Encoder rotated counter-clockwise (arrow mode): Sending Right Arrow");
-                getKeyboardHandler().sendRightArrow();
-                break;
-            default:
-                break;
+        // Arrow key mode: one slide per detent, never accelerated
+        for (uint8_t i = 0; i < detents; i++) {
+            switch (event) {
+                case ENCODER_CLOCKWISE:
+                    // Left Arrow key
+                    LOG_DEBUG("Encoder rotated clockwise (arrow mode): Sending Left Arrow");
+                    getKeyboardHandler().sendLeftArrow();
+                    break;
+                case ENCODER_COUNTER_CLOCKWISE:
+                    // Right Arrow key
+                    LOG_DEBUG("Encoder rotated counter-clockwise (arrow mode): Sending Right Arrow");
+                    getKeyboardHandler().sendRightArrow();
+                    break;
+                default:
+                    break;
+            }
         }
     }
 }
@@ -269,19 +373,35 @@ void DeviceController::onEncoderEvent(EncoderEvent event) {
 void DeviceController::updateLedCallStatus() {
     // No call: LED OFF
     if (!callActive) {
-        getLedStrip().clear();
+        getLedAnimator().setBaseColor(0);
         return;
     }
     
     // Call active: RED if muted, GREEN if not
-    getLedStrip().setColor(
+    // A running mode/pairing flash keeps playing and then lands on this color
+    getLedAnimator().setBaseColor(
         muteState ?
         getLedStrip().colorRed() :
         getLedStrip().colorGreen()
     );
 }
 
+void DeviceController::processHostEvents() {
+    HostEvent event;
+    while (getBLEHandler().pollHostEvent(event)) {
+        switch (event.type) {
+            case HOST_STATE_UPDATE:
+                onHostStateUpdate(event.callActive, event.muteState);
+                break;
+            default:
+                break;  // link events never leave the BLE handler
+        }
+    }
+}
+
 void DeviceController::onHostStateUpdate(bool hostCallActive, bool hostMuteState) {
+    getEventTrace().record(TRACE_HOST_STATE, hostCallActive, hostMuteState);
+    
     // Update internal state based on host (computer) updates
     callActive = hostCallActive;
     muteState = hostMuteState;
@@ -297,38 +417,51 @@ void DeviceController::onHostStateUpdate(bool hostCallActive, bool hostMuteState
 // --- Static Callback Functions ---
 // These functions bridge the gap between C-style callbacks and instance methods
 
+// Keystrokes a handler queues are timed from the edge that decided the event
+
 void DeviceController::staticLeftButtonCallback(ButtonEvent event) {
     if (instance) {
+        getKeyboardHandler().setInputTime(instance->leftButton.getEventTime());
         instance->onLeftButtonEvent(event);
     }
 }
 
 void DeviceController::staticRightButtonCallback(ButtonEvent event) {
     if (instance) {
+        getKeyboardHandler().setInputTime(instance->rightButton.getEventTime());
         instance->onRightButtonEvent(event);
     }
 }
 
 void DeviceController::staticEncoderButtonCallback(ButtonEvent event) {
     if (instance) {
+        getKeyboardHandler().setInputTime(getRotaryEncoder().getClickButton().getEventTime());
         instance->onEncoderButtonEvent(event);
     }
 }
 
-void DeviceController::staticTouchCallback(TouchEvent event) {
+void DeviceController::staticTouchCallback(TouchEvent event, uint8_t pad) {
     if (instance) {
-        instance->onTouchEvent(event);
+        instance->onTouchEvent(event, pad);
     }
 }
 
-void DeviceController::staticEncoderCallback(EncoderEvent event) {
+void DeviceController::staticEncoderCallback(EncoderEvent event, uint8_t detents, uint8_t steps) {
     if (instance) {
-        instance->onEncoderEvent(event);
+        // Detents are polled; the oldest edge of this pass is the closest there is
+        getKeyboardHandler().setInputTime(instance->pendingEventTime);
+        instance->onEncoderEvent(event, detents, steps);
     }
 }
 
-void DeviceController::staticHostStateCallback(bool callActive, bool muteState) {
+void DeviceController::staticDeliveryCallback(HidChannel channel, uint16_t connId, uint8_t firstByte, bool delivered) {
     if (instance) {
-        instance->onHostStateUpdate(callActive, muteState);
+        instance->onReportDelivered(channel, connId, firstByte, delivered);
     }
 }
+
+uint8_t DeviceController::staticHeadsetState() {
+    if (!instance) return 0;
+    return (instance->muteState ? HEADSET_MUTE : 0) | (instance->dropState ? HEADSET_DROP : 0);
+}
+
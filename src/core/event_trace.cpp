@@ -0,0 +1,46 @@
+#include "core/event_trace.h"
+
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0, "TRACE_BUFFER_SIZE must be a power of two");
+
+// Constant-initialized, so interrupts that fire during startup find a working ring
+static EventTrace eventTrace;
+
+EventTrace& getEventTrace() {
+    return eventTrace;
+}
+
+void EventTrace::start() {
+    enabled.store(false, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < TRACE_BUFFER_SIZE; i++) {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    head.store(0, std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_release);
+}
+
+uint32_t EventTrace::getOldest() const {
+    uint32_t recorded = getRecorded();
+    return recorded > TRACE_BUFFER_SIZE ? recorded - TRACE_BUFFER_SIZE : 0;
+}
+
+bool EventTrace::read(uint32_t pos, TraceEvent& event) const {
+    // Sequence check on both sides of the copy: a writer lapping the slot in
+    // between changes it
+    const Slot& slot = slots[pos & (TRACE_BUFFER_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) return false;
+    event.time = slot.event.time;
+    event.type = slot.event.type;
+    event.a = slot.event.a;
+    event.b = slot.event.b;
+    event.c = slot.event.c;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == pos + 1;
+}
+
+const char* EventTrace::getTypeName(uint8_t type) {
+    static const char* const names[TRACE_TYPE_COUNT] = {
+        "touch_edge", "button_edge", "wake", "touch", "button", "call_state",
+        "host_state", "notify", "notify_done", "host_write"
+    };
+    return type < TRACE_TYPE_COUNT ? names[type] : "unknown";
+}
@@ -0,0 +1,190 @@
+#include "logger.h"
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal/task.h"
+#include "core/profiler.h"
+#include "config.h"
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+// Constant-initialized, so constructors that log before main() find a working ring
+static Logger logger;
+
+Logger& getLogger() {
+    return logger;
+}
+
+void Logger::begin() {
+    if (drainTask || taskless) return;
+    if (!hal::createTask(drainTaskMain, "log", LOG_TASK_STACK, this, LOG_TASK_PRIORITY, LOG_TASK_CORE)) {
+        // Write records out from the logging call instead
+        taskless = true;
+        drain();
+    }
+}
+
+void Logger::commit(uint8_t level, const char* format, const LogArg* args, uint8_t argCount) {
+    // Bounded multi-producer ring. Sequences count laps of the ring: a slot
+    // is free for position pos when its sequence is the lap's first
+    // position, holds a record for the drain one past that, and is handed
+    // to the next lap once drained. All zero is the empty ring
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    LogRecord* record;
+    while (true) {
+        record = &ring[pos & (LOG_RING_SIZE - 1)];
+        int32_t state = (int32_t)(record->sequence.load(std::memory_order_acquire) - lap(pos));
+        if (state == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (state < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    record->format = format;
+    record->level = level;
+    record->argCount = argCount;
+    memcpy(record->args, args, argCount * sizeof(LogArg));
+    record->sequence.store(lap(pos) + 1, std::memory_order_seq_cst);
+    written.fetch_add(1, std::memory_order_relaxed);
+
+    if (taskless) {
+        // Whoever logs writes out; one at a time
+        if (!draining.exchange(true, std::memory_order_acquire)) {
+            drain();
+            draining.store(false, std::memory_order_release);
+        }
+    } else if (drainSleeping.load(std::memory_order_seq_cst) && drainSleeping.exchange(false)) {
+        hal::notifyTask(drainTask);
+    }
+}
+
+bool Logger::drainOne() {
+    LogRecord& record = ring[tail & (LOG_RING_SIZE - 1)];
+    if (record.sequence.load(std::memory_order_acquire) != lap(tail) + 1) return false;
+
+    char line[LOG_LINE_MAX];
+    size_t length = format(record, line, sizeof(line) - 1);
+    record.sequence.store(lap(tail) + LOG_RING_SIZE, std::memory_order_release);
+    tail++;
+
+    line[length++] = '\n';
+    Serial.write((const uint8_t*)line, length);
+    return true;
+}
+
+void Logger::drain() {
+    while (drainOne()) {
+    }
+
+    uint32_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost != droppedReported) {
+        Serial.printf(LOG_PREFIX_WARN "%lu log records dropped\n", (unsigned long)(lost - droppedReported));
+        droppedReported = lost;
+    }
+}
+
+void Logger::drainTaskMain(void* arg) {
+    Logger* self = static_cast<Logger*>(arg);
+    self->drainTask = hal::currentTask();
+
+    while (true) {
+        uint32_t busy = getProfiler().busyStart();
+        self->drain();
+        getProfiler().busyEnd(PROFILE_TASK_LOG, busy);
+
+        // Announce the sleep, then look once more so a record committed in between is not stranded
+        self->drainSleeping.store(true, std::memory_order_seq_cst);
+        LogRecord& next = self->ring[self->tail & (LOG_RING_SIZE - 1)];
+        if (next.sequence.load(std::memory_order_seq_cst) == lap(self->tail) + 1) {
+            self->drainSleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        hal::waitForNotify(HAL_WAIT_FOREVER);
+        self->drainSleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+size_t Logger::format(const LogRecord& record, char* line, size_t size) const {
+    // Walk the format one conversion at a time, handing each to snprintf with its argument
+    size_t length = 0;
+    uint8_t argIndex = 0;
+    const char* p = record.format;
+
+    while (*p && length < size) {
+        if (*p != '%') {
+            line[length++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            line[length++] = '%';
+            p += 2;
+            continue;
+        }
+
+        const char* start = p++;
+        while (*p && strchr("-+ #0123456789.", *p)) p++;
+        uint8_t longs = 0;
+        char sized = 0;
+        while (*p && strchr("hlzjt", *p)) {
+            if (*p == 'l') longs++;
+            if (*p == 'z' || *p == 'j' || *p == 't') sized = *p;
+            p++;
+        }
+        char conversion = *p;
+        if (conversion) p++;
+
+        char spec[16];
+        size_t specLength = p - start;
+        if (specLength >= sizeof(spec) || argIndex >= record.argCount) {
+            // Malformed or missing argument: copy the text through
+            while (start < p && length < size) line[length++] = *start++;
+            continue;
+        }
+        memcpy(spec, start, specLength);
+        spec[specLength] = '\0';
+
+        const LogArg& arg = record.args[argIndex++];
+        char* out = line + length;
+        size_t room = size - length + 1;  // snprintf counts the terminator the caller reserved
+        int count;
+        switch (conversion) {
+            case 'd': case 'i':
+                if (sized == 'j')        count = snprintf(out, room, spec, (intmax_t)arg.u);
+                else if (sized)          count = snprintf(out, room, spec, (ptrdiff_t)arg.u);
+                else if (longs >= 2)     count = snprintf(out, room, spec, (long long)arg.u);
+                else if (longs == 1)     count = snprintf(out, room, spec, (long)arg.u);
+                else                     count = snprintf(out, room, spec, (int)arg.u);
+                break;
+            case 'u': case 'o': case 'x': case 'X':
+                if (sized == 'j')        count = snprintf(out, room, spec, (uintmax_t)arg.u);
+                else if (sized)          count = snprintf(out, room, spec, (size_t)arg.u);
+                else if (longs >= 2)     count = snprintf(out, room, spec, (unsigned long long)arg.u);
+                else if (longs == 1)     count = snprintf(out, room, spec, (unsigned long)arg.u);
+                else                     count = snprintf(out, room, spec, (unsigned int)arg.u);
+                break;
+            case 'c':
+                count = snprintf(out, room, spec, (int)arg.u);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                count = snprintf(out, room, spec, arg.d);
+                break;
+            case 's':
+                count = snprintf(out, room, spec, arg.p ? (const char*)arg.p : "(null)");
+                break;
+            case 'p':
+                count = snprintf(out, room, spec, arg.p);
+                break;
+            default:
+                count = 0;
+                break;
+        }
+        if (count > 0) {
+            length += ((size_t)count < size - length) ? (size_t)count : size - length;
+        }
+    }
+    return length;
+}
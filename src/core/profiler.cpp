@@ -0,0 +1,101 @@
+#include "core/profiler.h"
+#include "core/input_queue.h"
+
+// Singleton instance
+Profiler& getProfiler() {
+    static Profiler instance;
+    return instance;
+}
+
+Profiler::Profiler()
+    : enabled(false),
+      resetPending(false),
+      active(false),
+      cyclesPerMicro(1),
+      startTime(0),
+      stopTime(0),
+      passes(0),
+      overruns(0),
+      passStartCycles(0),
+      passStartTime(0),
+      lastPassStartTime(0),
+      lastPassEndTime(0) {
+    for (uint8_t i = 0; i < PROFILE_TASK_COUNT; i++) {
+        busyMicros[i] = 0;
+    }
+}
+
+void Profiler::start() {
+    resetPending = true;
+    enabled = true;
+}
+
+void Profiler::stop() {
+    if (enabled.exchange(false)) stopTime = hal::micros();
+}
+
+void Profiler::reset() {
+    for (uint8_t i = 0; i < PROFILE_SECTION_COUNT; i++) {
+        sections[i].reset();
+    }
+    period.reset();
+    lateness.reset();
+    passes = 0;
+    overruns = 0;
+    for (uint8_t i = 0; i < PROFILE_TASK_COUNT; i++) {
+        busyMicros[i].store(0, std::memory_order_relaxed);
+    }
+    cyclesPerMicro = hal::cyclesPerMicro();
+    startTime = hal::micros();
+}
+
+void Profiler::beginPass(bool deadline, uint32_t timeoutMs) {
+    if (!PROFILING) return;
+    active = enabled.load(std::memory_order_relaxed);
+    if (!active) return;
+
+    if (resetPending.exchange(false)) reset();
+
+    passStartCycles = hal::cycles();
+    passStartTime = hal::micros();
+    if (passes == 0) return;
+
+    period.record(passStartTime - lastPassStartTime);
+
+    // Only a real sleep has a deadline to be late for; a poll (timeout 0) does not
+    if (deadline && timeoutMs > 0 && timeoutMs != INPUT_WAIT_FOREVER) {
+        int32_t late = (int32_t)(passStartTime - lastPassEndTime - timeoutMs * 1000);
+        lateness.record(late > 0 ? (uint32_t)late : 0);
+    }
+}
+
+void Profiler::endPass() {
+    if (!isActive()) return;
+
+    sections[PROFILE_PASS].record(toCentiMicros(hal::cycles() - passStartCycles));
+    uint32_t now = hal::micros();
+    uint32_t busy = now - passStartTime;
+    busyMicros[PROFILE_TASK_INPUT].fetch_add(busy, std::memory_order_relaxed);
+    if (busy > PROFILE_PASS_BUDGET) overruns++;
+    passes++;
+
+    lastPassStartTime = passStartTime;
+    lastPassEndTime = now;
+}
+
+uint32_t Profiler::getElapsedMicros() const {
+    return (isEnabled() ? hal::micros() : stopTime) - startTime;
+}
+
+const char* Profiler::getSectionName(ProfileSection section) {
+    static const char* const names[PROFILE_SECTION_COUNT] = {
+        "Host events", "Buttons", "Touch", "Encoder", "Serial", "Telemetry",
+        "Keyboard", "BLE", "LED animator", "LED strip", "Pass"
+    };
+    return section < PROFILE_SECTION_COUNT ? names[section] : "?";
+}
+
+const char* Profiler::getTaskName(ProfileTask task) {
+    static const char* const names[PROFILE_TASK_COUNT] = { "input", "log", "telemetry" };
+    return task < PROFILE_TASK_COUNT ? names[task] : "?";
+}
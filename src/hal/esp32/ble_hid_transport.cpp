@@ -0,0 +1,254 @@
+#include "hal/esp32/ble_hid_transport.h"
+#include "communication/bluetooth_handler.h"
+#include "core/event_trace.h"
+#include "config.h"
+
+static BleHidTransport bleHidTransport;
+
+namespace hal {
+
+HidTransport& getHidTransport() {
+    return bleHidTransport;
+}
+
+} // namespace hal
+
+// Forward declaration for the task function
+void bluetoothTask(void* pvParameters);
+
+BleHidTransport::BleHidTransport()
+    : hid(nullptr), headsetInput(nullptr), headsetOutput(nullptr), keyboardInput(nullptr), consumerInput(nullptr), pServer(nullptr) {
+}
+
+void BleHidTransport::begin() {
+    xTaskCreate(bluetoothTask, "bluetooth", 5000, this, 5, NULL);
+}
+
+void BleHidTransport::initBLE() {
+    BLEDevice::init(DEVICE_NAME);
+    BLEDevice::setCustomGapHandler(gapHandler);
+    BLEDevice::setCustomGattsHandler(gattsHandler);
+    pServer = BLEDevice::createServer();
+    pServer->setCallbacks(new MultiClientServerCallbacks());
+
+    hid = new BLEHIDDevice(pServer);
+    headsetInput = hid->inputReport(HID_REPORTID_PHONE_INPUT);
+    keyboardInput = hid->inputReport(HID_REPORTID_KEYBOARD_INPUT);
+    consumerInput = hid->inputReport(HID_REPORTID_CONSUMER_INPUT);
+    
+    // Initialize output report with report ID and set callback
+    headsetOutput = hid->outputReport(HID_REPORTID_LED_OUTPUT);
+    headsetOutput->setCallbacks(new OutputCallbacks());
+
+    hid->manufacturer()->setValue(DEVICE_MANUFACTURER);
+    hid->pnp(0x02, DEVICE_VID, DEVICE_PID, DEVICE_VERSION);
+    hid->hidInfo(0x00, 0x01);
+
+    BLESecurity* pSecurity = new BLESecurity();
+    pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
+
+    hid->reportMap((uint8_t*)REPORT_MAP, sizeof(REPORT_MAP));
+    hid->startServices();
+
+    BLEAdvertising* pAdvertising = pServer->getAdvertising();
+    // Change the appearance to a keyboard+pointer device
+    pAdvertising->setAppearance(0x03C0);  // Keyboard/pointer HID
+    pAdvertising->addServiceUUID(hid->hidService()->getUUID());
+    pAdvertising->start();
+
+    LOG_INFO("BLE Initialized: %s", DEVICE_NAME);
+}
+
+BLECharacteristic* BleHidTransport::characteristicFor(HidChannel channel) const {
+    switch (channel) {
+        case HID_CHANNEL_HEADSET:  return headsetInput;
+        case HID_CHANNEL_KEYBOARD: return keyboardInput;
+        case HID_CHANNEL_CONSUMER: return consumerInput;
+        default:                   return nullptr;
+    }
+}
+
+bool BleHidTransport::send(HidChannel channel, const uint8_t* report, size_t length, uint16_t connId) {
+  BLECharacteristic* characteristic = characteristicFor(channel);
+  if (!characteristic) return false;
+
+  // Set the report value, so a host reading the characteristic sees it too
+  characteristic->setValue((uint8_t*)report, length);
+
+  // BLECharacteristic::notify() returns void and hides what the stack said;
+  // address each connection directly so a refused notification shows up
+  if (connId != HID_ALL_HOSTS) {
+    return esp_ble_gatts_send_indicate(pServer->getGattsIf(), connId, characteristic->getHandle(),
+                                       length, (uint8_t*)report, false) == ESP_OK;
+  }
+
+  bool success = true;
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    PeerInfo peer = readPeer(i);
+    if (!peer.connected) continue;
+    esp_err_t result = esp_ble_gatts_send_indicate(pServer->getGattsIf(), peer.connId, characteristic->getHandle(),
+                                                   length, (uint8_t*)report, false);
+    if (result != ESP_OK) success = false;
+  }
+  return success;
+}
+
+bool BleHidTransport::isInputHandle(uint16_t handle) const {
+  for (uint8_t c = 0; c < HID_CHANNEL_COUNT; c++) {
+    BLECharacteristic* characteristic = characteristicFor((HidChannel)c);
+    if (characteristic && characteristic->getHandle() == handle) return true;
+  }
+  return false;
+}
+
+void BleHidTransport::requestLinkProfile(uint16_t connId, HidLinkProfile profile) {
+  PeerInfo peer;
+  if (!pServer || !findPeer(connId, peer)) return;
+
+  if (profile == HID_LINK_FAST) {
+    pServer->updateConnParams(peer.address, BLE_FAST_INTERVAL_MIN, BLE_FAST_INTERVAL_MAX,
+                              BLE_FAST_LATENCY, BLE_SUPERVISION_TIMEOUT);
+  } else {
+    pServer->updateConnParams(peer.address, BLE_IDLE_INTERVAL_MIN, BLE_IDLE_INTERVAL_MAX,
+                              BLE_IDLE_LATENCY, BLE_SUPERVISION_TIMEOUT);
+  }
+}
+
+BleHidTransport::PeerInfo BleHidTransport::readPeer(uint8_t index) const {
+  // Copy between two equal, even version reads; a write in between changes it
+  const Peer& peer = peers[index];
+  PeerInfo info;
+  uint32_t version;
+  do {
+    version = peer.version.load(std::memory_order_acquire);
+    info = peer.info;
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((version & 1) || peer.version.load(std::memory_order_relaxed) != version);
+  return info;
+}
+
+bool BleHidTransport::findPeer(uint16_t connId, PeerInfo& peer) const {
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    peer = readPeer(i);
+    if (peer.connected && peer.connId == connId) return true;
+  }
+  return false;
+}
+
+void BleHidTransport::writePeer(uint8_t index, const PeerInfo& info) {
+  Peer& peer = peers[index];
+  uint32_t version = peer.version.load(std::memory_order_relaxed);
+  peer.version.store(version + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  peer.info = info;
+  peer.version.store(version + 2, std::memory_order_release);
+}
+
+void BleHidTransport::addPeer(uint16_t connId, const esp_bd_addr_t address) {
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (!peers[i].info.connected) {
+      PeerInfo info = { true, connId, {} };
+      memcpy(info.address, address, sizeof(esp_bd_addr_t));
+      writePeer(i, info);
+      return;
+    }
+  }
+}
+
+void BleHidTransport::removePeer(uint16_t connId) {
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    if (peers[i].info.connected && peers[i].info.connId == connId) {
+      PeerInfo info = peers[i].info;
+      info.connected = false;
+      writePeer(i, info);
+      return;
+    }
+  }
+}
+
+void BleHidTransport::gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param) {
+  if (event != ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) return;
+
+  // Runs on the BLE stack's task, like the GATT callbacks
+  for (uint8_t i = 0; i < MAX_BLE_CONNECTIONS; i++) {
+    const PeerInfo& peer = bleHidTransport.peers[i].info;  // the writer's own task, no retry needed
+    if (!peer.connected || memcmp(peer.address, param->update_conn_params.bda, sizeof(esp_bd_addr_t)) != 0) continue;
+
+    if (param->update_conn_params.status != ESP_BT_STATUS_SUCCESS) {
+      LOG_WARN("Conn %d rejected parameter update (status %d)", peer.connId, param->update_conn_params.status);
+    }
+    getBLEHandler().onConnectionParams(peer.connId, param->update_conn_params.conn_int,
+                                       param->update_conn_params.latency, param->update_conn_params.timeout);
+    return;
+  }
+}
+
+void BleHidTransport::gattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param) {
+  // Runs on the BLE stack's task ahead of the library's own handling
+  switch (event) {
+    case ESP_GATTS_CONF_EVT:
+      // One per notification, in the order they were sent on that connection
+      if (bleHidTransport.isInputHandle(param->conf.handle)) {
+        getBLEHandler().onNotifyComplete(param->conf.conn_id, param->conf.status == ESP_GATT_OK);
+      }
+      break;
+    case ESP_GATTS_CONGEST_EVT:
+      getBLEHandler().onCongestion(param->congest.conn_id, param->congest.congested);
+      break;
+    default:
+      break;
+  }
+}
+
+void BleHidTransport::startAdvertising() {
+  if (!pServer) {
+    LOG_ERROR("BLE Server or Advertising not initialized");
+    return;
+  }
+
+  pServer->getAdvertising()->start();
+}
+
+void bluetoothTask(void* pvParameters) {
+    BleHidTransport* transport = static_cast<BleHidTransport*>(pvParameters);
+    transport->initBLE();
+    vTaskDelete(NULL);
+}
+
+// MultiClientServerCallbacks implementation
+void MultiClientServerCallbacks::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+    bleHidTransport.addPeer(param->connect.conn_id, param->connect.remote_bda);
+    getBLEHandler().onClientConnected(param->connect.conn_id);
+    getBLEHandler().onConnectionParams(param->connect.conn_id, param->connect.conn_params.interval,
+                                       param->connect.conn_params.latency, param->connect.conn_params.timeout);
+
+    // Workaround for Windows and other devices that don't register for notifications
+    // when reconnecting to a previously paired device
+    auto enableNotifications = [&](BLECharacteristic* characteristic) {
+      if (characteristic) {
+        BLEDescriptor* desc = characteristic->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+        if (desc) {
+          uint8_t val[] = {0x01, 0x00};
+          desc->setValue(val, 2);
+        }
+      }
+    };
+
+    enableNotifications(bleHidTransport.headsetInput);
+    enableNotifications(bleHidTransport.keyboardInput);
+    enableNotifications(bleHidTransport.consumerInput);
+    
+    // pServer->getAdvertising()->start();
+}
+
+void MultiClientServerCallbacks::onDisconnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param) {
+    getBLEHandler().onClientDisconnected(param->disconnect.conn_id);
+    bleHidTransport.removePeer(param->disconnect.conn_id);
+}
+
+// OutputCallbacks implementation
+void OutputCallbacks::onWrite(BLECharacteristic* pCharacteristic, esp_ble_gatts_cb_param_t* param) {
+    std::string value = pCharacteristic->getValue();
+    getEventTrace().record(TRACE_HOST_WRITE, EventTrace::hostId(param->write.conn_id), value.empty() ? 0 : (uint8_t)value[0]);
+    getBLEHandler().onOutputReport(param->write.conn_id, (const uint8_t*)value.data(), value.length());
+}
@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <ESP32Encoder.h>
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/pcnt.h"
+#include "hal/task.h"
+
+namespace hal {
+
+// --- Clock ---
+
+uint32_t millis() {
+    return ::millis();
+}
+
+uint32_t micros() {
+    return ::micros();
+}
+
+void delayMs(uint32_t ms) {
+    ::delay(ms);
+}
+
+uint32_t cycles() {
+    return ESP.getCycleCount();
+}
+
+uint32_t cyclesPerMicro() {
+    return getCpuFrequencyMhz();
+}
+
+// --- GPIO ---
+
+void gpioInputPullup(uint8_t pin) {
+    pinMode(pin, INPUT_PULLUP);
+}
+
+bool gpioRead(uint8_t pin) {
+    return digitalRead(pin) == HIGH;
+}
+
+void gpioAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, HalEdge edge) {
+    int mode = (edge == HAL_EDGE_RISING) ? RISING : (edge == HAL_EDGE_FALLING) ? FALLING : CHANGE;
+    attachInterruptArg(digitalPinToInterrupt(pin), isr, arg, mode);
+}
+
+void gpioDetachInterrupt(uint8_t pin) {
+    detachInterrupt(digitalPinToInterrupt(pin));
+}
+
+// --- Pulse counter ---
+
+// ESP32Encoder takes its interrupt callback at construction, so units are
+// created on attach
+static ESP32Encoder* encoders[HAL_PCNT_UNITS] = { nullptr };
+
+void pcntAttach(uint8_t unit, uint8_t pinA, uint8_t pinB, HalPcntMode mode, uint16_t glitchFilter, HalIsr isr, void* arg) {
+    if (unit >= HAL_PCNT_UNITS || encoders[unit]) return;
+    
+    // Interrupt on every count, not just on overflow
+    encoders[unit] = new ESP32Encoder(true, isr, arg);
+    ESP32Encoder::useInternalWeakPullResistors = UP;
+    if (mode == HAL_PCNT_FULL_QUAD) {
+        encoders[unit]->attachFullQuad(pinA, pinB);
+    } else {
+        encoders[unit]->attachSingleEdge(pinA, pinB);
+    }
+    // Contact bounce shorter than the filter never reaches the counter
+    encoders[unit]->setFilter(glitchFilter);
+    encoders[unit]->clearCount();
+}
+
+int64_t pcntGetCount(uint8_t unit) {
+    return (unit < HAL_PCNT_UNITS && encoders[unit]) ? encoders[unit]->getCount() : 0;
+}
+
+void pcntClearCount(uint8_t unit) {
+    if (unit < HAL_PCNT_UNITS && encoders[unit]) {
+        encoders[unit]->clearCount();
+    }
+}
+
+// --- Tasks ---
+
+bool createTask(HalTaskFunction function, const char* name, uint32_t stackSize, void* arg, uint8_t priority, int8_t core) {
+    BaseType_t result = (core < 0)
+        ? xTaskCreate(function, name, stackSize, arg, priority, NULL)
+        : xTaskCreatePinnedToCore(function, name, stackSize, arg, priority, NULL, core);
+    return result == pdPASS;
+}
+
+void endTask() {
+    vTaskDelete(NULL);
+}
+
+HalTaskHandle currentTask() {
+    return xTaskGetCurrentTaskHandle();
+}
+
+void notifyTask(HalTaskHandle task) {
+    if (task) xTaskNotifyGive((TaskHandle_t)task);
+}
+
+bool waitForNotify(uint32_t timeoutMs) {
+    TickType_t ticks = (timeoutMs == HAL_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    return ulTaskNotifyTake(pdTRUE, ticks) != 0;
+}
+
+} // namespace hal
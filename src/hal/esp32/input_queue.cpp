@@ -0,0 +1,54 @@
+#include "core/input_queue.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Plain static so interrupt handlers never hit a function-local init guard
+static InputQueue inputQueue;
+
+InputQueue& getInputQueue() {
+    return inputQueue;
+}
+
+InputQueue::InputQueue() : queue(nullptr), dropped(0) {
+}
+
+void InputQueue::begin() {
+    if (!queue) {
+        queue = xQueueCreate(INPUT_QUEUE_SIZE, sizeof(InputEvent));
+    }
+}
+
+void IRAM_ATTR InputQueue::pushFromISR(InputSource source, uint8_t pin) {
+    if (!queue) return;
+    
+    InputEvent event = { (uint32_t)micros(), source, pin };
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    if (xQueueSendFromISR((QueueHandle_t)queue, &event, &higherPriorityTaskWoken) != pdTRUE) {
+        dropped++;
+    }
+    
+    // Switch straight to the input task if it outranks whatever was interrupted
+    if (higherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void InputQueue::push(InputSource source, uint8_t pin) {
+    if (!queue) return;
+    
+    InputEvent event = { (uint32_t)micros(), source, pin };
+    if (xQueueSend((QueueHandle_t)queue, &event, 0) != pdTRUE) {
+        dropped++;
+    }
+}
+
+bool InputQueue::wait(InputEvent& event, uint32_t timeoutMs) {
+    if (!queue) return false;
+    
+    TickType_t ticks = (timeoutMs == INPUT_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+    return xQueueReceive((QueueHandle_t)queue, &event, ticks) == pdTRUE;
+}
+
+bool InputQueue::isEmpty() const {
+    return !queue || uxQueueMessagesWaiting((QueueHandle_t)queue) == 0;
+}
@@ -0,0 +1,205 @@
+#include "hal/esp32/led_transports.h"
+#include "esp_heap_caps.h"
+#include "config.h"
+
+// Transport instances - both share the strip's data and clock pins
+static DotStarTransport dotStarTransport(LED_MAX_PIXELS, LED_DATA_PIN, LED_CLOCK_PIN, DOTSTAR_BRG);
+static SpiDmaLedTransport spiDmaTransport(LED_DATA_PIN, LED_CLOCK_PIN, DOTSTAR_BRG);
+
+namespace hal {
+
+uint8_t getLedTransportCount() {
+    return 2;
+}
+
+LedTransport& getLedTransport(uint8_t index) {
+    // Index 0 is the default chosen by LED_USE_SPI_DMA, bit-bang is the fallback
+#if LED_USE_SPI_DMA
+    return (index == 0) ? (LedTransport&)spiDmaTransport : (LedTransport&)dotStarTransport;
+#else
+    return (index == 0) ? (LedTransport&)dotStarTransport : (LedTransport&)spiDmaTransport;
+#endif
+}
+
+} // namespace hal
+
+// --- DotStar bit-bang transport ---
+
+DotStarTransport::DotStarTransport(uint16_t maxPixels, uint8_t dataPin, uint8_t clockPin, uint8_t colorOrder)
+    : strip(maxPixels, dataPin, clockPin, colorOrder), dataPin(dataPin), clockPin(clockPin) {
+}
+
+bool DotStarTransport::begin(uint16_t numPixels) {
+    // Clock out only the pixels the strip has, not the whole buffer capacity
+    strip.updateLength(numPixels);
+    strip.begin();
+    return true;
+}
+
+void DotStarTransport::end() {
+    // Release the pins so another transport can claim them
+    pinMode(dataPin, INPUT);
+    pinMode(clockPin, INPUT);
+}
+
+void DotStarTransport::write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) {
+    for (uint16_t i = 0; i < numPixels; i++) {
+        strip.setPixelColor(i, pixels[i]);
+    }
+    strip.setBrightness(brightness);
+    strip.show();
+}
+
+// --- SPI DMA transport ---
+
+SpiDmaLedTransport::SpiDmaLedTransport(uint8_t dataPin, uint8_t clockPin, uint8_t colorOrder,
+                                       uint32_t clockHz, spi_host_device_t host)
+    : dataPin(dataPin),
+      clockPin(clockPin),
+      // Same byte-offset encoding as the Adafruit DOTSTAR_xxx constants
+      rOffset(colorOrder & 3),
+      gOffset((colorOrder >> 2) & 3),
+      bOffset((colorOrder >> 4) & 3),
+      clockHz(clockHz),
+      host(host),
+      device(nullptr),
+      nextBuffer(0),
+      frameLength(0) {
+    for (uint8_t i = 0; i < BUFFER_COUNT; i++) {
+        buffers[i] = nullptr;
+        inFlight[i] = false;
+    }
+}
+
+bool SpiDmaLedTransport::begin(uint16_t numPixels) {
+    // APA102 frame: 4-byte start frame, 4 bytes per pixel, then one clock
+    // edge per two pixels to push data through the chain
+    frameLength = 4 + numPixels * 4 + (numPixels + 15) / 16;
+
+    for (uint8_t i = 0; i < BUFFER_COUNT; i++) {
+        buffers[i] = (uint8_t*)heap_caps_malloc(frameLength, MALLOC_CAP_DMA);
+        if (!buffers[i]) {
+            LOG_ERROR("LED SPI: failed to allocate %u byte DMA buffer", (unsigned)frameLength);
+            end();
+            return false;
+        }
+        inFlight[i] = false;
+    }
+
+    spi_bus_config_t busConfig = {};
+    busConfig.mosi_io_num = dataPin;
+    busConfig.miso_io_num = -1;
+    busConfig.sclk_io_num = clockPin;
+    busConfig.quadwp_io_num = -1;
+    busConfig.quadhd_io_num = -1;
+    busConfig.max_transfer_sz = frameLength;
+
+    esp_err_t err = spi_bus_initialize(host, &busConfig, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK) {
+        LOG_ERROR("LED SPI: bus init failed (%d)", err);
+        end();
+        return false;
+    }
+
+    spi_device_interface_config_t deviceConfig = {};
+    deviceConfig.clock_speed_hz = clockHz;
+    deviceConfig.mode = 0;
+    deviceConfig.spics_io_num = -1;
+    deviceConfig.queue_size = BUFFER_COUNT;
+
+    err = spi_bus_add_device(host, &deviceConfig, &device);
+    if (err != ESP_OK) {
+        LOG_ERROR("LED SPI: add device failed (%d)", err);
+        spi_bus_free(host);
+        device = nullptr;
+        end();
+        return false;
+    }
+
+    nextBuffer = 0;
+    LOG_DEBUG("LED SPI: %u pixels, %u byte frames at %lu Hz", numPixels, (unsigned)frameLength, (unsigned long)clockHz);
+    return true;
+}
+
+void SpiDmaLedTransport::end() {
+    if (device) {
+        flush();
+        spi_bus_remove_device(device);
+        spi_bus_free(host);
+        device = nullptr;
+    }
+    for (uint8_t i = 0; i < BUFFER_COUNT; i++) {
+        if (buffers[i]) {
+            heap_caps_free(buffers[i]);
+            buffers[i] = nullptr;
+        }
+        inFlight[i] = false;
+    }
+}
+
+void SpiDmaLedTransport::write(const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) {
+    if (!device) return;
+
+    // The back buffer may still be on the wire from two frames ago
+    reapCompleted(false);
+    while (inFlight[nextBuffer]) {
+        reapCompleted(true);
+    }
+
+    uint8_t* buffer = buffers[nextBuffer];
+    size_t length = encodeFrame(buffer, pixels, numPixels, brightness);
+
+    spi_transaction_t& transaction = transactions[nextBuffer];
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.length = length * 8;
+    transaction.tx_buffer = buffer;
+
+    if (spi_device_queue_trans(device, &transaction, 0) == ESP_OK) {
+        inFlight[nextBuffer] = true;
+        nextBuffer = (nextBuffer + 1) % BUFFER_COUNT;
+    } else {
+        LOG_WARN("LED SPI: queue full, frame dropped");
+    }
+}
+
+void SpiDmaLedTransport::flush() {
+    while (inFlight[0] || inFlight[1]) {
+        reapCompleted(true);
+    }
+}
+
+void SpiDmaLedTransport::reapCompleted(bool block) {
+    spi_transaction_t* done = nullptr;
+    while (spi_device_get_trans_result(device, &done, block ? portMAX_DELAY : 0) == ESP_OK) {
+        for (uint8_t i = 0; i < BUFFER_COUNT; i++) {
+            if (done == &transactions[i]) {
+                inFlight[i] = false;
+            }
+        }
+        if (block) return;
+    }
+}
+
+size_t SpiDmaLedTransport::encodeFrame(uint8_t* buffer, const uint32_t* pixels, uint16_t numPixels, uint8_t brightness) {
+    // Brightness is applied the same way Adafruit_DotStar does it, so both
+    // transports produce identical colors
+    uint16_t scale = (uint16_t)brightness + 1;
+
+    uint8_t* out = buffer;
+    *out++ = 0x00; *out++ = 0x00; *out++ = 0x00; *out++ = 0x00;
+
+    for (uint16_t i = 0; i < numPixels; i++) {
+        uint32_t color = pixels[i];
+        out[0] = 0xFF;
+        out[1 + rOffset] = (((color >> 16) & 0xFF) * scale) >> 8;
+        out[1 + gOffset] = (((color >> 8) & 0xFF) * scale) >> 8;
+        out[1 + bOffset] = ((color & 0xFF) * scale) >> 8;
+        out += 4;
+    }
+
+    for (uint16_t i = 0; i < (numPixels + 15) / 16; i++) {
+        *out++ = 0xFF;
+    }
+
+    return out - buffer;
+}
@@ -0,0 +1,116 @@
+#include <Arduino.h>
+#include "driver/touch_sensor.h"
+#include "hal/touch.h"
+#include "config.h"
+
+/*
+ * ESP32-S3 touch peripheral in timer-driven FSM mode. The hardware sweeps
+ * all configured pads in the background, runs its IIR filter and benchmark
+ * tracking, and raises an interrupt when a pad crosses its threshold, so
+ * the CPU never starts or waits for a measurement.
+ */
+
+// On the S3, touch channel n is GPIO n
+#define TOUCH_FIRST_PIN 1
+#define TOUCH_LAST_PIN  14
+
+struct TouchHandler {
+    HalIsr isr;
+    void* arg;
+};
+
+static TouchHandler handlers[TOUCH_LAST_PIN + 1];
+static bool touchStarted = false;
+static bool touchIsrInstalled = false;
+
+static bool isTouchPin(uint8_t pin) {
+    return pin >= TOUCH_FIRST_PIN && pin <= TOUCH_LAST_PIN;
+}
+
+static void IRAM_ATTR touchIsr(void* arg) {
+    uint32_t status = touch_pad_read_intr_status_mask();
+    if (!(status & (TOUCH_PAD_INTR_MASK_ACTIVE | TOUCH_PAD_INTR_MASK_INACTIVE))) return;
+    
+    // Active/inactive interrupts are raised for the channel just measured
+    touch_pad_t pad = touch_pad_get_current_meas_channel();
+    if (pad <= TOUCH_LAST_PIN && handlers[pad].isr) {
+        handlers[pad].isr(handlers[pad].arg);
+    }
+}
+
+namespace hal {
+
+void touchBegin(const uint8_t* pins, uint8_t count) {
+    if (!touchStarted) {
+        touch_pad_init();
+        touch_pad_set_measurement_interval(TOUCH_FSM_SLEEP_CYCLES);
+        touch_pad_set_charge_discharge_times(TOUCH_FSM_MEAS_CYCLES);
+        
+        // Hardware smoothing for reads and benchmark tracking for the thresholds
+        touch_filter_config_t filter = {};
+        filter.mode = TOUCH_PAD_FILTER_IIR_16;
+        filter.debounce_cnt = 1;
+        filter.noise_thr = 0;
+        filter.jitter_step = 4;
+        filter.smh_lvl = TOUCH_PAD_SMOOTH_IIR_2;
+        touch_pad_filter_set_config(&filter);
+        touch_pad_filter_enable();
+    } else {
+        // Pads can only be added while the FSM is stopped
+        touch_pad_fsm_stop();
+    }
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (isTouchPin(pins[i])) {
+            touch_pad_config((touch_pad_t)pins[i]);
+        } else {
+            LOG_ERROR("GPIO %d is not a touch pin", pins[i]);
+        }
+    }
+    
+    touch_pad_set_fsm_mode(TOUCH_FSM_MODE_TIMER);
+    touch_pad_fsm_start();
+    touchStarted = true;
+}
+
+uint32_t touchReadRaw(uint8_t pin) {
+    uint32_t value = 0;
+    if (isTouchPin(pin)) touch_pad_read_raw_data((touch_pad_t)pin, &value);
+    return value;
+}
+
+uint32_t touchReadSmoothed(uint8_t pin) {
+    uint32_t value = 0;
+    if (isTouchPin(pin)) touch_pad_filter_read_smooth((touch_pad_t)pin, &value);
+    return value;
+}
+
+uint32_t touchReadBenchmark(uint8_t pin) {
+    uint32_t value = 0;
+    if (isTouchPin(pin)) touch_pad_read_benchmark((touch_pad_t)pin, &value);
+    return value;
+}
+
+void touchAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, uint32_t threshold) {
+    if (!isTouchPin(pin)) return;
+    
+    handlers[pin].isr = isr;
+    handlers[pin].arg = arg;
+    
+    // The threshold is a distance from the benchmark
+    touch_pad_set_thresh((touch_pad_t)pin, threshold);
+    
+    if (!touchIsrInstalled) {
+        touch_pad_isr_register(touchIsr, NULL, (touch_pad_intr_mask_t)(TOUCH_PAD_INTR_MASK_ACTIVE | TOUCH_PAD_INTR_MASK_INACTIVE));
+        touch_pad_intr_enable((touch_pad_intr_mask_t)(TOUCH_PAD_INTR_MASK_ACTIVE | TOUCH_PAD_INTR_MASK_INACTIVE));
+        touchIsrInstalled = true;
+    }
+}
+
+void touchDetachInterrupt(uint8_t pin) {
+    if (isTouchPin(pin)) {
+        handlers[pin].isr = nullptr;
+    }
+}
+
+} // namespace hal
@@ -0,0 +1,61 @@
+#include "core/input_queue.h"
+
+/*
+ * Single-threaded ring for the simulation. Interrupts are simulated
+ * synchronously, so nothing ever blocks: wait() returns immediately and the
+ * simulator advances the clock between passes instead.
+ */
+struct InputRing {
+    InputEvent events[INPUT_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+};
+
+static InputRing inputRing;
+static InputQueue inputQueue;
+
+InputQueue& getInputQueue() {
+    return inputQueue;
+}
+
+InputQueue::InputQueue() : queue(nullptr), dropped(0) {
+}
+
+void InputQueue::begin() {
+    queue = &inputRing;
+    inputRing.head = 0;
+    inputRing.count = 0;
+}
+
+void InputQueue::pushFromISR(InputSource source, uint8_t pin) {
+    push(source, pin);
+}
+
+void InputQueue::push(InputSource source, uint8_t pin) {
+    if (!queue) return;
+
+    InputRing& ring = *(InputRing*)queue;
+    if (ring.count == INPUT_QUEUE_SIZE) {
+        dropped++;
+        return;
+    }
+    ring.events[(ring.head + ring.count) % INPUT_QUEUE_SIZE] = { (uint32_t)micros(), source, pin };
+    ring.count++;
+}
+
+bool InputQueue::wait(InputEvent& event, uint32_t timeoutMs) {
+    // Nothing else runs while the simulation waits, so never block
+    (void)timeoutMs;
+    if (!queue) return false;
+
+    InputRing& ring = *(InputRing*)queue;
+    if (ring.count == 0) return false;
+    event = ring.events[ring.head];
+    ring.head = (ring.head + 1) % INPUT_QUEUE_SIZE;
+    ring.count--;
+    return true;
+}
+
+bool InputQueue::isEmpty() const {
+    return !queue || ((InputRing*)queue)->count == 0;
+}
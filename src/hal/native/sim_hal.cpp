@@ -0,0 +1,321 @@
+#include <Arduino.h>
+#include "hal/clock.h"
+#include "hal/gpio.h"
+#include "hal/touch.h"
+#include "hal/pcnt.h"
+#include "hal/task.h"
+#include "hal/native/sim_hardware.h"
+
+#define SIM_NUM_PINS 64
+
+// Touch FSM timing, as configured in the ESP32 backend: the sleep between
+// sweeps runs on the 150 kHz RTC slow clock, and each pad's measurement
+// takes roughly eight charge/discharge cycles per microsecond
+#define SIM_TOUCH_SLEEP_US   ((uint64_t)TOUCH_FSM_SLEEP_CYCLES * 1000000 / 150000)
+#define SIM_TOUCH_MEAS_US    (TOUCH_FSM_MEAS_CYCLES / 8)
+#define SIM_TOUCH_DEBOUNCE   1  // extra sweeps a crossing must persist (filter debounce_cnt)
+
+HardwareSerial Serial;
+
+// Simulated hardware state
+static uint64_t simMicros = 0;
+
+struct SimPin {
+    bool high;
+    bool pullup;
+    HalIsr isr;
+    void* arg;
+    HalEdge edge;
+};
+static SimPin pins[SIM_NUM_PINS];
+
+struct SimTouchPad {
+    uint32_t value;      // level at the electrode now
+    uint32_t noise;      // amplitude of the uniform noise on raw readings
+    uint32_t benchmark;  // reading at attach time, like the S3 benchmark register
+    uint32_t threshold;
+    bool active;
+    uint8_t debounce;    // sweeps the smoothed level has been on the other side
+    HalIsr isr;
+    void* arg;
+    bool playback;       // readings come from a recorded trace, not value + noise
+    uint32_t raw;        // last sweep's measurement
+    uint32_t smoothed;   // hardware IIR over the sweeps
+};
+static SimTouchPad pads[SIM_NUM_PINS];
+static uint64_t touchSweepUs = SIM_TOUCH_SLEEP_US;
+static uint32_t noiseState = 0x9E3779B9;  // fixed seed keeps runs repeatable
+
+struct SimCounter {
+    int64_t count;
+    HalIsr isr;
+    void* arg;
+};
+static SimCounter counters[HAL_PCNT_UNITS];
+
+namespace hal {
+
+// --- Clock ---
+
+uint32_t millis() {
+    return (uint32_t)(simMicros / 1000);
+}
+
+uint32_t micros() {
+    return (uint32_t)simMicros;
+}
+
+void delayMs(uint32_t ms) {
+    // Blocking waits just move the virtual clock forward
+    sim::advanceMillis(ms);
+}
+
+uint32_t cycles() {
+    // Code takes no simulated time, so time it on the host clock
+    return (uint32_t)sim::hostNanos();
+}
+
+uint32_t cyclesPerMicro() {
+    return 1000;
+}
+
+// --- GPIO ---
+
+void gpioInputPullup(uint8_t pin) {
+    if (pin >= SIM_NUM_PINS) return;
+    pins[pin].pullup = true;
+    pins[pin].high = true;
+}
+
+bool gpioRead(uint8_t pin) {
+    return pin < SIM_NUM_PINS && pins[pin].high;
+}
+
+void gpioAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, HalEdge edge) {
+    if (pin >= SIM_NUM_PINS) return;
+    pins[pin].isr = isr;
+    pins[pin].arg = arg;
+    pins[pin].edge = edge;
+}
+
+void gpioDetachInterrupt(uint8_t pin) {
+    if (pin < SIM_NUM_PINS) pins[pin].isr = nullptr;
+}
+
+// --- Touch ---
+
+static uint32_t noisyReading(uint32_t level, uint32_t amplitude) {
+    if (amplitude == 0) return level;
+    
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    int64_t reading = (int64_t)level + (int64_t)(noiseState % (2 * amplitude + 1)) - amplitude;
+    return reading > 0 ? (uint32_t)reading : 0;
+}
+
+void touchBegin(const uint8_t* pins, uint8_t count) {
+    // The simulated pads are always scanning; a sweep measures each pad in turn
+    touchSweepUs = SIM_TOUCH_SLEEP_US + (uint64_t)count * SIM_TOUCH_MEAS_US;
+}
+
+uint32_t touchReadRaw(uint8_t pin) {
+    if (pin >= SIM_NUM_PINS) return 0;
+    return pads[pin].playback ? pads[pin].raw : noisyReading(pads[pin].raw, pads[pin].noise);
+}
+
+uint32_t touchReadSmoothed(uint8_t pin) {
+    // The hardware IIR also takes out most of the noise
+    if (pin >= SIM_NUM_PINS) return 0;
+    return pads[pin].playback ? pads[pin].smoothed : noisyReading(pads[pin].smoothed, pads[pin].noise / 4);
+}
+
+uint32_t touchReadBenchmark(uint8_t pin) {
+    return pin < SIM_NUM_PINS ? pads[pin].benchmark : 0;
+}
+
+void touchAttachInterrupt(uint8_t pin, HalIsr isr, void* arg, uint32_t threshold) {
+    if (pin >= SIM_NUM_PINS) return;
+    SimTouchPad& pad = pads[pin];
+    pad.threshold = threshold;
+    pad.active = false;
+    pad.debounce = 0;
+    pad.isr = isr;
+    pad.arg = arg;
+}
+
+void touchDetachInterrupt(uint8_t pin) {
+    if (pin < SIM_NUM_PINS) pads[pin].isr = nullptr;
+}
+
+// --- Pulse counter ---
+
+void pcntAttach(uint8_t unit, uint8_t pinA, uint8_t pinB, HalPcntMode mode, uint16_t glitchFilter, HalIsr isr, void* arg) {
+    if (unit >= HAL_PCNT_UNITS) return;
+    counters[unit].count = 0;
+    counters[unit].isr = isr;
+    counters[unit].arg = arg;
+}
+
+int64_t pcntGetCount(uint8_t unit) {
+    return unit < HAL_PCNT_UNITS ? counters[unit].count : 0;
+}
+
+void pcntClearCount(uint8_t unit) {
+    if (unit < HAL_PCNT_UNITS) counters[unit].count = 0;
+}
+
+// --- Tasks ---
+
+bool createTask(HalTaskFunction function, const char* name, uint32_t stackSize, void* arg, uint8_t priority, int8_t core) {
+    // The simulation is single-threaded: the simulator calls update() itself
+    LOG_WARN("Task '%s' not started in the simulation", name);
+    return false;
+}
+
+void endTask() {
+    // No task is ever started, so nothing can end one
+}
+
+HalTaskHandle currentTask() {
+    return nullptr;
+}
+
+void notifyTask(HalTaskHandle task) {
+}
+
+bool waitForNotify(uint32_t timeoutMs) {
+    return false;
+}
+
+} // namespace hal
+
+namespace sim {
+
+// Sweeps only change anything while some pad's registers have not caught up
+static bool isTouchSettling(const SimTouchPad& pad) {
+    bool beyond = pad.threshold > 0 && pad.smoothed > pad.benchmark + pad.threshold;
+    return !pad.playback && (pad.raw != pad.value || pad.smoothed != pad.raw || beyond != pad.active);
+}
+
+static void fireOnCrossing(SimTouchPad& pad, bool beyond) {
+    // Interrupt on threshold crossings in either direction, as the S3 FSM does
+    if (beyond != pad.active) {
+        pad.active = beyond;
+        if (pad.isr) pad.isr(pad.arg);
+    }
+}
+
+// One FSM sweep of a pad: measure, smooth (IIR_2), then compare the smoothed
+// level against benchmark + threshold with the filter's debounce
+static void sweepTouchPad(SimTouchPad& pad) {
+    pad.raw = pad.value;
+    int64_t error = (int64_t)pad.raw - pad.smoothed;
+    pad.smoothed += (error / 2 != 0) ? error / 2 : error;
+    
+    bool beyond = pad.threshold > 0 && pad.smoothed > pad.benchmark + pad.threshold;
+    if (beyond == pad.active) {
+        pad.debounce = 0;
+    } else if (++pad.debounce > SIM_TOUCH_DEBOUNCE) {
+        pad.debounce = 0;
+        fireOnCrossing(pad, beyond);
+    }
+}
+
+uint64_t nextTouchSweep() {
+    for (uint8_t pin = 0; pin < SIM_NUM_PINS; pin++) {
+        if (isTouchSettling(pads[pin])) {
+            return (simMicros / touchSweepUs + 1) * touchSweepUs;
+        }
+    }
+    return UINT64_MAX;
+}
+
+uint64_t now() {
+    return simMicros;
+}
+
+void advanceMicros(uint64_t us) {
+    // Run the touch sweeps that fall in the interval, at their own time
+    uint64_t end = simMicros + us;
+    for (uint64_t sweep = nextTouchSweep(); sweep <= end; sweep = nextTouchSweep()) {
+        simMicros = sweep;
+        for (uint8_t pin = 0; pin < SIM_NUM_PINS; pin++) {
+            if (isTouchSettling(pads[pin])) sweepTouchPad(pads[pin]);
+        }
+    }
+    simMicros = end;
+}
+
+void advanceMillis(uint32_t ms) {
+    advanceMicros((uint64_t)ms * 1000);
+}
+
+void setPin(uint8_t pin, bool high) {
+    if (pin >= SIM_NUM_PINS) return;
+    SimPin& state = pins[pin];
+    if (state.high == high) return;
+    state.high = high;
+
+    bool fire = state.edge == HAL_EDGE_BOTH || (state.edge == HAL_EDGE_RISING) == high;
+    if (state.isr && fire) {
+        state.isr(state.arg);
+    }
+}
+
+void setTouch(uint8_t pin, uint32_t value) {
+    if (pin >= SIM_NUM_PINS) return;
+    SimTouchPad& pad = pads[pin];
+    if (pad.playback) {
+        pad.raw = pad.smoothed = pad.value;
+        pad.playback = false;
+    }
+    pad.value = value;
+    
+    // The hardware benchmark follows the pad while it is not touched; the
+    // registers catch up over the next sweeps
+    bool touching = pad.threshold > 0 && value > pad.benchmark + pad.threshold;
+    if (!pad.active && !touching) {
+        pad.benchmark = value;
+    }
+}
+
+void playTouch(uint8_t pin, uint32_t raw, uint32_t smoothed, uint32_t benchmark) {
+    if (pin >= SIM_NUM_PINS) return;
+    SimTouchPad& pad = pads[pin];
+    pad.playback = true;
+    pad.value = smoothed;
+    pad.raw = raw;
+    pad.smoothed = smoothed;
+    
+    // The trace already holds the filter's timing, so it crossed when recorded
+    bool beyond = pad.threshold > 0 && smoothed > pad.benchmark + pad.threshold;
+    fireOnCrossing(pad, beyond);
+    
+    // Use the recorded benchmark when the trace has one, else track it like setTouch()
+    if (benchmark) {
+        pad.benchmark = benchmark;
+    } else if (!pad.active) {
+        pad.benchmark = smoothed;
+    }
+}
+
+void setTouchNoise(uint8_t pin, uint32_t amplitude) {
+    if (pin < SIM_NUM_PINS) pads[pin].noise = amplitude;
+}
+
+void rotateEncoder(uint8_t unit, int32_t counts) {
+    if (unit >= HAL_PCNT_UNITS) return;
+    SimCounter& counter = counters[unit];
+    int32_t step = counts < 0 ? -1 : 1;
+    for (int32_t i = 0; i != counts; i += step) {
+        counter.count += step;
+        if (counter.isr) counter.isr(counter.arg);
+    }
+}
+
+void sendSerial(const char* text) {
+    Serial.inject(text);
+}
+
+} // namespace sim
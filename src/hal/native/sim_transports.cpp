@@ -0,0 +1,246 @@
+#include <chrono>
+#include "hal/native/sim_hardware.h"
+#include "communication/bluetooth_handler.h"
+#include "core/event_trace.h"
+
+static sim::SimHidTransport simHidTransport;
+static sim::SimLedTransport simLedTransport;
+
+namespace hal {
+
+HidTransport& getHidTransport() {
+    return simHidTransport;
+}
+
+uint8_t getLedTransportCount() {
+    return 1;
+}
+
+LedTransport& getLedTransport(uint8_t index) {
+    return simLedTransport;
+}
+
+} // namespace hal
+
+namespace sim {
+
+uint64_t hostNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SimHidTransport& getHidTransport() {
+    return simHidTransport;
+}
+
+SimLedTransport& getLedTransport() {
+    return simLedTransport;
+}
+
+// --- HID ---
+
+SimHidTransport::SimHidTransport() : ready(false), acceptsLinkUpdates(true), confirmCount(0) {
+    memset(links, 0, sizeof(links));
+    clear();
+}
+
+bool SimHidTransport::send(HidChannel channel, const uint8_t* report, size_t length, uint16_t connId) {
+    if (channel >= HID_CHANNEL_COUNT) return false;
+
+    SentReport& entry = reports[reportCount % LOG_SIZE];
+    entry.time = now();
+    entry.airTime = entry.time;
+    bool delivered = false;
+    bool dropped = false;
+    for (const Link& link : links) {
+        if (!link.connected || (connId != HID_ALL_HOSTS && link.connId != connId)) continue;
+        if (link.congested) {
+            getBLEHandler().onNotifyComplete(link.connId, false);
+            dropped = true;
+            continue;
+        }
+        delivered = true;
+        uint64_t air = nextEvent(link, entry.time);
+        if (air > entry.airTime) entry.airTime = air;
+
+        PendingConfirm pending = { air, entry.time, (uint32_t)link.interval * 1250, link.connId };
+        if (confirmCount < MAX_CONFIRMS) {
+            confirms[confirmCount++] = pending;
+        } else {
+            confirm(pending);  // more in flight than any stack allows; confirm rather than lose it
+        }
+    }
+    if (dropped && !delivered) return true;  // accepted, then dropped: only the confirm tells
+    entry.hostTime = hostNanos();
+    entry.channel = channel;
+    entry.connId = connId;
+    entry.length = length < sizeof(entry.data) ? length : sizeof(entry.data);
+    memcpy(entry.data, report, entry.length);
+
+    reportCount++;
+    channelCounts[channel]++;
+    return true;
+}
+
+void SimHidTransport::requestLinkProfile(uint16_t connId, HidLinkProfile profile) {
+    Link* link = findLink(connId);
+    if (!link) return;
+    link->requested = profile;
+    if (!acceptsLinkUpdates) return;
+    
+    if (profile == HID_LINK_FAST) {
+        setInterval(*link, BLE_FAST_INTERVAL_MAX, BLE_FAST_LATENCY);
+    } else {
+        setInterval(*link, BLE_IDLE_INTERVAL_MAX, BLE_IDLE_LATENCY);
+    }
+}
+
+void SimHidTransport::connectHost(uint16_t connId) {
+    Link* link = findLink(connId);
+    for (uint8_t i = 0; !link && i < MAX_BLE_CONNECTIONS; i++) {
+        if (!links[i].connected) link = &links[i];
+    }
+    if (link) {
+        link->connected = true;
+        link->connId = connId;
+        link->requested = HID_LINK_IDLE;
+        link->congested = false;
+    }
+    getBLEHandler().onClientConnected(connId);
+    if (link) {
+        setInterval(*link, SIM_HOST_INTERVAL, 0);
+    }
+}
+
+void SimHidTransport::disconnectHost(uint16_t connId) {
+    getBLEHandler().onClientDisconnected(connId);
+    Link* link = findLink(connId);
+    if (link) link->connected = false;
+
+    // Nothing is confirmed on a link that is gone
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < confirmCount; i++) {
+        if (confirms[i].connId != connId) confirms[kept++] = confirms[i];
+    }
+    confirmCount = kept;
+}
+
+void SimHidTransport::deliverConfirms() {
+    // Confirms on one link come due in send order; keep the rest in order too
+    uint64_t time = now();
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < confirmCount; i++) {
+        if (confirms[i].due <= time) {
+            confirm(confirms[i]);
+        } else {
+            confirms[kept++] = confirms[i];
+        }
+    }
+    confirmCount = kept;
+}
+
+uint64_t SimHidTransport::getNextConfirmTime() const {
+    uint64_t next = UINT64_MAX;
+    for (uint8_t i = 0; i < confirmCount; i++) {
+        if (confirms[i].due < next) next = confirms[i].due;
+    }
+    return next;
+}
+
+void SimHidTransport::confirm(const PendingConfirm& pending) {
+    uint64_t latency = pending.due - pending.sent;
+    confirmLatency.record((uint32_t)latency);
+    if (latency == 0 || latency > pending.period) lateConfirms++;
+    getBLEHandler().onNotifyComplete(pending.connId, true);
+}
+
+void SimHidTransport::setAcceptsLinkUpdates(bool accept) {
+    acceptsLinkUpdates = accept;
+    
+    // Settle every link on what it would have negotiated
+    for (Link& link : links) {
+        if (!link.connected) continue;
+        if (!accept) {
+            setInterval(link, SIM_HOST_INTERVAL, 0);
+        } else {
+            requestLinkProfile(link.connId, link.requested);
+        }
+    }
+}
+
+uint16_t SimHidTransport::getInterval(uint16_t connId) const {
+    for (const Link& link : links) {
+        if (link.connected && link.connId == connId) return link.interval;
+    }
+    return 0;
+}
+
+void SimHidTransport::setCongested(uint16_t connId, bool congested) {
+    Link* link = findLink(connId);
+    if (!link || link->congested == congested) return;
+    link->congested = congested;
+    getBLEHandler().onCongestion(connId, congested);
+}
+
+SimHidTransport::Link* SimHidTransport::findLink(uint16_t connId) {
+    for (Link& link : links) {
+        if (link.connected && link.connId == connId) return &link;
+    }
+    return nullptr;
+}
+
+void SimHidTransport::setInterval(Link& link, uint16_t interval, uint16_t latency) {
+    link.interval = interval;
+    link.anchor = now();
+    getBLEHandler().onConnectionParams(link.connId, interval, latency, BLE_SUPERVISION_TIMEOUT);
+}
+
+uint64_t SimHidTransport::nextEvent(const Link& link, uint64_t time) const {
+    // Peripheral latency only lets the device skip idle events, so a pending
+    // report always goes out at the next one; an event already under way at
+    // the instant of the send is too late to carry it
+    uint64_t period = link.interval * 1250ULL;
+    if (period == 0 || time < link.anchor) return link.anchor;
+    return link.anchor + ((time - link.anchor) / period + 1) * period;
+}
+
+void SimHidTransport::writeHostLeds(uint16_t connId, uint8_t value) {
+    getEventTrace().record(TRACE_HOST_WRITE, EventTrace::hostId(connId), value);
+    getBLEHandler().onOutputReport(connId, &value, 1);
+}
+
+void SimHidTransport::clear() {
+    reportCount = 0;
+    memset(channelCounts, 0, sizeof(channelCounts));
+    confirmLatency.reset();
+    lateConfirms = 0;
+}
+
+// --- LED ---
+
+SimLedTransport::SimLedTransport()
+    : numPixels(0), brightness(0), frameCount(0) {
+    memset(frame, 0, sizeof(frame));
+    memset(frameTimes, 0, sizeof(frameTimes));
+    memset(frameHostTimes, 0, sizeof(frameHostTimes));
+}
+
+bool SimLedTransport::begin(uint16_t count) {
+    numPixels = count < LED_MAX_PIXELS ? count : LED_MAX_PIXELS;
+    return true;
+}
+
+void SimLedTransport::write(const uint32_t* pixels, uint16_t count, uint8_t level) {
+    if (count > numPixels) count = numPixels;
+    memcpy(frame, pixels, count * sizeof(uint32_t));
+    brightness = level;
+    frameTimes[frameCount % LOG_SIZE] = now();
+    frameHostTimes[frameCount % LOG_SIZE] = hostNanos();
+    frameCount++;
+}
+
+uint32_t SimLedTransport::getPixel(uint16_t index) const {
+    return index < numPixels ? frame[index] : 0;
+}
+
+} // namespace sim
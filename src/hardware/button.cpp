@@ -1,33 +1,198 @@
 #include "hardware/button.h"
+#include "core/input_queue.h"
+#include "core/event_trace.h"
+#include "hal/gpio.h"
 #include "config.h"
 
+Button* Button::table[BUTTON_MAX_COUNT] = { nullptr };
+uint8_t Button::count = 0;
+
 Button::Button(uint8_t buttonPin, uint16_t debounceTime, uint16_t longPressTime, uint16_t doubleClickTime) 
-    : pin(buttonPin), callback(nullptr) {
+    : pin(buttonPin),
+      callback(nullptr),
+      debounceTime(debounceTime * 1000UL),
+      longPressTime(longPressTime * 1000UL),
+      doubleClickTime(doubleClickTime * 1000UL),
+      rawPressed(false),
+      rawTime(0),
+      integrator(0),
+      pressed(false),
+      transitionTime(0),
+      lastEdgeTime(0),
+      gesture(GESTURE_IDLE),
+      pressTime(0),
+      releaseTime(0),
+      eventTime(0),
+      pressDuration(0) {
+}
+
+void Button::begin() {
+    // Start from the pin's current level, fully debounced
+    hal::gpioInputPullup(pin);
+    rawPressed = pressed = !hal::gpioRead(pin);
+    integrator = pressed ? debounceTime : 0;
+    rawTime = transitionTime = lastEdgeTime = micros();
     
-    // Setup custom configuration for PinButton
-    // Note: In MultiButton, singleClickDelay is used for double-click detection window
-    buttonConfig.debounceDecay = debounceTime;
-    buttonConfig.longClickDelay = longPressTime;
-    buttonConfig.singleClickDelay = doubleClickTime;
+    bool listed = false;
+    for (uint8_t i = 0; i < count; i++) {
+        if (table[i] == this) listed = true;
+    }
+    if (!listed) {
+        if (count < BUTTON_MAX_COUNT) {
+            table[count++] = this;
+        } else {
+            LOG_WARN("Button table full, pin %d will not be updated", pin);
+        }
+    }
     
-    // Create a new PinButton instance with the button pin and custom config
-    button = new PinButton(pin, INPUT_PULLUP, &buttonConfig);
+    hal::gpioAttachInterrupt(pin, onEdge, this, HAL_EDGE_BOTH);
+}
+
+void IRAM_ATTR Button::onEdge(void* arg) {
+    Button* self = static_cast<Button*>(arg);
+    ButtonEdge edge = { (uint32_t)micros(), !hal::gpioRead(self->pin) };
+    self->edges.push(edge);
+    getEventTrace().recordAt(edge.time, TRACE_BUTTON_EDGE, self->pin, edge.pressed);
+    getInputQueue().pushFromISR(INPUT_SOURCE_BUTTON, self->pin);
 }
 
 void Button::setCallback(ButtonCallback callback) {
     this->callback = callback;
 }
+
 void Button::update() {
-    // Let PinButton handle the button processing
-    button->update();
+    // Replay the captured edges in order
+    ButtonEdge edge;
+    while (edges.pop(edge)) {
+        applyEdge(edge.time, edge.pressed);
+    }
+    
+    // An edge lost to a full ring leaves the replayed level stale; the pin is the truth
+    uint32_t now = micros();
+    bool level = !hal::gpioRead(pin);
+    if (level != rawPressed) {
+        applyEdge(now, level);
+    }
+    integrate(now);
+    
+    // While a transition is still being debounced, its first edge is the
+    // latest moment gesture windows can be judged at
+    expireGestures(rawPressed != pressed ? transitionTime : now);
+}
+
+void Button::applyEdge(uint32_t time, bool level) {
+    // The pin re-read can run ahead of an edge still in the ring
+    if ((int32_t)(time - rawTime) < 0) time = rawTime;
+    if (level == rawPressed) return;
+    
+    integrate(time);
+    
+    // An edge away from a settled state after a quiet debounce period starts
+    // the transition; later bounces of the same burst keep its timestamp
+    bool settled = integrator == (pressed ? debounceTime : 0) && time - lastEdgeTime >= debounceTime;
+    if (level != pressed && settled) {
+        transitionTime = time;
+    }
+    rawPressed = level;
+    lastEdgeTime = time;
+}
+
+void Button::integrate(uint32_t time) {
+    // Contact time counts up while the pin is down and down while it is up;
+    // the debounced state follows only when the count reaches either end
+    uint32_t elapsed = (int32_t)(time - rawTime) > 0 ? time - rawTime : 0;
+    rawTime = time;
+    
+    if (rawPressed) {
+        integrator = (elapsed >= debounceTime - integrator) ? debounceTime : integrator + elapsed;
+        if (!pressed && integrator == debounceTime) {
+            pressed = true;
+            registerTransition();
+        }
+    } else {
+        integrator = (elapsed >= integrator) ? 0 : integrator - elapsed;
+        if (pressed && integrator == 0) {
+            pressed = false;
+            registerTransition();
+        }
+    }
+}
+
+void Button::registerTransition() {
+    uint32_t time = transitionTime;
     
-    // Check for button events and trigger callbacks
-    // The MultiButton library only returns true for these methods
-    // during the first call after the event occurs
+    // Windows that closed before this edge resolve first
+    expireGestures(time);
+    
+    if (pressed) {
+        pressTime = time;
+        emit(BUTTON_PRESSED, time);
+        if (gesture == GESTURE_UP) {
+            // Second press inside the window: the gesture is decided now
+            gesture = GESTURE_SECOND_DOWN;
+            emit(BUTTON_DOUBLE_CLICKED, time);
+        } else {
+            gesture = GESTURE_DOWN;
+        }
+    } else {
+        pressDuration = time - pressTime;
+        emit(BUTTON_RELEASED, time);
+        if (gesture == GESTURE_DOWN) {
+            gesture = GESTURE_UP;
+            releaseTime = time;
+        } else {
+            gesture = GESTURE_IDLE;
+        }
+    }
+}
+
+void Button::expireGestures(uint32_t time) {
+    if (gesture == GESTURE_DOWN && time - pressTime >= longPressTime) {
+        gesture = GESTURE_LONG;
+        emit(BUTTON_LONG_PRESSED, pressTime + longPressTime);
+    } else if (gesture == GESTURE_UP && time - releaseTime >= doubleClickTime) {
+        gesture = GESTURE_IDLE;
+        emit(BUTTON_CLICKED, releaseTime + doubleClickTime);
+    }
+}
+
+void Button::emit(ButtonEvent event, uint32_t time) {
+    eventTime = time;
+    getEventTrace().record(TRACE_BUTTON, pin, event);
     if (callback) {
-      if (button->isSingleClick()) callback(BUTTON_CLICKED);
-      if (button->isDoubleClick()) callback(BUTTON_DOUBLE_CLICKED);
-      if (button->isLongClick()) callback(BUTTON_LONG_PRESSED);
-      if (button->isReleased()) callback(BUTTON_RELEASED);
+        callback(event);
+    }
+}
+
+uint32_t Button::getTimeUntilNextEvent() const {
+    if (!edges.isEmpty()) return 0;
+    
+    uint32_t now = micros();
+    int32_t remaining;
+    if (rawPressed != pressed) {
+        // Debounce completes once the integrator reaches the far end
+        uint32_t distance = rawPressed ? debounceTime - integrator : integrator;
+        remaining = (int32_t)(rawTime + distance - now);
+    } else if (gesture == GESTURE_DOWN) {
+        remaining = (int32_t)(pressTime + longPressTime - now);
+    } else if (gesture == GESTURE_UP) {
+        remaining = (int32_t)(releaseTime + doubleClickTime - now);
+    } else {
+        return UINT32_MAX;
+    }
+    return remaining > 0 ? (remaining + 999) / 1000 : 0;
+}
+
+void Button::updateAll() {
+    for (uint8_t i = 0; i < count; i++) {
+        table[i]->update();
+    }
+}
+
+uint32_t Button::getTimeUntilAnyEvent() {
+    uint32_t timeout = UINT32_MAX;
+    for (uint8_t i = 0; i < count; i++) {
+        timeout = min(timeout, table[i]->getTimeUntilNextEvent());
     }
+    return timeout;
 }
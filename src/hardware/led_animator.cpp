@@ -0,0 +1,149 @@
+#include "hardware/led_animator.h"
+#include "config.h"
+
+// Singleton instance
+LedAnimator& getLedAnimator() {
+    static LedAnimator instance(getLedStrip());
+    return instance;
+}
+
+LedAnimator::LedAnimator(LedStrip& strip)
+    : strip(strip),
+      frameCount(0),
+      repeatCount(0),
+      cycleDuration(0),
+      startTime(0),
+      lastTickTime(0),
+      running(false),
+      baseColor(0),
+      renderedColor(0),
+      renderValid(false) {
+}
+
+void LedAnimator::play(const LedKeyframe* sequence, uint8_t count, uint8_t repeat) {
+    if (count == 0) return;
+    if (count > LED_MAX_KEYFRAMES) {
+        LOG_WARN("Animation has %d keyframes, truncating to %d", count, LED_MAX_KEYFRAMES);
+        count = LED_MAX_KEYFRAMES;
+    }
+
+    memcpy(frames, sequence, count * sizeof(LedKeyframe));
+
+    frameCount = count;
+    repeatCount = repeat;
+    cycleDuration = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        cycleDuration += frames[i].duration;
+    }
+
+    startTime = millis();
+    lastTickTime = startTime;
+    running = true;
+
+    // Show the first frame right away instead of waiting for the next tick
+    render(colorAt(0));
+}
+
+void LedAnimator::flash(uint32_t color, uint8_t times, uint16_t onTime, uint16_t offTime) {
+    LedKeyframe sequence[] = {
+        { color, onTime, LED_STEP },
+        { 0, offTime, LED_STEP }
+    };
+    play(sequence, 2, times);
+}
+
+void LedAnimator::blink(uint32_t color, uint16_t period) {
+    flash(color, 0, period, period);
+}
+
+void LedAnimator::fade(uint32_t fromColor, uint32_t toColor, uint16_t duration) {
+    LedKeyframe sequence[] = {
+        { fromColor, 0, LED_STEP },
+        { toColor, duration, LED_FADE }
+    };
+    play(sequence, 2, 1);
+}
+
+void LedAnimator::pulse(uint32_t color, uint16_t period, uint8_t times) {
+    LedKeyframe sequence[] = {
+        { color, (uint16_t)(period / 2), LED_FADE },
+        { 0, (uint16_t)(period - period / 2), LED_FADE }
+    };
+    play(sequence, 2, times);
+}
+
+void LedAnimator::stop() {
+    running = false;
+    render(baseColor);
+}
+
+void LedAnimator::setBaseColor(uint32_t color) {
+    baseColor = color;
+
+    // While a sequence runs the new base shows once it finishes
+    if (!running) {
+        render(baseColor);
+    }
+}
+
+void LedAnimator::update() {
+    if (!running) return;
+
+    uint32_t now = millis();
+    if (now - lastTickTime < LED_FRAME_INTERVAL) return;
+
+    // Stay on the fixed tick grid even if this pass ran late
+    lastTickTime = now - ((now - lastTickTime) % LED_FRAME_INTERVAL);
+
+    uint32_t elapsed = lastTickTime - startTime;
+    if (repeatCount != 0 && elapsed >= cycleDuration * repeatCount) {
+        stop();
+        return;
+    }
+
+    render(colorAt(elapsed));
+}
+
+uint32_t LedAnimator::colorAt(uint32_t elapsed) const {
+    if (cycleDuration == 0) {
+        return frames[frameCount - 1].color;
+    }
+
+    // Sequences are cyclic, so the first fade starts from the last keyframe
+    uint32_t position = elapsed % cycleDuration;
+    uint32_t previousColor = frames[frameCount - 1].color;
+
+    for (uint8_t i = 0; i < frameCount; i++) {
+        const LedKeyframe& frame = frames[i];
+        if (position < frame.duration) {
+            if (frame.mode == LED_FADE) {
+                return blend(previousColor, frame.color, position, frame.duration);
+            }
+            return frame.color;
+        }
+        position -= frame.duration;
+        previousColor = frame.color;
+    }
+
+    return frames[frameCount - 1].color;
+}
+
+uint32_t LedAnimator::blend(uint32_t from, uint32_t to, uint32_t position, uint32_t duration) {
+    uint32_t result = 0;
+    for (uint8_t shift = 0; shift <= 16; shift += 8) {
+        int32_t a = (from >> shift) & 0xFF;
+        int32_t b = (to >> shift) & 0xFF;
+        int32_t channel = a + ((b - a) * (int32_t)position) / (int32_t)duration;
+        result |= (uint32_t)channel << shift;
+    }
+    return result;
+}
+
+void LedAnimator::render(uint32_t color) {
+    // Skip the strip update when the visible color has not changed
+    if (renderValid && color == renderedColor) return;
+
+    strip.setColor(color);
+    renderedColor = color;
+    renderValid = true;
+}
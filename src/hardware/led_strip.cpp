@@ -3,17 +3,28 @@
 
 // Singleton instance
 LedStrip& getLedStrip() {
-    // Default pins based on the example code
-    static LedStrip instance(9, 11, 12); // 9 pixels, data pin 11, clock pin 12
+    // 9 pixels on the platform's default transport
+    static LedStrip instance(LED_NUM_PIXELS, &hal::getLedTransport(0));
     return instance;
 }
 
-LedStrip::LedStrip(uint16_t numPixels, uint8_t dataPin, uint8_t clockPin)
-    : strip(numPixels, dataPin, clockPin, DOTSTAR_BRG), _brightness(0) {
+LedStrip::LedStrip(uint16_t numPixels, LedTransport* transport)
+    : numPixels(min(numPixels, (uint16_t)LED_MAX_PIXELS)),
+      transport(transport),
+      _brightness(0),
+      dirty(true),
+      framesRequested(0),
+      framesPushed(0) {
+    memset(pixels, 0, sizeof(pixels));
 }
 
 void LedStrip::begin(uint8_t brightness) {
-    strip.begin();
+    // Fall back through the other transports if the default cannot start
+    uint8_t fallback = 1;
+    while (!transport->begin(numPixels) && fallback < hal::getLedTransportCount()) {
+        LOG_WARN("LED transport '%s' unavailable, trying the next one", transport->getName());
+        transport = &hal::getLedTransport(fallback++);
+    }
     
     // Load brightness from preferences first
     loadBrightness();
@@ -24,14 +35,15 @@ void LedStrip::begin(uint8_t brightness) {
         saveBrightness(); // Save the initial brightness
     }
     
-    strip.setBrightness(_brightness);
-    strip.show(); // Initialize all pixels to 'off'
+    pushFrame(); // Initialize all pixels to 'off'
 }
 
 void LedStrip::setBrightness(uint8_t brightness) {
-    _brightness = brightness;
-    strip.setBrightness(_brightness);
-    strip.show();
+    if (brightness != _brightness) {
+        _brightness = brightness;
+        dirty = true;
+    }
+    show();
 }
 
 void LedStrip::setBrightnessAndSave(uint8_t brightness) {
@@ -44,29 +56,94 @@ uint8_t LedStrip::getBrightness() const {
 }
 
 void LedStrip::setColor(uint32_t color) {
-    strip.fill(color);
-    strip.show();
+    for (uint16_t i = 0; i < numPixels; i++) {
+        setPixelColor(i, color);
+    }
+    show();
 }
 
 void LedStrip::setColor(uint8_t r, uint8_t g, uint8_t b) {
-    setColor(strip.Color(r, g, b));
+    setColor(color(r, g, b));
 }
 
 void LedStrip::setPixelColor(uint16_t pixelIndex, uint32_t color) {
-    strip.setPixelColor(pixelIndex, color);
+    // Writing the color a pixel already has is a no-op
+    if (pixelIndex < numPixels && pixels[pixelIndex] != color) {
+        pixels[pixelIndex] = color;
+        dirty = true;
+    }
 }
 
 void LedStrip::setPixelColor(uint16_t pixelIndex, uint8_t r, uint8_t g, uint8_t b) {
-    strip.setPixelColor(pixelIndex, r, g, b);
+    setPixelColor(pixelIndex, color(r, g, b));
 }
 
 void LedStrip::clear() {
-    strip.clear();
-    strip.show();
+    setColor((uint32_t)0);
 }
 
 void LedStrip::show() {
-    strip.show();
+    // Coalesced: everything written before the next update() goes out as one frame
+    framesRequested++;
+}
+
+void LedStrip::update() {
+    if (dirty) {
+        pushFrame();
+    }
+}
+
+void LedStrip::pushFrame() {
+    transport->write(pixels, numPixels, _brightness);
+    framesPushed++;
+    dirty = false;
+}
+
+bool LedStrip::setTransport(LedTransport* newTransport) {
+    if (newTransport == transport) return true;
+    
+    transport->flush();
+    transport->end();
+    if (!newTransport->begin(numPixels)) {
+        // Keep the old transport working if the new one cannot start
+        transport->begin(numPixels);
+        pushFrame();
+        return false;
+    }
+    transport = newTransport;
+    pushFrame();
+    return true;
+}
+
+uint32_t LedStrip::benchmarkTransport(LedTransport* candidate, uint16_t frames) {
+    if (frames == 0) return 0;
+    
+    LedTransport* previous = transport;
+    if (!setTransport(candidate)) {
+        return 0;
+    }
+    
+    // Alternate two frames so every write carries real data
+    uint32_t saved[LED_MAX_PIXELS];
+    memcpy(saved, pixels, sizeof(pixels));
+    uint32_t busyTime = 0;
+    for (uint16_t frame = 0; frame < frames; frame++) {
+        uint32_t frameColor = (frame & 1) ? colorRed() : colorBlue();
+        for (uint16_t i = 0; i < numPixels; i++) {
+            pixels[i] = frameColor;
+        }
+        uint32_t start = micros();
+        pushFrame();
+        busyTime += micros() - start;
+        
+        // Let an asynchronous transport finish outside the measured window
+        transport->flush();
+    }
+    memcpy(pixels, saved, sizeof(pixels));
+    
+    // setTransport() pushes the restored framebuffer
+    setTransport(previous);
+    return busyTime / frames;
 }
 
 void LedStrip::loadBrightness() {
@@ -80,5 +157,3 @@ void LedStrip::saveBrightness() {
     preferences.putUChar("brightness", _brightness);
     preferences.end();
 }
-
-
@@ -1,29 +1,40 @@
 #include "config.h"
 #include "hardware/rotary_encoder.h"
+#include "core/input_queue.h"
+#include "hal/pcnt.h"
 
 //  Singleton instance
 RotaryEncoder& getRotaryEncoder() {
     // Default pins for the ESP32-S3: GPIO5, GPIO6, GPIO7 for A, B, Button
     // Use a longer double click time (500ms instead of default 300ms)
-    static RotaryEncoder instance(5, 6, 7, DEBOUNCE_TIME, LONG_PRESS_TIME, DOUBLE_CLICK_TIME);
+    static RotaryEncoder instance(0, 5, 6, 7, ENCODER_DEBOUNCE_TIME, LONG_PRESS_TIME, DOUBLE_CLICK_TIME);
     return instance;
 }
 
-RotaryEncoder::RotaryEncoder(uint8_t pinA, uint8_t pinB, uint8_t buttonPin, uint16_t debounceTime, uint16_t longPressTime, uint16_t doubleClickTime) 
-    : pinA(pinA),
+RotaryEncoder::RotaryEncoder(uint8_t pcntUnit, uint8_t pinA, uint8_t pinB, uint8_t buttonPin, uint16_t debounceTime, uint16_t longPressTime, uint16_t doubleClickTime) 
+    : pcntUnit(pcntUnit),
+      pinA(pinA),
       pinB(pinB),
       buttonPin(buttonPin),
-      lastCount(0),
       lastUpdateCount(0),
       clickButton(buttonPin, debounceTime, longPressTime, doubleClickTime),
       callback(nullptr) {
 }
 
 void RotaryEncoder::begin() {
-    // Configure encoder pins
-    ESP32Encoder::useInternalWeakPullResistors = UP;
-    encoder.attachSingleEdge(pinA, pinB);
-    encoder.clearCount();
+    // Configure encoder pins on a pulse counter that interrupts on every
+    // count; the peripheral's glitch filter takes out contact bounce
+    hal::pcntAttach(pcntUnit, pinA, pinB,
+                    ENCODER_FULL_QUAD ? HAL_PCNT_FULL_QUAD : HAL_PCNT_SINGLE_EDGE,
+                    ENCODER_GLITCH_FILTER, onPulse, this);
+    detentCount = lastUpdateCount = hal::pcntGetCount(pcntUnit);
+    
+    clickButton.begin();
+}
+
+void IRAM_ATTR RotaryEncoder::onPulse(void* arg) {
+    RotaryEncoder* self = static_cast<RotaryEncoder*>(arg);
+    getInputQueue().pushFromISR(INPUT_SOURCE_ENCODER, self->pinA);
 }
 
 void RotaryEncoder::setCallback(EncoderCallback callback) {
@@ -31,68 +42,75 @@ void RotaryEncoder::setCallback(EncoderCallback callback) {
 }
 
 int64_t RotaryEncoder::getCount() {
-    return encoder.getCount();
+    return hal::pcntGetCount(pcntUnit);
 }
 
 void RotaryEncoder::update() {
-    // Handle encoder rotation
-    int64_t currentCount = encoder.getCount();
+    // Handle encoder rotation: every count since the last update is kept, so
+    // a fast spin that lands in one wakeup still yields all of its detents
+    int64_t currentCount = hal::pcntGetCount(pcntUnit);
     
     if (currentCount != lastUpdateCount) {
-        EncoderEvent event = (currentCount > lastUpdateCount) ? ENCODER_CLOCKWISE : ENCODER_COUNTER_CLOCKWISE;
-        handleEncoderEvent(event);
         lastUpdateCount = currentCount;
-    }
-    
-    // Handle precision mode timeout (reset accumulator if no activity)
-    if (notchAccumulator > 0) {
-        if (millis() - lastNotchTime >= ENCODER_PRECISION_RESET_TIMEOUT) {
-            notchAccumulator = 0;
+        
+        // Step the resting detent towards the count one whole detent at a
+        // time; a reversal registers as soon as it passes the threshold the
+        // other way, with nothing held back
+        uint32_t detents = 0;
+        EncoderEvent event = ENCODER_CLOCKWISE;
+        while (currentCount - detentCount >= ENCODER_DETENT_THRESHOLD) {
+            detentCount += ENCODER_COUNTS_PER_DETENT;
+            detents++;
+        }
+        if (detents == 0) {
+            event = ENCODER_COUNTER_CLOCKWISE;
+            while (detentCount - currentCount >= ENCODER_DETENT_THRESHOLD) {
+                detentCount -= ENCODER_COUNTS_PER_DETENT;
+                detents++;
+            }
+        }
+        if (detents > 0) {
+            emitDetents(event, detents > UINT8_MAX ? UINT8_MAX : detents);
         }
     }
-    
-    // Update the button state through the mechanical button instance
-    clickButton.update();
 }
 
-void RotaryEncoder::handleEncoderEvent(EncoderEvent event) {
-    // Apply directional bounce filtering
-    if (event == lastDirection) {
-        consistentDirectionCount++;
-    } else {
-        // Direction changed - require consistency before accepting
-        consistentDirectionCount = 1;
-        lastDirection = event;
-    }
-    
-    // Only process the event if we have consistent direction readings
-    if (consistentDirectionCount < ENCODER_DIRECTION_CONSISTENCY) {
-        return; // Ignore until we get consistent readings
-    }
-    
-    // Precision mode: accumulate notches for one arrow
+void RotaryEncoder::emitDetents(EncoderEvent event, uint8_t detents) {
+    // Detent rate since the previous emitted detents; a turn after a pause
+    // or a reversal starts slow again
     unsigned long currentTime = millis();
-    
-    // Reset accumulator if direction changed or timeout occurred
-    if (event != accumulatedDirection || 
-        (currentTime - lastNotchTime >= ENCODER_PRECISION_RESET_TIMEOUT)) {
-        notchAccumulator = 0;
-        accumulatedDirection = event;
+    unsigned long elapsed = currentTime - lastDetentTime;
+    uint32_t detentsPerSecond = 0;
+    if (event != lastDirection) {
+        stepRemainder = 0;
+        lastDirection = event;
+    } else if (elapsed < ENCODER_PRECISION_RESET_TIMEOUT) {
+        detentsPerSecond = detents * 1000UL / (elapsed > 0 ? elapsed : 1);
+    } else {
+        stepRemainder = 0;
     }
+    lastDetentTime = currentTime;
     
-    // Increment notch counter
-    notchAccumulator++;
-    lastNotchTime = currentTime;
+    // Scale by the gain, carrying the fraction so a steady spin at 1.5x
+    // alternates one and two steps rather than rounding down to one
+    uint32_t scaled = (uint32_t)detents * accelerationGain(detentsPerSecond) + stepRemainder;
+    uint32_t steps = scaled >> 8;
+    stepRemainder = scaled & 0xFF;
     
-    // Send callback when threshold is reached
-    if (notchAccumulator >= ENCODER_PRECISION_NOTCH_THRESHOLD) {
-        if (callback) {
-            callback(event);
-        }
-        notchAccumulator = 0; // Reset for next accumulation
+    if (callback) {
+        callback(event, detents, steps > UINT8_MAX ? UINT8_MAX : steps);
     }
 }
 
+uint16_t RotaryEncoder::accelerationGain(uint32_t detentsPerSecond) {
+    // Linear ramp from 1x at ENCODER_ACCEL_MIN_RATE to ENCODER_ACCEL_MAX_GAIN
+    // at ENCODER_ACCEL_MAX_RATE
+    if (detentsPerSecond <= ENCODER_ACCEL_MIN_RATE) return 256;
+    if (detentsPerSecond >= ENCODER_ACCEL_MAX_RATE) return ENCODER_ACCEL_MAX_GAIN * 256;
+    return 256 + (ENCODER_ACCEL_MAX_GAIN - 1) * 256 * (detentsPerSecond - ENCODER_ACCEL_MIN_RATE)
+                 / (ENCODER_ACCEL_MAX_RATE - ENCODER_ACCEL_MIN_RATE);
+}
+
 Button& RotaryEncoder::getClickButton() {
     return clickButton;
 }
@@ -1,133 +1,358 @@
 #include "hardware/touch_sensor.h"
 #include "hardware/led_strip.h"
+#include "hardware/led_animator.h"
+#include "core/input_queue.h"
+#include "core/event_trace.h"
+#include "hal/touch.h"
 #include "config.h"
 
-// Singleton instance
+// Singleton instance; pads are added by the device controller
 TouchSensor& getTouchSensor() {
-    static TouchSensor instance(4);  // Default touch pin is 4
+    static TouchSensor instance;
     return instance;
 }
 
-TouchSensor::TouchSensor(uint8_t touchPin, uint16_t debounceTime) 
-    : touchPin(touchPin),
-      debounceTime(debounceTime),
-      touchThreshold(0),
-      touchState(0),
-      lastReading(0),
-      lastDebounceTime(0),
+TouchSensor::TouchSensor()
+    : padCount(0),
       calibrationInProgress(false),
-      calibrationComplete(false),
-      calibrationStartTime(0),
+      calibrationPad(0),
       calibrationStage(0),
-      untouchedValue(0),
-      touchedValue(0),
+      calibrationStartTime(0),
+      calibrationSampleTime(0),
+      sampleCount(0),
+      sampleMean(0),
+      sampleM2(0),
+      lastSampleTime(0),
+      lastBaselineTime(0),
+      sampleRequested(false),
+      interruptTime(0),
+      eventTime(0),
       callback(nullptr) {
+    memset(pins, 0, sizeof(pins));
+    memset(actions, 0, sizeof(actions));
+    memset(calibrated, 0, sizeof(calibrated));
+    memset(untouchedValue, 0, sizeof(untouchedValue));
+    memset(touchedValue, 0, sizeof(touchedValue));
+    memset(untouchedNoise, 0, sizeof(untouchedNoise));
+    memset(touchedNoise, 0, sizeof(touchedNoise));
+    memset(touchThreshold, 0, sizeof(touchThreshold));
+    memset(samples, 0, sizeof(samples));
+    memset(filteredValue, 0, sizeof(filteredValue));
+    memset(baselineValue, 0, sizeof(baselineValue));
+    memset(delta, 0, sizeof(delta));
+    memset(sampleStreak, 0, sizeof(sampleStreak));
+    memset(touchState, 0, sizeof(touchState));
+    for (uint8_t i = 0; i < TOUCH_MAX_PADS; i++) {
+        direction[i] = 1;
+        pressDelta[i] = INT32_MAX;  // never pressed until calibrated
+        releaseDelta[i] = INT32_MAX;
+        interruptContext[i].sensor = this;
+        interruptContext[i].pad = i;
+    }
+}
+
+int TouchSensor::addPad(uint8_t pin, TouchAction action) {
+    if (padCount >= TOUCH_MAX_PADS) {
+        LOG_WARN("Touch pad on GPIO %d ignored: %d pads already in use", pin, TOUCH_MAX_PADS);
+        return -1;
+    }
+    pins[padCount] = pin;
+    actions[padCount] = action;
+    return padCount++;
 }
 
 void TouchSensor::begin() {
-    loadSettings();
-    
-    // If not calibrated, automatically start calibration
-    if (!calibrationComplete) {
-        startCalibration();
+    // One peripheral sweep measures every pad
+    hal::touchBegin(pins, padCount);
+
+    for (uint8_t i = 0; i < padCount; i++) {
+        loadSettings(i);
+        if (calibrated[i]) {
+            resetFilter(i);
+            attachTouchInterrupt(i);
+        }
     }
+    lastSampleTime = millis();
+    lastBaselineTime = lastSampleTime;
+
+    // Automatically calibrate any pad without saved settings
+    startNextCalibration();
+}
+
+void TouchSensor::resetFilter(uint8_t pad) {
+    // Start from the calibrated levels; the baseline tracker takes over drift from here
+    direction[pad] = (touchedValue[pad] >= untouchedValue[pad]) ? 1 : -1;
+    pressDelta[pad] = abs(touchThreshold[pad] - untouchedValue[pad]);
+    // The peripheral interrupts on both crossings of one threshold, so a
+    // release still has to fall below the lower software margin
+    releaseDelta[pad] = pressDelta[pad] * detector.releasePercent / 100;
+
+    filteredValue[pad] = untouchedValue[pad] << TOUCH_FIXED_SHIFT;
+    baselineValue[pad] = filteredValue[pad];
+    delta[pad] = 0;
+    touchState[pad] = 0;
+    sampleStreak[pad] = 0;
+}
+
+void TouchSensor::attachTouchInterrupt(uint8_t pad) {
+    // The S3 touch peripheral compares against its own benchmark, so the
+    // interrupt threshold is the distance from the untouched baseline
+    int distance = abs(touchThreshold[pad] - untouchedValue[pad]);
+    if (distance <= 0) return;
+    hal::touchAttachInterrupt(pins[pad], onThreshold, &interruptContext[pad], distance);
+}
+
+void TouchSensor::detachTouchInterrupt(uint8_t pad) {
+    hal::touchDetachInterrupt(pins[pad]);
 }
 
-void TouchSensor::loadSettings() {
+void IRAM_ATTR TouchSensor::onThreshold(void* arg) {
+    PadInterrupt* context = static_cast<PadInterrupt*>(arg);
+    TouchSensor* self = context->sensor;
+    self->interruptTime = micros();
+    self->sampleRequested = true;
+    getEventTrace().recordAt(self->interruptTime, TRACE_TOUCH_EDGE, context->pad);
+    getInputQueue().pushFromISR(INPUT_SOURCE_TOUCH, self->pins[context->pad]);
+}
+
+bool TouchSensor::isSettling() const {
+    // Any pad touched, partway to a decision, or not yet decayed to its baseline
+    if (sampleRequested) return true;
+    for (uint8_t i = 0; i < padCount; i++) {
+        if (touchState[i] || sampleStreak[i] > 0 || delta[i] >= releaseDelta[i]) return true;
+    }
+    return false;
+}
+
+uint32_t TouchSensor::sampleInterval() const {
+#if TOUCH_HW_FSM
+    // Threshold interrupts report both edges and the peripheral tracks drift,
+    // so only check slowly while touched in case a release interrupt is lost.
+    // A touched pad that has crossed back under the hardware threshold gets
+    // no further interrupt, so follow it fast down to the release margin.
+    uint32_t interval = UINT32_MAX;
+    for (uint8_t i = 0; i < padCount; i++) {
+        if (touchState[i] && delta[i] <= pressDelta[i]) return detector.sampleInterval;
+        if (touchState[i] || sampleStreak[i] > 0) interval = TOUCH_IDLE_SAMPLE_INTERVAL;
+    }
+    return interval;
+#else
+    // Sample fast while a touch is in progress, slowly otherwise to follow drift
+    return isSettling() ? detector.sampleInterval : TOUCH_IDLE_SAMPLE_INTERVAL;
+#endif
+}
+
+int TouchSensor::readSample(uint8_t pad) const {
+#if TOUCH_HW_FSM
+    return hal::touchReadSmoothed(pins[pad]);
+#else
+    return hal::touchReadRaw(pins[pad]);
+#endif
+}
+
+uint32_t TouchSensor::getTimeUntilNextSample() const {
+    unsigned long now = millis();
+
+    // The other pads keep sampling while one is calibrated
+    uint32_t calibrationWait = UINT32_MAX;
+    if (calibrationInProgress) {
+        unsigned long stageElapsed = now - calibrationStartTime;
+        unsigned long sinceSample = now - calibrationSampleTime;
+        if (stageElapsed <= CALIBRATION_INTERVAL) {
+            calibrationWait = CALIBRATION_INTERVAL - stageElapsed + 1;
+        } else {
+            calibrationWait = (sampleCount == 0 || sinceSample >= CALIBRATION_SAMPLE_INTERVAL) ? 0 : CALIBRATION_SAMPLE_INTERVAL - sinceSample;
+        }
+    }
+
+    if (padCount == 0) return calibrationWait;
+
+    if (sampleRequested) return 0;
+
+    uint32_t interval = sampleInterval();
+    if (interval == UINT32_MAX) return calibrationWait;
+    unsigned long sinceSample = now - lastSampleTime;
+    return min(calibrationWait, sinceSample >= interval ? 0 : (uint32_t)(interval - sinceSample));
+}
+
+void TouchSensor::openSettings(uint8_t pad, bool readOnly) {
+    // Pad 0 keeps the original namespace so existing calibrations still load
+    if (pad == 0) {
+        preferences.begin("touch-settings", readOnly);
+    } else {
+        char name[16];
+        snprintf(name, sizeof(name), "touch-pad%u", pad);
+        preferences.begin(name, readOnly);
+    }
+}
+
+void TouchSensor::loadSettings(uint8_t pad) {
     // Open preferences in read-only mode
-    preferences.begin("touch-settings", true);
-    
+    openSettings(pad, true);
+
     // Load saved values or use defaults
-    untouchedValue = preferences.getUInt("untouched", 0);
-    touchedValue = preferences.getUInt("touched", 0);
-    touchThreshold = preferences.getUInt("touchThresh", 0);
-    
+    untouchedValue[pad] = preferences.getUInt("untouched", 0);
+    touchedValue[pad] = preferences.getUInt("touched", 0);
+    touchThreshold[pad] = preferences.getUInt("touchThresh", 0);
+    untouchedNoise[pad] = preferences.getUInt("untouchedNoise", 0);
+    touchedNoise[pad] = preferences.getUInt("touchedNoise", 0);
+
     // If we have both untouched and touched values, we can calculate a threshold
-    if (untouchedValue > 0 && touchedValue > 0) {
-        calibrationComplete = true;
+    if (untouchedValue[pad] > 0 && touchedValue[pad] > 0) {
+        calibrated[pad] = true;
+        if (touchThreshold[pad] == 0) {
+            touchThreshold[pad] = computeThreshold(pad);
+        }
     } else {
-        calibrationComplete = false;
-        touchThreshold = 0;
+        calibrated[pad] = false;
+        touchThreshold[pad] = 0;
     }
-    
+
     preferences.end();
 }
 
-void TouchSensor::saveSettings() {
-    preferences.begin("touch-settings", false);
-    
-    preferences.putUInt("untouched", untouchedValue);
-    preferences.putUInt("touched", touchedValue);
-    preferences.putUInt("touchThresh", touchThreshold);
-    
+void TouchSensor::saveSettings(uint8_t pad) {
+    openSettings(pad, false);
+
+    preferences.putUInt("untouched", untouchedValue[pad]);
+    preferences.putUInt("touched", touchedValue[pad]);
+    preferences.putUInt("touchThresh", touchThreshold[pad]);
+    preferences.putUInt("untouchedNoise", untouchedNoise[pad]);
+    preferences.putUInt("touchedNoise", touchedNoise[pad]);
+
     preferences.end();
-    
-    LOG_DEBUG("Touch sensor settings saved");
+
+    LOG_DEBUG("Touch pad %d settings saved", pad);
+}
+
+void TouchSensor::startNextCalibration() {
+    for (uint8_t i = 0; i < padCount; i++) {
+        if (!calibrated[i]) {
+            startCalibration(i);
+            return;
+        }
+    }
 }
 
-void TouchSensor::startCalibration() {
-    LOG_INFO("--- Starting Touch Calibration ---");
+void TouchSensor::startCalibration(uint8_t pad) {
+    if (pad >= padCount) {
+        LOG_WARN("No touch pad %d (%d configured)", pad, padCount);
+        return;
+    }
+
+    LOG_INFO("--- Starting Touch Calibration: pad %d (GPIO %d) ---", pad, pins[pad]);
     LOG_INFO("Calibrating UNTOUCHED state...");
     LOG_INFO(">>> DO NOT TOUCH the sensor for 5 seconds. <<<");
-    
-    // Set LED to blue during calibration
-    getLedStrip().setColor(getLedStrip().colorBlue());
-    
+
+    // Blink LED blue during untouched calibration
+    getLedAnimator().blink(getLedStrip().colorBlue(), 500);
+
+    // Touches during calibration are samples, not events
+    detachTouchInterrupt(pad);
+    calibrated[pad] = false;
+    touchState[pad] = 0;
+    sampleStreak[pad] = 0;
+    pressDelta[pad] = INT32_MAX;
+    releaseDelta[pad] = INT32_MAX;
+
     calibrationInProgress = true;
+    calibrationPad = pad;
     calibrationStage = 0; // Start with untouched calibration
     calibrationStartTime = millis();
-    calibrationComplete = false;
+    sampleCount = 0;
+    sampleMean = 0;
+    sampleM2 = 0;
 }
 
-void TouchSensor::completeCalibration(int baselineValue) {
+void TouchSensor::addCalibrationSample(int value) {
+    // Welford's running mean and variance - no sample buffer needed
+    sampleCount++;
+    float diff = value - sampleMean;
+    sampleMean += diff / sampleCount;
+    sampleM2 += diff * (value - sampleMean);
+}
+
+void TouchSensor::completeCalibration(int meanValue, int noise) {
+    uint8_t pad = calibrationPad;
+
     if (calibrationStage == 0) {
         // Store the untouched baseline value
-        untouchedValue = baselineValue;
-        
+        untouchedValue[pad] = meanValue;
+        untouchedNoise[pad] = noise;
+
         // Move to next stage - touched calibration
         calibrationStage = 1;
         calibrationStartTime = millis();
-        
-        // Set LED to magenta (purple-ish) to indicate touched calibration phase
-        getLedStrip().setColor(getLedStrip().colorMagenta());
-        
-        LOG_INFO("--- Now Calibrating TOUCHED state ---");
+        sampleCount = 0;
+        sampleMean = 0;
+        sampleM2 = 0;
+
+        // Blink LED magenta (purple-ish), faster, to indicate touched calibration phase
+        getLedAnimator().blink(getLedStrip().colorMagenta(), 250);
+
+        LOG_INFO("--- Now Calibrating TOUCHED state: pad %d (GPIO %d) ---", pad, pins[pad]);
         LOG_INFO(">>> TOUCH and HOLD the sensor for 5 seconds. <<<");
-        
+
         return; // Don't complete calibration yet
     } else {
         // Store the touched value
-        touchedValue = baselineValue;
-        
-        // Calculate the threshold as the midpoint between untouched and touched values
-        if (touchedValue > untouchedValue) {
-            // Normal case: touched value is higher
-            touchThreshold = untouchedValue + ((touchedValue - untouchedValue) / 2);
-        } else {
-            // Inverted case: untouched value is higher (unusual but possible)
-            touchThreshold = touchedValue + ((untouchedValue - touchedValue) / 2);
+        touchedValue[pad] = meanValue;
+        touchedNoise[pad] = noise;
+
+        touchThreshold[pad] = computeThreshold(pad);
+
+        int separation = abs(touchedValue[pad] - untouchedValue[pad]);
+        if (separation < TOUCH_MIN_SEPARATION * max(untouchedNoise[pad] + touchedNoise[pad], (int32_t)1)) {
+            LOG_WARN("Weak touch signal on pad %d: separation %d vs noise %d/%d", pad, separation, untouchedNoise[pad], touchedNoise[pad]);
         }
-        
+
         // Save all settings
-        calibrationComplete = true;
-        saveSettings();
-        
+        calibrated[pad] = true;
+        saveSettings(pad);
+
         LOG_INFO("-------------------------------------------------");
-        LOG_INFO("Calibration Complete and Saved!");
-        LOG_INFO("Untouched baseline: %u", untouchedValue);
-        LOG_INFO("Touched value: %u", touchedValue);
-        LOG_INFO("New Touch Threshold set to: %u", touchThreshold);
+        LOG_INFO("Calibration Complete and Saved for pad %d!", pad);
+        LOG_INFO("Untouched baseline: %u (noise %u)", untouchedValue[pad], untouchedNoise[pad]);
+        LOG_INFO("Touched value: %u (noise %u)", touchedValue[pad], touchedNoise[pad]);
+        LOG_INFO("New Touch Threshold set to: %u", touchThreshold[pad]);
         LOG_INFO("-------------------------------------------------");
-        
+
         calibrationInProgress = false;
-        
-        // Reset LED after calibration
-        getLedStrip().clear();
+        resetFilter(pad);
+        attachTouchInterrupt(pad);
+
+        // Return LED to the call status after calibration
+        getLedAnimator().stop();
+
+        // Carry on with the next pad that has no settings yet
+        startNextCalibration();
     }
 }
 
-int TouchSensor::getRawValue() const {
-    return touchRead(touchPin);
+int TouchSensor::computeThreshold(uint8_t pad) const {
+    int32_t span = touchedValue[pad] - untouchedValue[pad];
+    if (detector.thresholdPercent > 0) {
+        return untouchedValue[pad] + span * detector.thresholdPercent / 100;
+    }
+
+    // Place the threshold the same number of standard deviations from both
+    // levels, so a noisier level gets proportionally more margin
+    float noiseSum = untouchedNoise[pad] + touchedNoise[pad];
+    if (noiseSum <= 0) {
+        return untouchedValue[pad] + span / 2;
+    }
+    return untouchedValue[pad] + (int)(span * (untouchedNoise[pad] / noiseSum));
+}
+
+bool TouchSensor::isAnyTouched() const {
+    for (uint8_t i = 0; i < padCount; i++) {
+        if (touchState[i]) return true;
+    }
+    return false;
+}
+
+int TouchSensor::getRawValue(uint8_t pad) const {
+    return hal::touchReadRaw(pins[pad]);
 }
 
 void TouchSensor::setCallback(TouchCallback callback) {
@@ -136,86 +361,124 @@ void TouchSensor::setCallback(TouchCallback callback) {
 
 void TouchSensor::update() {
     unsigned long currentMillis = millis();
-    
+
     // Handle calibration if it's in progress
     if (calibrationInProgress) {
-        // Give user time (5 seconds total) for the current calibration stage
-        if ((currentMillis - calibrationStartTime) > CALIBRATION_INTERVAL) {
-            // Take samples to establish baseline
-            long sampleSum = 0;
-            int calibrationSamples = 200;
-            for (int i = 0; i < calibrationSamples; i++) {
-                sampleSum += touchRead(touchPin);
-                delay(5);
-            }
-            int sampleAverage = sampleSum / calibrationSamples;
-            
-            if (calibrationStage == 0) {
-                LOG_DEBUG("Untouched Average (Baseline): %d", sampleAverage);
-            } else {
-                LOG_DEBUG("Touched Average: %d", sampleAverage);
-            }
-            
-            completeCalibration(sampleAverage);
-            return;
-        }
-        
-        // Different blink rates for different calibration stages
-        int blinkRate = (calibrationStage == 0) ? 500 : 250;
-        
-        // During calibration, blink LED
-        if ((currentMillis / blinkRate) % 2) {
-            if (calibrationStage == 0) {
-                getLedStrip().setColor(getLedStrip().colorBlue());
-            } else {
-                getLedStrip().setColor(getLedStrip().colorMagenta());
+        // Give user time (5 seconds total) for the current calibration stage,
+        // then take one sample per pass so the rest of the device keeps running
+        if ((currentMillis - calibrationStartTime) > CALIBRATION_INTERVAL &&
+            (sampleCount == 0 || currentMillis - calibrationSampleTime >= CALIBRATION_SAMPLE_INTERVAL)) {
+            addCalibrationSample(readSample(calibrationPad));
+            calibrationSampleTime = currentMillis;
+
+            if (sampleCount >= CALIBRATION_SAMPLES) {
+                int mean = (int)(sampleMean + 0.5f);
+                int noise = (int)(sqrtf(sampleM2 / (sampleCount - 1)) + 0.5f);
+
+                if (calibrationStage == 0) {
+                    LOG_DEBUG("Untouched Average (Baseline): %d, noise %d", mean, noise);
+                } else {
+                    LOG_DEBUG("Touched Average: %d, noise %d", mean, noise);
+                }
+
+                completeCalibration(mean, noise);
             }
-        } else {
-            getLedStrip().clear();
         }
-        
-        return;  // Skip the rest of the update during calibration
+        // The LED blink runs in LedAnimator; the other pads carry on below
     }
-    
-    // Skip touch detection if not calibrated
-    if (!calibrationComplete) {
+
+    if (padCount == 0) {
         return;
     }
-    
-    // Read touch value and determine current state
-    int touchValue = touchRead(touchPin);
-    // Determine if touched based on threshold
-    int currentReading = (touchValue > touchThreshold) ? 1 : 0;
-    
-    // Debounce
-    if (currentReading != lastReading) {
-        lastDebounceTime = currentMillis;
-    }
-    
-    if ((currentMillis - lastDebounceTime) > debounceTime) {
-        if (currentReading != touchState) {
-            touchState = currentReading;
-            
-            // Notify of touch events
-            if (callback) {
-                if (touchState) {
-                    callback(TOUCH_PRESSED);
-                } else {
-                    callback(TOUCH_RELEASED);
-                }
-            }
+
+    // An interrupt means a pad just crossed the hardware threshold: sample now
+    if (!sampleRequested && currentMillis - lastSampleTime < sampleInterval()) {
+        return;
+    }
+    sampleRequested = false;
+    lastSampleTime = currentMillis;
+
+    sweep(currentMillis);
+}
+
+void TouchSensor::sweep(unsigned long now) {
+    const uint8_t count = padCount;
+
+    // Fetch the peripheral's latest sweep of every pad first, so the loops
+    // below only touch the local arrays
+    for (uint8_t i = 0; i < count; i++) {
+        samples[i] = (int32_t)readSample(i) << TOUCH_FIXED_SHIFT;
+#if TOUCH_HW_FSM
+        baselineValue[i] = (int32_t)hal::touchReadBenchmark(pins[i]) << TOUCH_FIXED_SHIFT;
+#endif
+    }
+
+#if TOUCH_HW_FSM
+    // The peripheral already smooths the reading and tracks the benchmark
+    for (uint8_t i = 0; i < count; i++) {
+        filteredValue[i] = samples[i];
+    }
+#else
+    // IIR low-pass in fixed point: y += (x - y) / 2^n
+    for (uint8_t i = 0; i < count; i++) {
+        filteredValue[i] += (samples[i] - filteredValue[i]) >> detector.filterShift;
+    }
+#endif
+
+    // Distance from the baseline, positive toward "touched"
+    for (uint8_t i = 0; i < count; i++) {
+        delta[i] = ((filteredValue[i] - baselineValue[i]) >> TOUCH_FIXED_SHIFT) * direction[i];
+    }
+
+    // State changes are rare, so only this loop branches per pad; a pad being
+    // calibrated is sampled but never decides
+    bool changed = false;
+    for (uint8_t i = 0; i < count; i++) {
+        if (calibrationInProgress && i == calibrationPad) continue;
+        changed |= decide(i);
+    }
+
+    // An interrupt that settled without a state change was noise
+    if (changed || !isSettling()) {
+        interruptTime = 0;
+    }
+
+#if !TOUCH_HW_FSM
+    // Follow slow drift (temperature, humidity) only on pads that are clearly untouched
+    if (now - lastBaselineTime >= TOUCH_BASELINE_INTERVAL) {
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t idle = (touchState[i] == 0) & (sampleStreak[i] == 0) & (delta[i] < releaseDelta[i]);
+            baselineValue[i] += ((filteredValue[i] - baselineValue[i]) >> detector.baselineShift) & -idle;
         }
+        lastBaselineTime = now;
+    }
+#else
+    (void)now;
+#endif
+}
+
+bool TouchSensor::decide(uint8_t pad) {
+    // Hysteresis: press above pressDelta, release below the lower releaseDelta,
+    // each confirmed by a run of consecutive samples instead of a fixed delay
+    bool crossing = touchState[pad] ? (delta[pad] < releaseDelta[pad]) : (delta[pad] > pressDelta[pad]);
+    if (!crossing) {
+        sampleStreak[pad] = 0;
+        return false;
+    }
+
+    sampleStreak[pad]++;
+    if (sampleStreak[pad] < (touchState[pad] ? detector.releaseSamples : detector.pressSamples)) {
+        return false;
+    }
+
+    touchState[pad] = !touchState[pad];
+    sampleStreak[pad] = 0;
+    eventTime = interruptTime;
+    getEventTrace().record(TRACE_TOUCH, pad, touchState[pad] ? TOUCH_PRESSED : TOUCH_RELEASED);
+
+    // Notify of touch events
+    if (callback) {
+        callback(touchState[pad] ? TOUCH_PRESSED : TOUCH_RELEASED, pad);
     }
-    
-    lastReading = currentReading;
-    
-    // For debugging
-    /*
-    Serial.print("Touch:");
-    Serial.print(touchValue);
-    Serial.print(", Thresh:");
-    Serial.print(touchThreshold);
-    Serial.print(", State:");
-    Serial.println(touchState);
-    */
+    return true;
 }
@@ -16,9 +16,12 @@ void setup() {
     // LOG_DEBUG("Compiled with log level: %d", LOG_LEVEL);
     
     controller.begin();
+    
+    // Input is handled by the controller's interrupt-driven task from here on
+    controller.startInputTask();
 }
 
 void loop() {
-    controller.update();
-    delay(10); // Small delay to prevent CPU overheating
+    // Nothing to poll: the input task sleeps until an interrupt or deadline
+    vTaskDelete(NULL);
 }
@@ -0,0 +1,467 @@
+/*
+ * Offline touch detector benchmark. Replays a trace captured with the
+ * device's binary telemetry (serial command t1) through the unchanged
+ * TouchSensor code on the simulated HAL, once per point of a grid of
+ * detector settings, and ranks the settings by missed presses, false
+ * presses and detection latency.
+ *
+ * The reference touches come from the trace itself: a centered (non-causal)
+ * moving average of the raw readings split at the midpoint of the two
+ * levels, with blips and gaps shorter than REPLAY_MIN_TOUCH_MS removed.
+ * Pads that were never touched need their levels on the command line.
+ *
+ * Every grid point replays in a forked process, so the simulated hardware
+ * and singletons start clean each time and all cores are used.
+ *
+ * Usage: program trace.bin [-j jobs] [-l pad:untouched:touched]...
+ */
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <algorithm>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "config.h"
+#include "core/input_queue.h"
+#include "hardware/touch_sensor.h"
+#include "hal/native/sim_hardware.h"
+#include "replay/touch_trace.h"
+
+#define REPLAY_SMOOTH_HALF   7      // reference moving average spans 2n+1 samples
+#define REPLAY_MIN_TOUCH_MS  30     // shorter reference touches and gaps are noise
+#define REPLAY_EARLY_MS      10     // a press this far ahead of the reference edge still counts
+#define REPLAY_START_US      1000   // simulated time of the first sample
+#define REPLAY_TOP           15     // grid points listed
+
+// Reference touch, in trace micros
+struct Touch {
+    uint64_t start;
+    uint64_t end;
+};
+
+struct PadReference {
+    bool usable;
+    int32_t untouched;
+    int32_t touched;
+    int32_t untouchedNoise;
+    int32_t touchedNoise;
+    std::vector<Touch> touches;
+};
+
+// Written by a replay process into shared memory
+struct ReplayResult {
+    bool done;
+    uint32_t touches;
+    uint32_t missed;
+    uint32_t falsePresses;
+    uint32_t pressP50;    // microseconds
+    uint32_t pressP99;
+    uint32_t releaseP99;
+};
+
+struct DetectedEvent {
+    uint64_t time;
+    uint8_t pad;
+    TouchEvent event;
+};
+
+#if TOUCH_HW_FSM
+// The peripheral filters and debounces; only the threshold is up to the firmware
+static const uint8_t filterShifts[] = { TOUCH_FILTER_SHIFT };
+static const uint8_t pressSamples[] = { TOUCH_PRESS_SAMPLES };
+static const uint8_t releasePercents[] = { TOUCH_RELEASE_PERCENT };
+static const uint16_t sampleIntervals[] = { TOUCH_SAMPLE_INTERVAL };
+static const uint8_t thresholdPercents[] = { 0, 20, 30, 40, 50, 60, 70, 80 };
+#else
+static const uint8_t filterShifts[] = { 0, 1, 2, 3 };
+static const uint8_t pressSamples[] = { 1, 2, 3, 4 };  // release uses the same count
+static const uint8_t releasePercents[] = { 40, 60, 80 };
+static const uint16_t sampleIntervals[] = { 1, 2, 4 };
+static const uint8_t thresholdPercents[] = { 0, 30, 50, 70 };  // 0 = equal noise margins
+#endif
+
+static TouchTrace trace;
+static PadReference references[TOUCH_MAX_PADS];
+static std::vector<DetectedEvent> detected;
+
+// --- Reference touches ---
+
+static double mean(const std::vector<int64_t>& values) {
+    if (values.empty()) return 0;
+    int64_t sum = 0;
+    for (int64_t value : values) sum += value;
+    return (double)sum / values.size();
+}
+
+static int32_t deviation(const std::vector<int64_t>& values, double center) {
+    if (values.size() < 2) return 0;
+    double sum = 0;
+    for (int64_t value : values) sum += (value - center) * (value - center);
+    return (int32_t)(sqrt(sum / (values.size() - 1)) + 0.5);
+}
+
+static void buildReference(uint8_t pad, bool levelsGiven) {
+    PadReference& ref = references[pad];
+    size_t count = trace.getSampleCount();
+
+    // Centered moving average of the raw readings
+    std::vector<int64_t> prefix(count + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        prefix[i + 1] = prefix[i] + trace.getRaw(i, pad);
+    }
+    std::vector<int64_t> smooth(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t from = i > REPLAY_SMOOTH_HALF ? i - REPLAY_SMOOTH_HALF : 0;
+        size_t to = std::min(count, i + REPLAY_SMOOTH_HALF + 1);
+        smooth[i] = (prefix[to] - prefix[from]) / (int64_t)(to - from);
+    }
+
+    if (!levelsGiven) {
+        // Two-means split of the smoothed readings, starting from the 5th and 95th percentiles
+        std::vector<int64_t> sorted(smooth);
+        std::sort(sorted.begin(), sorted.end());
+        double low = sorted[count / 20];
+        double high = sorted[count - 1 - count / 20];
+        for (int iteration = 0; iteration < 20; iteration++) {
+            double middle = (low + high) / 2;
+            std::vector<int64_t> lows, highs;
+            for (int64_t value : smooth) (value < middle ? lows : highs).push_back(value);
+            if (lows.empty() || highs.empty()) break;
+            low = mean(lows);
+            high = mean(highs);
+        }
+
+        // Touching raises the reading on the S3, unless the capture says otherwise
+        std::vector<int64_t> whileTouched, whileUntouched;
+        for (size_t i = 0; i < count; i++) {
+            (trace.wasTouched(i, pad) ? whileTouched : whileUntouched).push_back(trace.getRaw(i, pad));
+        }
+        bool falling = !whileTouched.empty() && !whileUntouched.empty() && mean(whileTouched) < mean(whileUntouched);
+        ref.untouched = (int32_t)(falling ? high : low);
+        ref.touched = (int32_t)(falling ? low : high);
+    }
+
+    // Noise of each level from the samples settled near it
+    int32_t span = abs(ref.touched - ref.untouched);
+    std::vector<int64_t> atUntouched, atTouched;
+    for (size_t i = 0; i < count; i++) {
+        if (abs((int32_t)smooth[i] - ref.untouched) < span / 4) atUntouched.push_back(trace.getRaw(i, pad));
+        if (abs((int32_t)smooth[i] - ref.touched) < span / 4) atTouched.push_back(trace.getRaw(i, pad));
+    }
+    ref.untouchedNoise = deviation(atUntouched, ref.untouched);
+    ref.touchedNoise = atTouched.size() >= 2 ? deviation(atTouched, ref.touched) : ref.untouchedNoise;
+
+    // Split at the midpoint, then drop blips and close gaps shorter than the minimum
+    int32_t direction = ref.touched >= ref.untouched ? 1 : -1;
+    int64_t middle = ((int64_t)ref.untouched + ref.touched) / 2;
+    std::vector<Touch> raw;
+    bool touching = false;
+    for (size_t i = 0; i < count; i++) {
+        bool above = (smooth[i] - middle) * direction > 0;
+        if (above && !touching) raw.push_back({ trace.getTime(i), trace.getTime(i) });
+        if (!above && touching) raw.back().end = trace.getTime(i);
+        touching = above;
+    }
+    if (touching) raw.back().end = trace.getTime(count - 1);
+
+    const uint64_t minimum = REPLAY_MIN_TOUCH_MS * 1000ULL;
+    ref.touches.clear();
+    for (const Touch& touch : raw) {
+        if (!ref.touches.empty() && touch.start - ref.touches.back().end < minimum) {
+            ref.touches.back().end = touch.end;
+        } else {
+            ref.touches.push_back(touch);
+        }
+    }
+    ref.touches.erase(std::remove_if(ref.touches.begin(), ref.touches.end(),
+                                     [minimum](const Touch& touch) { return touch.end - touch.start < minimum; }),
+                      ref.touches.end());
+
+    // Levels closer than their noise are one level, not a touch
+    ref.usable = levelsGiven || (!ref.touches.empty() && span > ref.untouchedNoise + ref.touchedNoise);
+}
+
+// --- Replay ---
+
+static void onTouch(TouchEvent event, uint8_t pad) {
+    detected.push_back({ sim::now(), pad, event });
+}
+
+// Calibration as TouchSensor would have saved it; the threshold is left for it to derive
+static void seedSettings(uint8_t pad, const PadReference& ref) {
+    char name[16];
+    if (pad == 0) {
+        snprintf(name, sizeof(name), "touch-settings");
+    } else {
+        snprintf(name, sizeof(name), "touch-pad%u", pad);
+    }
+    Preferences preferences;
+    preferences.begin(name, false);
+    preferences.putUInt("untouched", ref.untouched);
+    preferences.putUInt("touched", ref.touched);
+    preferences.putUInt("touchThresh", 0);
+    preferences.putUInt("untouchedNoise", ref.untouchedNoise);
+    preferences.putUInt("touchedNoise", ref.touchedNoise);
+    preferences.end();
+}
+
+static void playSample(size_t sample, uint8_t pad) {
+    if (trace.isHardwareFiltered()) {
+        sim::playTouch(pad + 1, trace.getRaw(sample, pad), trace.getFiltered(sample, pad), trace.getBaseline(sample, pad));
+    } else {
+        sim::playTouch(pad + 1, trace.getRaw(sample, pad), trace.getRaw(sample, pad), 0);
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t>& values, uint8_t percent) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (values.size() * percent + 99) / 100;
+    return values[rank ? rank - 1 : 0];
+}
+
+static ReplayResult replay(const TouchDetectorConfig& config) {
+    uint8_t padCount = trace.getPadCount();
+    uint64_t origin = trace.getTime(0);
+    TouchSensor sensor;
+    sensor.setDetectorConfig(config);
+    sensor.setCallback(onTouch);
+
+    // Pad n plays on GPIO n + 1; unusable pads are left out
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        if (!references[pad].usable) continue;
+        seedSettings(sensor.getPadCount(), references[pad]);
+        sensor.addPad(pad + 1, TOUCH_ACTION_MUTE);
+    }
+
+    sim::advanceMicros(REPLAY_START_US);
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        playSample(0, pad);
+    }
+    sensor.begin();
+
+    InputEvent event;
+    for (size_t sample = 0; sample < trace.getSampleCount(); sample++) {
+        uint64_t at = trace.getTime(sample) - origin + REPLAY_START_US;
+        if (at > sim::now()) sim::advanceMicros(at - sim::now());
+        for (uint8_t pad = 0; pad < padCount; pad++) {
+            playSample(sample, pad);
+        }
+        sensor.update();
+        while (getInputQueue().wait(event, 0)) {}
+    }
+
+    // Match presses to reference touches, pad by pad
+    ReplayResult result = {};
+    std::vector<uint32_t> pressLatency, releaseLatency;
+    const uint64_t early = REPLAY_EARLY_MS * 1000ULL;
+    uint8_t sensorPad = 0;
+    for (uint8_t pad = 0; pad < padCount; pad++) {
+        if (!references[pad].usable) continue;
+        std::vector<uint64_t> presses, releases;
+        for (const DetectedEvent& detection : detected) {
+            if (detection.pad != sensorPad) continue;
+            uint64_t time = detection.time - REPLAY_START_US + origin;
+            (detection.event == TOUCH_PRESSED ? presses : releases).push_back(time);
+        }
+        sensorPad++;
+
+        size_t next = 0;
+        for (const Touch& touch : references[pad].touches) {
+            result.touches++;
+            while (next < presses.size() && presses[next] + early < touch.start) {
+                result.falsePresses++;
+                next++;
+            }
+            if (next == presses.size() || presses[next] > touch.end) {
+                result.missed++;
+                continue;
+            }
+            uint64_t press = presses[next++];
+            pressLatency.push_back(press > touch.start ? press - touch.start : 0);
+            auto release = std::lower_bound(releases.begin(), releases.end(), press);
+            if (release != releases.end()) {
+                releaseLatency.push_back(*release > touch.end ? *release - touch.end : 0);
+            }
+
+            // Chatter: further presses within the same touch
+            while (next < presses.size() && presses[next] <= touch.end) {
+                result.falsePresses++;
+                next++;
+            }
+        }
+        result.falsePresses += presses.size() - next;
+    }
+
+    result.pressP50 = percentile(pressLatency, 50);
+    result.pressP99 = percentile(pressLatency, 99);
+    result.releaseP99 = percentile(releaseLatency, 99);
+    result.done = true;
+    return result;
+}
+
+// Each grid point in its own process, at most 'jobs' at a time
+static void runGrid(const std::vector<TouchDetectorConfig>& configs, ReplayResult* results, unsigned jobs) {
+    size_t next = 0;
+    unsigned running = 0;
+    while (next < configs.size() || running > 0) {
+        if (next < configs.size() && running < jobs) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                results[next] = replay(configs[next]);
+                _exit(0);
+            }
+            if (pid < 0) {
+                perror("fork");
+                break;
+            }
+            next++;
+            running++;
+            continue;
+        }
+        int status;
+        if (wait(&status) < 0) break;
+        running--;
+    }
+    while (wait(NULL) > 0) {}
+}
+
+// --- Report ---
+
+static bool isDefault(const TouchDetectorConfig& config) {
+    TouchDetectorConfig defaults;
+    return config.filterShift == defaults.filterShift && config.pressSamples == defaults.pressSamples &&
+           config.releaseSamples == defaults.releaseSamples && config.releasePercent == defaults.releasePercent &&
+           config.thresholdPercent == defaults.thresholdPercent && config.sampleInterval == defaults.sampleInterval;
+}
+
+static void printRow(const TouchDetectorConfig& config, const ReplayResult& result, double hours) {
+    char threshold[8];
+    if (config.thresholdPercent) {
+        snprintf(threshold, sizeof(threshold), "%u%%", config.thresholdPercent);
+    } else {
+        snprintf(threshold, sizeof(threshold), "sigma");
+    }
+    Serial.printf("%6u %6u %7u%% %6s %6u   %7.2f%% %8.1f %8.1f %8.1f %8.1f%s\n",
+                  config.filterShift, config.pressSamples, config.releasePercent, threshold, config.sampleInterval,
+                  result.touches ? 100.0 * result.missed / result.touches : 0.0,
+                  hours > 0 ? result.falsePresses / hours : 0.0,
+                  result.pressP50 / 1000.0, result.pressP99 / 1000.0, result.releaseP99 / 1000.0,
+                  isDefault(config) ? "  (current)" : "");
+}
+
+static bool parseLevels(const char* text, bool* given) {
+    unsigned pad;
+    int untouched, touched;
+    if (sscanf(text, "%u:%d:%d", &pad, &untouched, &touched) != 3 || pad >= TOUCH_MAX_PADS) return false;
+    references[pad].untouched = untouched;
+    references[pad].touched = touched;
+    given[pad] = true;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    unsigned jobs = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    bool levelsGiven[TOUCH_MAX_PADS] = {};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (!parseLevels(argv[++i], levelsGiven)) {
+                fprintf(stderr, "Bad levels '%s', expected pad:untouched:touched\n", argv[i]);
+                return 2;
+            }
+        } else {
+            path = argv[i];
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s trace.bin [-j jobs] [-l pad:untouched:touched]...\n", argv[0]);
+        return 2;
+    }
+    if (!trace.load(path)) {
+        fprintf(stderr, "No touch telemetry frames in %s\n", path);
+        return 1;
+    }
+    if (jobs == 0) jobs = 1;
+
+    size_t count = trace.getSampleCount();
+    double seconds = (trace.getTime(count - 1) - trace.getTime(0)) / 1e6;
+    Serial.printf("\n--- Touch Replay: %s ---\n", path);
+    Serial.printf("%zu samples over %.1f s, %u pads, %s values, %u frames (%u skipped)\n",
+                  count, seconds, trace.getPadCount(), trace.isHardwareFiltered() ? "hardware" : "software",
+                  trace.getFrameCount(), trace.getSkippedFrames());
+#if TOUCH_HW_FSM
+    if (!trace.isHardwareFiltered()) {
+        Serial.printf("Trace has no hardware smoothing: replaying raw readings as the smoothed register\n");
+    }
+#endif
+
+    bool anyUsable = false;
+    for (uint8_t pad = 0; pad < trace.getPadCount(); pad++) {
+        buildReference(pad, levelsGiven[pad]);
+        const PadReference& ref = references[pad];
+        Serial.printf("Pad %u: untouched %d (noise %d), touched %d (noise %d), %zu reference touches%s\n",
+                      pad, ref.untouched, ref.untouchedNoise, ref.touched, ref.touchedNoise, ref.touches.size(),
+                      ref.usable ? "" : " - skipped, pass -l for a pad without touches");
+        anyUsable |= ref.usable;
+    }
+    if (!anyUsable) return 1;
+
+    std::vector<TouchDetectorConfig> configs;
+    for (uint8_t filter : filterShifts)
+        for (uint8_t press : pressSamples)
+            for (uint8_t release : releasePercents)
+                for (uint8_t threshold : thresholdPercents)
+                    for (uint16_t interval : sampleIntervals) {
+                        TouchDetectorConfig config;
+                        config.filterShift = filter;
+                        config.pressSamples = press;
+                        config.releaseSamples = press;
+                        config.releasePercent = release;
+                        config.thresholdPercent = threshold;
+                        config.sampleInterval = interval;
+                        configs.push_back(config);
+                    }
+
+    size_t bytes = configs.size() * sizeof(ReplayResult);
+    ReplayResult* results = (ReplayResult*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(results, 0, bytes);
+
+    uint64_t start = sim::hostNanos();
+    runGrid(configs, results, jobs);
+    double wallSeconds = (sim::hostNanos() - start) / 1e9;
+
+    // Fewest errors first, then the fastest presses and releases
+    std::vector<size_t> order;
+    for (size_t i = 0; i < configs.size(); i++) {
+        if (results[i].done) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [results](size_t a, size_t b) {
+        uint32_t errorsA = results[a].missed + results[a].falsePresses;
+        uint32_t errorsB = results[b].missed + results[b].falsePresses;
+        if (errorsA != errorsB) return errorsA < errorsB;
+        if (results[a].pressP99 != results[b].pressP99) return results[a].pressP99 < results[b].pressP99;
+        return results[a].releaseP99 < results[b].releaseP99;
+    });
+
+    Serial.printf("%zu of %zu settings replayed in %.1f s on %u processes\n\n",
+                  order.size(), configs.size(), wallSeconds, jobs);
+    Serial.printf("%6s %6s %8s %6s %6s   %8s %8s %8s %8s %8s\n",
+                  "filter", "press", "release", "thresh", "ms", "missed", "false/h", "p50 ms", "p99 ms", "rel p99");
+    double hours = seconds / 3600.0;
+    for (size_t rank = 0; rank < order.size(); rank++) {
+        if (rank < REPLAY_TOP || isDefault(configs[order[rank]])) {
+            printRow(configs[order[rank]], results[order[rank]], hours);
+        }
+    }
+    return order.size() == configs.size() ? 0 : 1;
+}
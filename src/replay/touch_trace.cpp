@@ -0,0 +1,141 @@
+#include "replay/touch_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include "communication/touch_telemetry.h"
+
+static bool readVarint(const uint8_t* data, uint16_t length, uint16_t& pos, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (pos >= length) return false;
+        uint8_t byte = data[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) return true;
+    }
+    return false;
+}
+
+static bool readSigned(const uint8_t* data, uint16_t length, uint16_t& pos, int32_t& value) {
+    uint32_t zigzag;
+    if (!readVarint(data, length, pos, zigzag)) return false;
+    value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    return true;
+}
+
+TouchTrace::TouchTrace()
+    : padCount(0),
+      hardwareFiltered(false),
+      frameCount(0),
+      skippedFrames(0),
+      synced(false),
+      lastSequence(0),
+      lastMicros(0) {
+    memset(previous, 0, sizeof(previous));
+}
+
+bool TouchTrace::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    synced = false;
+    size_t pos = 0;
+    while (pos + TOUCH_TELEMETRY_HEADER <= data.size()) {
+        // Anything that is not a whole frame with a good checksum is log text or line noise
+        if (data[pos] != TOUCH_TELEMETRY_MAGIC) {
+            pos++;
+            continue;
+        }
+        uint16_t length = data[pos + 2] | (data[pos + 3] << 8);
+        size_t end = pos + TOUCH_TELEMETRY_HEADER + length;
+        if (length > TOUCH_TELEMETRY_FRAME_MAX || end >= data.size()) {
+            pos++;
+            continue;
+        }
+        const uint8_t* payload = &data[pos + TOUCH_TELEMETRY_HEADER];
+        uint8_t checksum = 0;
+        for (uint16_t i = 0; i < length; i++) {
+            checksum ^= payload[i];
+        }
+        if (checksum != data[end]) {
+            pos++;
+            continue;
+        }
+
+        frameCount++;
+        if (!decodeFrame(payload, length, data[pos + 1])) {
+            skippedFrames++;
+        }
+        pos = end + 1;
+    }
+    return !times.empty();
+}
+
+bool TouchTrace::decodeFrame(const uint8_t* frame, uint16_t length, uint8_t flags) {
+    if (length < 8) return false;
+    uint16_t sequence = frame[0] | (frame[1] << 8);
+    uint8_t pads = frame[2];
+    uint8_t count = frame[3];
+    uint32_t micros = frame[4] | (frame[5] << 8) | (frame[6] << 16) | ((uint32_t)frame[7] << 24);
+
+    if (pads == 0 || pads > TOUCH_MAX_PADS || (padCount != 0 && pads != padCount)) return false;
+
+    // Delta frames only decode on top of an unbroken chain from a keyframe
+    if (flags & TOUCH_TELEMETRY_KEYFRAME_FLAG) {
+        memset(previous, 0, sizeof(previous));
+        synced = true;
+    } else if (!synced || sequence != (uint16_t)(lastSequence + 1)) {
+        synced = false;
+        return false;
+    }
+    lastSequence = sequence;
+    padCount = pads;
+    hardwareFiltered = (flags & TOUCH_TELEMETRY_HARDWARE_FLAG) != 0;
+
+    // Unwrap micros() against the previous sample
+    uint64_t time = times.empty() ? micros : times.back() + (uint32_t)(micros - lastMicros);
+
+    size_t sampleMark = times.size();
+    size_t valueMark = values.size();
+    uint16_t pos = 8;
+    for (uint8_t sample = 0; sample < count; sample++) {
+        uint32_t field;
+        if (sample > 0) {
+            if (!readVarint(frame, length, pos, field)) break;
+            time += field;
+            micros += field;
+        }
+        if (!readVarint(frame, length, pos, field)) break;
+        times.push_back(time);
+        touched.push_back(field);
+
+        for (uint8_t pad = 0; pad < pads; pad++) {
+            for (uint8_t i = 0; i < 3; i++) {
+                int32_t delta = 0;
+                if (!readSigned(frame, length, pos, delta)) {
+                    pos = length + 1;  // mark the frame truncated
+                }
+                previous[pad][i] += delta;
+                values.push_back(previous[pad][i]);
+            }
+        }
+        if (pos > length) break;
+    }
+
+    if (pos != length) {
+        // Malformed despite its checksum: drop what it added and wait for a keyframe
+        times.resize(sampleMark);
+        touched.resize(sampleMark);
+        values.resize(valueMark);
+        synced = false;
+        return false;
+    }
+    lastMicros = micros;
+    return true;
+}
@@ -0,0 +1,183 @@
+/*
+ * Native simulation of the controller. Runs the unchanged firmware logic
+ * against the simulated HAL on a virtual clock: a scripted session of
+ * touch, button and encoder input, then a summary of the HID reports sent.
+ *
+ * Usage: program [session minutes]
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include "config.h"
+#include "core/device_controller.h"
+#include "communication/bluetooth_handler.h"
+#include "hal/native/sim_hardware.h"
+#include "sim/simulator.h"
+#include "hidmap.h"
+
+#define SIM_TOUCH_PIN      4
+#define SIM_ENCODER_UNIT   0
+#define SIM_BYSTANDER_HOST 1      // second host that never joins a call
+#define SIM_UNTOUCHED      20000
+#define SIM_TOUCHED        40000
+#define SIM_TOUCH_NOISE    300
+#define SIM_SESSION_MIN    60
+
+DeviceController controller;
+Simulator simulator(controller);
+
+// Host-initiated mute followed by a touch unmute, per call
+static uint32_t hostMuteReports = 0;  // report count when the host muted
+static uint32_t hostMutes = 0;
+static uint32_t hostMutesUndone = 0;  // the unmute reached the host
+
+static void touchFor(uint64_t atMs, uint32_t holdMs) {
+    simulator.at(atMs, [] { sim::setTouch(SIM_TOUCH_PIN, SIM_TOUCHED); });
+    simulator.at(atMs + holdMs, [] { sim::setTouch(SIM_TOUCH_PIN, SIM_UNTOUCHED); });
+}
+
+static void pressFor(uint8_t pin, uint64_t atMs, uint32_t holdMs) {
+    simulator.at(atMs, [pin] { sim::setPin(pin, false); });
+    simulator.at(atMs + holdMs, [pin] { sim::setPin(pin, true); });
+}
+
+// One count at a time, 15 ms apart, like a hand turning the knob
+static void turnEncoder(uint64_t atMs, int32_t direction, uint32_t counts) {
+    for (uint32_t i = 0; i < counts; i++) {
+        simulator.at(atMs + i * 15, [direction] { sim::rotateEncoder(SIM_ENCODER_UNIT, direction); });
+    }
+}
+
+static void calibrateTouch() {
+    const uint32_t stageTime = CALIBRATION_INTERVAL + CALIBRATION_SAMPLES * CALIBRATION_SAMPLE_INTERVAL + 500;
+    sim::setTouchNoise(SIM_TOUCH_PIN, SIM_TOUCH_NOISE);
+    sim::setTouch(SIM_TOUCH_PIN, SIM_UNTOUCHED);
+    simulator.run(stageTime);
+    sim::setTouch(SIM_TOUCH_PIN, SIM_TOUCHED);
+    simulator.run(stageTime);
+    sim::setTouch(SIM_TOUCH_PIN, SIM_UNTOUCHED);
+    simulator.run(500);
+}
+
+// The touch after a host mutes must send an unmute, even though the host
+// was last sent unmuted
+static void checkHostUnmuted(sim::SimHidTransport& hid) {
+    hostMutes++;
+    for (uint32_t i = hostMuteReports; i < hid.getReportCount(); i++) {
+        const sim::SentReport& report = hid.getReport(i);
+        if (report.channel != HID_CHANNEL_HEADSET || (report.connId != 0 && report.connId != HID_ALL_HOSTS)) continue;
+        if (!(report.data[0] & HEADSET_MUTE)) {
+            hostMutesUndone++;
+            return;
+        }
+    }
+}
+
+// A call every ten minutes: talk in push-to-talk bursts, adjust volume, mute and unmute
+static void scheduleSession(uint32_t minutes) {
+    uint64_t start = simulator.nowMs();
+    sim::SimHidTransport& hid = sim::getHidTransport();
+
+    for (uint32_t call = 0; call < minutes / 10; call++) {
+        uint64_t t = start + call * 600000ULL;
+
+        simulator.at(t, [&hid] { hid.writeHostLeds(0, 0x02); });  // Call starts, unmuted
+        for (uint32_t i = 0; i < 20; i++) {
+            touchFor(t + 10000 + i * 15000, 150 + (i % 5) * 200);
+        }
+        for (uint32_t i = 0; i < 6; i++) {
+            turnEncoder(t + 30000 + i * 40000, (i % 2) ? -1 : 1, 8);
+        }
+        pressFor(LEFT_BUTTON_PIN, t + 120000, 80);  // Mute, while the link is congested
+        simulator.at(t + 120000, [&hid] { hid.setCongested(0, true); });
+        simulator.at(t + 121000, [&hid] { hid.setCongested(0, false); });
+        pressFor(LEFT_BUTTON_PIN, t + 180000, 80);  // Unmute
+        simulator.at(t + 200000, [&hid] { hid.writeHostLeds(SIM_BYSTANDER_HOST, 0x00); });  // Other host stays idle
+        simulator.at(t + 298000, [&hid] {  // Host mutes on its own, a touch unmutes
+            hostMuteReports = hid.getReportCount();
+            hid.writeHostLeds(0, 0x03);
+        });
+        touchFor(t + 298500, 150);
+        simulator.at(t + 299500, [&hid] { checkHostUnmuted(hid); });
+        simulator.at(t + 300000, [&hid] { hid.writeHostLeds(0, 0x00); });  // Call ends
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t minutes = (argc > 1) ? atoi(argv[1]) : SIM_SESSION_MIN;
+    auto wallStart = std::chrono::steady_clock::now();
+    
+    controller.begin();
+    
+    sim::SimHidTransport& hid = sim::getHidTransport();
+    hid.connectHost(0);
+    hid.connectHost(SIM_BYSTANDER_HOST);
+    
+    calibrateTouch();
+    
+    hid.clear();
+    controller.resetInputStats();
+    getBLEHandler().resetReportStats();
+    uint64_t sessionStart = simulator.nowMs();
+    uint64_t stepsBefore = simulator.getSteps();
+    
+    scheduleSession(minutes);
+    simulator.run(minutes * 60000);
+    
+    double wallMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - wallStart).count();
+    double simMs = (double)(simulator.nowMs() - sessionStart);
+    
+    // Keystrokes must only reach the host in the call
+    uint32_t misrouted = 0;
+    uint32_t logged = hid.getReportCount() < sim::SimHidTransport::LOG_SIZE ? hid.getReportCount() : sim::SimHidTransport::LOG_SIZE;
+    for (uint32_t i = hid.getReportCount() - logged; i < hid.getReportCount(); i++) {
+        const sim::SentReport& report = hid.getReport(i);
+        if (report.channel != HID_CHANNEL_HEADSET && report.connId != 0) misrouted++;
+    }
+    
+    const LatencyHistogram& latency = controller.getReportLatency();
+    Serial.printf("\n--- Simulation Summary ---\n");
+    Serial.printf("Simulated time:   %.0f ms\n", simMs);
+    Serial.printf("Wall time:        %.1f ms (%.0fx real time)\n", wallMs, wallMs > 0 ? simMs / wallMs : 0.0);
+    Serial.printf("Controller passes:%llu\n", (unsigned long long)(simulator.getSteps() - stepsBefore));
+    Serial.printf("Input events:     %u\n", controller.getEventsProcessed());
+    Serial.printf("Reports sent:     %u (headset %u, keyboard %u, consumer %u)\n",
+                  hid.getReportCount(),
+                  hid.getReportCount(HID_CHANNEL_HEADSET),
+                  hid.getReportCount(HID_CHANNEL_KEYBOARD),
+                  hid.getReportCount(HID_CHANNEL_CONSUMER));
+    BluetoothHandler& ble = getBLEHandler();
+    Serial.printf("Reports saved:    %u elided, %u collapsed (headset %u + %u)\n",
+                  ble.getReportsElided(HID_CHANNEL_HEADSET) + ble.getReportsElided(HID_CHANNEL_KEYBOARD) +
+                  ble.getReportsElided(HID_CHANNEL_CONSUMER),
+                  ble.getReportsCollapsed(HID_CHANNEL_HEADSET) + ble.getReportsCollapsed(HID_CHANNEL_KEYBOARD) +
+                  ble.getReportsCollapsed(HID_CHANNEL_CONSUMER),
+                  ble.getReportsElided(HID_CHANNEL_HEADSET), ble.getReportsCollapsed(HID_CHANNEL_HEADSET));
+    Serial.printf("Retried reports:  %u, dropped %u, headset %s\n",
+                  ble.getReportsRetried(HID_CHANNEL_HEADSET) + ble.getReportsRetried(HID_CHANNEL_KEYBOARD) +
+                  ble.getReportsRetried(HID_CHANNEL_CONSUMER),
+                  ble.getReportsDropped(HID_CHANNEL_HEADSET) + ble.getReportsDropped(HID_CHANNEL_KEYBOARD) +
+                  ble.getReportsDropped(HID_CHANNEL_CONSUMER),
+                  ble.isDelivered(HID_CHANNEL_HEADSET) ? "delivered" : "undelivered");
+    Serial.printf("Misrouted keys:   %u of the last %u reports\n", misrouted, logged);
+    Serial.printf("Host mutes:       %u undone by touch of %u\n", hostMutesUndone, hostMutes);
+    Serial.printf("Edge to confirm:  n=%u min=%u p50=%u p99=%u max=%u us, %u failed\n",
+                  latency.getCount(), latency.getMin(), latency.getPercentile(50),
+                  latency.getPercentile(99), latency.getMax(), controller.getReportFailures());
+    
+    // The stack confirms at the connection event carrying the notification:
+    // never at the instant of the send, never more than one interval later
+    const LatencyHistogram& confirm = hid.getConfirmLatency();
+    bool confirmsValid = confirm.getCount() > 0 && hid.getLateConfirms() == 0;
+    Serial.printf("Send to confirm:  n=%u min=%u p50=%u max=%u us, %u outside one interval (%s)\n",
+                  confirm.getCount(), confirm.getMin(), confirm.getPercentile(50), confirm.getMax(),
+                  hid.getLateConfirms(), confirmsValid ? "OK" : "FAIL");
+    Serial.printf("LED frames:       %u, pixel 0 = 0x%06X\n",
+                  sim::getLedTransport().getFrameCount(), sim::getLedTransport().getPixel(0));
+    Serial.printf("Call %s, %s\n",
+                  controller.isCallActive() ? "active" : "idle",
+                  controller.isMuted() ? "muted" : "unmuted");
+    
+    return confirmsValid ? 0 : 1;
+}
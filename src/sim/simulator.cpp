@@ -0,0 +1,70 @@
+#include "sim/simulator.h"
+#include "core/input_queue.h"
+#include "hal/native/sim_hardware.h"
+
+Simulator::Simulator(DeviceController& controller)
+    : controller(controller),
+      nextSequence(0),
+      steps(0) {
+}
+
+void Simulator::at(uint64_t timeMs, Action action) {
+    actions.push({ timeMs * 1000, nextSequence++, action });
+}
+
+void Simulator::atMicros(uint64_t timeUs, Action action) {
+    actions.push({ timeUs, nextSequence++, action });
+}
+
+void Simulator::after(uint32_t delayMs, Action action) {
+    actions.push({ sim::now() + (uint64_t)delayMs * 1000, nextSequence++, action });
+}
+
+uint64_t Simulator::nowMs() const {
+    return sim::now() / 1000;
+}
+
+void Simulator::runDueActions() {
+    // Actions may schedule more actions, including ones due right now
+    while (!actions.empty() && actions.top().time <= sim::now()) {
+        Action action = actions.top().action;
+        actions.pop();
+        action();
+    }
+}
+
+void Simulator::run(uint32_t durationMs) {
+    uint64_t end = sim::now() + (uint64_t)durationMs * 1000;
+
+    sim::SimHidTransport& hid = sim::getHidTransport();
+    while (true) {
+        runDueActions();
+        hid.deliverConfirms();
+
+        // Same as one wake of the input task: drain the interrupt queue, then update()
+        controller.step(0);
+        steps++;
+
+        uint64_t now = sim::now();
+        uint64_t next = end;
+        if (!actions.empty() && actions.top().time < next) {
+            next = actions.top().time;
+        }
+        if (hid.getNextConfirmTime() < next) {
+            next = hid.getNextConfirmTime();
+        }
+        if (sim::nextTouchSweep() < next) {
+            next = sim::nextTouchSweep();
+        }
+        // Anything a pass queued for itself (a transmit confirm) wakes the task at once
+        uint32_t timeout = getInputQueue().isEmpty() ? controller.nextWakeTimeout() : 0;
+        if (timeout != INPUT_WAIT_FOREVER && now + (uint64_t)timeout * 1000 < next) {
+            next = now + (uint64_t)timeout * 1000;
+        }
+
+        if (now >= end) break;
+        
+        // A pass always costs some time, so a zero timeout cannot stall the clock
+        sim::advanceMicros(next > now ? next - now : 1);
+    }
+}
@@ -0,0 +1,284 @@
+/*
+ * Event trace converter. Reads a serial capture holding a trace dump
+ * (serial command d) and writes Chrome trace-event JSON, for
+ * chrome://tracing or ui.perfetto.dev: one track for interrupts, one for
+ * the input task and one per host, with every event as an instant.
+ *
+ * Each telephony decision (call_state) is then followed through the
+ * pipeline and drawn as spans on a per-host track: from the input edge
+ * that led to it, to the notification carrying it, to the stack's confirm,
+ * to the host writing back LEDs that match, each before the next decision.
+ * The same breakdown is printed as a table; a missing stage shows as '-'.
+ *
+ * Lines without the trace prefix are skipped, so a whole monitor log can be
+ * passed in. When it holds several dumps, the last one is used.
+ *
+ * Usage: program capture.log [trace.json]
+ */
+
+#include <Arduino.h>
+#include <vector>
+#include "core/event_trace.h"
+#include "communication/bluetooth_handler.h"
+#include "hidmap.h"
+
+#define TRACE_EDGE_WINDOW_US   1000000  // an edge older than this did not cause the decision
+#define TRACE_NO_TIME          UINT64_MAX
+
+// Chrome trace thread ids
+enum TraceTrack : uint16_t {
+    TRACK_INTERRUPTS = 1,
+    TRACK_INPUT = 2,
+    TRACK_ALL_HOSTS = 9,
+    TRACK_HOST = 10,         // plus connId
+    TRACK_MUTE_PATH = 1000   // plus connId
+};
+
+// Event with its timestamp unwrapped past the 71 minute micros() rollover
+struct Event {
+    uint64_t time;
+    TraceEvent raw;
+};
+
+// Argument names per type, nullptr where unused
+static const char* const argNames[TRACE_TYPE_COUNT][3] = {
+    { "pad", nullptr, nullptr },        // touch_edge
+    { "pin", "pressed", nullptr },      // button_edge
+    { "source", "pin", nullptr },       // wake
+    { "pad", "event", nullptr },        // touch
+    { "pin", "event", nullptr },        // button
+    { "report", "call", nullptr },      // call_state
+    { "call", "mute", nullptr },        // host_state
+    { "conn", "channel", "value" },     // notify
+    { "conn", "result", nullptr },      // notify_done
+    { "conn", "leds", nullptr }         // host_write
+};
+
+static std::vector<Event> events;
+static bool firstRecord = true;
+
+static bool parseLine(const char* line, uint64_t& wrap, uint32_t& previous) {
+    const char* start = strstr(line, "trace ");
+    if (!start) return false;
+
+    unsigned long time;
+    char name[32];
+    unsigned a, b, c;
+    if (sscanf(start, "trace %lu %31s %u %u %u", &time, name, &a, &b, &c) != 5) return false;
+
+    uint8_t type = TRACE_TYPE_COUNT;
+    for (uint8_t i = 0; i < TRACE_TYPE_COUNT; i++) {
+        if (strcmp(name, EventTrace::getTypeName(i)) == 0) type = i;
+    }
+    if (type == TRACE_TYPE_COUNT) return false;
+
+    // Events come oldest first; a big step back is the counter wrapping
+    if (!events.empty() && (uint32_t)time < previous && previous - (uint32_t)time > 0x80000000UL) {
+        wrap += 0x100000000ULL;
+    }
+    previous = (uint32_t)time;
+
+    Event event;
+    event.time = wrap + (uint32_t)time;
+    event.raw = { (uint32_t)time, type, (uint8_t)a, (uint8_t)b, (uint8_t)c };
+    events.push_back(event);
+    return true;
+}
+
+static bool load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+
+    char line[256];
+    uint64_t wrap = 0;
+    uint32_t previous = 0;
+    while (fgets(line, sizeof(line), file)) {
+        // A later dump supersedes the earlier ones
+        if (strstr(line, "------ Event Trace ------")) {
+            events.clear();
+            wrap = 0;
+            continue;
+        }
+        parseLine(line, wrap, previous);
+    }
+    fclose(file);
+    return !events.empty();
+}
+
+static uint16_t trackFor(const TraceEvent& event) {
+    switch (event.type) {
+        case TRACE_TOUCH_EDGE:
+        case TRACE_BUTTON_EDGE:
+            return TRACK_INTERRUPTS;
+        case TRACE_NOTIFY:
+        case TRACE_NOTIFY_DONE:
+        case TRACE_HOST_WRITE:
+            return event.a == TRACE_ALL_HOSTS ? TRACK_ALL_HOSTS : TRACK_HOST + event.a;
+        default:
+            return TRACK_INPUT;
+    }
+}
+
+// Separator before every record but the first
+static void beginRecord(FILE* out) {
+    fprintf(out, firstRecord ? "\n" : ",\n");
+    firstRecord = false;
+}
+
+static void writeThreadName(FILE* out, uint16_t tid, const char* name) {
+    beginRecord(out);
+    fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", tid, name);
+}
+
+static void writeSpan(FILE* out, const char* name, uint16_t tid, uint64_t from, uint64_t to, uint64_t origin) {
+    beginRecord(out);
+    fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+            name, tid, (unsigned long long)(from - origin), (unsigned long long)(to - from));
+}
+
+// First matching event in [from, to), or events.size()
+template <typename Match>
+static size_t findNext(size_t from, size_t to, Match match) {
+    for (size_t i = from; i < to; i++) {
+        if (match(events[i].raw)) return i;
+    }
+    return events.size();
+}
+
+static void printStage(uint64_t from, uint64_t to) {
+    if (to == TRACE_NO_TIME || from == TRACE_NO_TIME) {
+        Serial.printf(" %9s", "-");
+    } else {
+        Serial.printf(" %9llu", (unsigned long long)(to - from));
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s capture.log [trace.json]\n", argv[0]);
+        return 2;
+    }
+    const char* outputPath = argc > 2 ? argv[2] : "trace.json";
+    if (!load(argv[1])) {
+        fprintf(stderr, "No trace events in %s\n", argv[1]);
+        return 1;
+    }
+    FILE* out = fopen(outputPath, "w");
+    if (!out) {
+        perror(outputPath);
+        return 1;
+    }
+
+    uint64_t origin = events.front().time;
+    bool hosts[TRACE_ALL_HOSTS] = {};
+    bool broadcast = false;
+    for (const Event& event : events) {
+        uint16_t track = trackFor(event.raw);
+        if (track == TRACK_ALL_HOSTS) broadcast = true;
+        else if (track != TRACK_INTERRUPTS && track != TRACK_INPUT) hosts[event.raw.a] = true;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    beginRecord(out);
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Telephony controller\"}}");
+    writeThreadName(out, TRACK_INTERRUPTS, "Interrupts");
+    writeThreadName(out, TRACK_INPUT, "Input task");
+    if (broadcast) writeThreadName(out, TRACK_ALL_HOSTS, "All hosts");
+    for (uint16_t conn = 0; conn < TRACE_ALL_HOSTS; conn++) {
+        if (!hosts[conn]) continue;
+        // Connections that did not fit the trace's byte share the last track
+        const char* suffix = conn == TRACE_OTHER_HOST ? "+" : "";
+        char name[32];
+        snprintf(name, sizeof(name), "Host conn %u%s", conn, suffix);
+        writeThreadName(out, TRACK_HOST + conn, name);
+        snprintf(name, sizeof(name), "Mute path conn %u%s", conn, suffix);
+        writeThreadName(out, TRACK_MUTE_PATH + conn, name);
+    }
+
+    for (const Event& event : events) {
+        const TraceEvent& raw = event.raw;
+        beginRecord(out);
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{",
+                EventTrace::getTypeName(raw.type), trackFor(raw), (unsigned long long)(event.time - origin));
+        const uint8_t values[3] = { raw.a, raw.b, raw.c };
+        bool first = true;
+        for (uint8_t i = 0; i < 3; i++) {
+            if (!argNames[raw.type][i]) continue;
+            fprintf(out, "%s\"%s\":%u", first ? "" : ",", argNames[raw.type][i], values[i]);
+            first = false;
+        }
+        fprintf(out, "}}");
+    }
+
+    Serial.printf("\n--- Event Trace: %s ---\n", argv[1]);
+    Serial.printf("%zu events over %.3f s\n", events.size(), (events.back().time - origin) / 1e6);
+    Serial.printf("Mute path (us): decision time, report, edge to decision, then per host: to notify, to confirm, to LED echo\n");
+
+    uint64_t lastDecision = 0;
+    for (size_t d = 0; d < events.size(); d++) {
+        if (events[d].raw.type != TRACE_CALL_STATE) continue;
+        const Event& decision = events[d];
+        uint8_t report = decision.raw.a;
+
+        // Oldest edge since the previous decision; host-driven decisions have none
+        uint64_t edge = TRACE_NO_TIME;
+        for (size_t i = 0; i < d; i++) {
+            const Event& event = events[i];
+            if (event.raw.type != TRACE_TOUCH_EDGE && event.raw.type != TRACE_BUTTON_EDGE) continue;
+            if (event.time < lastDecision || decision.time - event.time > TRACE_EDGE_WINDOW_US) continue;
+            edge = event.time;
+            break;
+        }
+        lastDecision = decision.time;
+
+        // Whatever follows the next decision belongs to that one
+        size_t limit = d + 1;
+        while (limit < events.size() && events[limit].raw.type != TRACE_CALL_STATE) limit++;
+
+        Serial.printf("%12.6f 0x%02X", (decision.time - origin) / 1e6, report);
+        printStage(edge, decision.time);
+        if (edge != TRACE_NO_TIME) {
+            for (uint16_t conn = 0; conn < TRACE_ALL_HOSTS; conn++) {
+                if (hosts[conn]) writeSpan(out, "edge to decision", TRACK_MUTE_PATH + conn, edge, decision.time, origin);
+            }
+        }
+
+        for (uint16_t conn = 0; conn < TRACE_ALL_HOSTS; conn++) {
+            if (!hosts[conn]) continue;
+            uint16_t tid = TRACK_MUTE_PATH + conn;
+
+            size_t notify = findNext(d + 1, limit, [conn, report](const TraceEvent& e) {
+                return e.type == TRACE_NOTIFY && (e.a == conn || e.a == TRACE_ALL_HOSTS) &&
+                       e.b == HID_CHANNEL_HEADSET && e.c == report;
+            });
+            size_t confirm = notify < events.size() ? findNext(notify + 1, limit, [conn](const TraceEvent& e) {
+                return e.type == TRACE_NOTIFY_DONE && e.a == conn && e.b == TX_CONFIRMED;
+            }) : events.size();
+            size_t echo = confirm < events.size() ? findNext(confirm + 1, limit, [conn, report](const TraceEvent& e) {
+                return e.type == TRACE_HOST_WRITE && e.a == conn && (e.b & HEADSET_MUTE) == (report & HEADSET_MUTE);
+            }) : events.size();
+
+            uint64_t notifyTime = notify < events.size() ? events[notify].time : TRACE_NO_TIME;
+            uint64_t confirmTime = confirm < events.size() ? events[confirm].time : TRACE_NO_TIME;
+            uint64_t echoTime = echo < events.size() ? events[echo].time : TRACE_NO_TIME;
+
+            Serial.printf("  conn %u:", conn);
+            printStage(decision.time, notifyTime);
+            printStage(notifyTime, confirmTime);
+            printStage(confirmTime, echoTime);
+
+            if (notifyTime == TRACE_NO_TIME) continue;
+            writeSpan(out, "decision to notify", tid, decision.time, notifyTime, origin);
+            if (confirmTime == TRACE_NO_TIME) continue;
+            writeSpan(out, "notify to confirm", tid, notifyTime, confirmTime, origin);
+            if (echoTime == TRACE_NO_TIME) continue;
+            writeSpan(out, "confirm to LED echo", tid, confirmTime, echoTime, origin);
+        }
+        Serial.printf("\n");
+    }
+
+    fprintf(out, "\n]}\n");
+    fclose(out);
+    Serial.printf("Chrome trace written to %s\n", outputPath);
+    return 0;
+}